@@ -1,23 +1,84 @@
 #include "appscache.h"
 #include "guestserverappsclient.h"
+#include "appsstreamdecoder.h"
+#include "writebehind.h"
 #include <QStandardPaths>
 #include <QDir>
 #include <QFile>
-#include <QJsonDocument>
-#include <QJsonArray>
-#include <QJsonObject>
+#include <QFileInfo>
+#include <QHash>
+#include <QCryptographicHash>
+#include <QSaveFile>
+#include <QUuid>
+#include <QVector>
+#include <QtEndian>
 #include <QDebug>
 
+namespace {
+constexpr quint32 kCacheMagic = 0x43415257; // "WRAC" in file order
+constexpr quint32 kCacheVersion = 1;
+constexpr int kHeaderFields = 8;
+constexpr int kRecordFields = 7;
+
+// Header fields, each a little-endian u32
+enum HeaderField {
+    Magic,
+    Version,
+    RecordCount,
+    StringCount,
+    RecordsOffset,
+    StringIndexOffset,
+    StringDataOffset,
+    StringDataSize
+};
+
+// Record layout: one string id per field, in this order
+template <typename App>
+auto &recordField(App &app, int field)
+{
+    switch (field) {
+    case 1: return app.publisher;
+    case 2: return app.installLocation;
+    case 3: return app.displayVersion;
+    case 4: return app.iconPath;
+    case 5: return app.uninstallString;
+    case 6: return app.iconStamp;
+    default: return app.name;
+    }
+}
+
+void appendU32(QByteArray &out, quint32 value)
+{
+    char bytes[4];
+    qToLittleEndian(value, bytes);
+    out.append(bytes, 4);
+}
+
+quint32 readU32(const uchar *data, quint64 offset)
+{
+    return qFromLittleEndian<quint32>(data + offset);
+}
+} // namespace
+
 AppsCache::AppsCache(QObject *parent)
     : QObject(parent)
 {
     m_cacheFilePath = getCacheFilePath();
 }
 
-QString AppsCache::getCacheFilePath()
+void AppsCache::setCatalog(const QString &catalogId)
+{
+    m_catalogId = catalogId;
+    m_cacheFilePath = getCacheFilePath(catalogId);
+}
+
+QString AppsCache::getCacheFilePath(const QString &catalogId)
 {
     // Use application cache directory
     QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!catalogId.isEmpty()) {
+        cacheDir += "/catalogs";
+    }
     
     // Create directory if it doesn't exist
     QDir dir(cacheDir);
@@ -25,45 +86,124 @@ QString AppsCache::getCacheFilePath()
         dir.mkpath(".");
     }
     
-    return cacheDir + "/apps_cache.json";
+    if (catalogId.isEmpty()) {
+        return cacheDir + "/apps_cache.bin";
+    }
+    // Domain UUIDs are safe file names; anything else is hashed
+    const QString fileName = QUuid::fromString(catalogId).isNull()
+        ? QString::fromLatin1(QCryptographicHash::hash(catalogId.toUtf8(), QCryptographicHash::Sha1).toHex())
+        : catalogId.toLower();
+    return cacheDir + "/" + fileName + ".bin";
+}
+
+QString AppsCache::legacyCacheFilePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/apps_cache.json";
+}
+
+QString AppsCache::lastCatalogFilePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/catalogs/last";
+}
+
+QString AppsCache::lastCatalog()
+{
+    QFile file(lastCatalogFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll()).trimmed();
+}
+
+void AppsCache::setLastCatalog(const QString &catalogId)
+{
+    const QString filePath = lastCatalogFilePath();
+    WriteBehind::shared()->schedule(filePath, nullptr, [filePath, catalogId]() -> WriteBehind::Write {
+        return [filePath, catalogId]() {
+            QDir().mkpath(QFileInfo(filePath).absolutePath());
+            QSaveFile file(filePath);
+            if (!file.open(QIODevice::WriteOnly)) {
+                return false;
+            }
+            file.write(catalogId.toUtf8());
+            return file.commit();
+        };
+    });
 }
 
 bool AppsCache::saveApps(const QList<InstalledApp> &apps)
 {
-    QJsonArray appsArray;
-    
+    return writeApps(m_cacheFilePath, apps);
+}
+
+void AppsCache::scheduleSave(const QList<InstalledApp> &apps)
+{
+    const QString filePath = m_cacheFilePath;
+    WriteBehind::shared()->schedule(filePath, nullptr, [filePath, apps]() -> WriteBehind::Write {
+        return [filePath, apps]() { return writeApps(filePath, apps); };
+    });
+}
+
+bool AppsCache::writeApps(const QString &filePath, const QList<InstalledApp> &apps)
+{
+    // Intern every field; id 0 is the empty string
+    QHash<QString, quint32> ids;
+    QByteArray stringIndex;
+    QByteArray stringData;
+    auto intern = [&](const QString &value) -> quint32 {
+        auto it = ids.constFind(value);
+        if (it != ids.constEnd()) {
+            return *it;
+        }
+        const QByteArray utf8 = value.toUtf8();
+        const quint32 id = static_cast<quint32>(ids.size());
+        appendU32(stringIndex, static_cast<quint32>(stringData.size()));
+        appendU32(stringIndex, static_cast<quint32>(utf8.size()));
+        stringData.append(utf8);
+        ids.insert(value, id);
+        return id;
+    };
+    intern(QString());
+
+    QByteArray records;
+    records.reserve(apps.size() * kRecordFields * 4);
     for (const InstalledApp &app : apps) {
-        QJsonObject appObj;
-        appObj["name"] = app.name;
-        appObj["publisher"] = app.publisher;
-        appObj["install_location"] = app.installLocation;
-        appObj["display_version"] = app.displayVersion;
-        appObj["icon_path"] = app.iconPath;
-        appObj["uninstall_string"] = app.uninstallString;
-        
-        // Store icon data as base64 if available
-        if (!app.iconData.isEmpty()) {
-            appObj["icon_data"] = QString::fromLatin1(app.iconData.toBase64());
+        for (int field = 0; field < kRecordFields; ++field) {
+            appendU32(records, intern(recordField(app, field)));
         }
-        
-        appsArray.append(appObj);
     }
-    
-    QJsonObject rootObj;
-    rootObj["apps"] = appsArray;
-    
-    QJsonDocument jsonDoc(rootObj);
-    
-    QFile file(m_cacheFilePath);
+
+    const quint32 recordsOffset = kHeaderFields * 4;
+    const quint32 stringIndexOffset = recordsOffset + static_cast<quint32>(records.size());
+    const quint32 stringDataOffset = stringIndexOffset + static_cast<quint32>(stringIndex.size());
+
+    QByteArray header;
+    appendU32(header, kCacheMagic);
+    appendU32(header, kCacheVersion);
+    appendU32(header, static_cast<quint32>(apps.size()));
+    appendU32(header, static_cast<quint32>(ids.size()));
+    appendU32(header, recordsOffset);
+    appendU32(header, stringIndexOffset);
+    appendU32(header, stringDataOffset);
+    appendU32(header, static_cast<quint32>(stringData.size()));
+
+    QSaveFile file(filePath);
     if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Failed to open cache file for writing:" << m_cacheFilePath;
+        qWarning() << "Failed to open cache file for writing:" << filePath;
         return false;
     }
     
-    file.write(jsonDoc.toJson());
-    file.close();
+    file.write(header);
+    file.write(records);
+    file.write(stringIndex);
+    file.write(stringData);
+    if (!file.commit()) {
+        qWarning() << "Failed to write cache file:" << filePath;
+        return false;
+    }
     
-    qDebug() << "Apps cache saved to:" << m_cacheFilePath << "(" << apps.size() << "apps)";
+    qDebug() << "Apps cache saved to:" << filePath << "(" << apps.size() << "apps,"
+             << ids.size() << "distinct strings)";
     return true;
 }
 
@@ -71,6 +211,16 @@ bool AppsCache::loadApps(QList<InstalledApp> &apps)
 {
     QFile file(m_cacheFilePath);
     if (!file.exists()) {
+        // First run after the switch to per-VM binary catalogs. Which VM the
+        // old shared JSON cache belonged to is unknown, so the first VM
+        // catalog opened takes it over; the shared one only shows it.
+        if (QFile::exists(legacyCacheFilePath()) && loadLegacyApps(apps)) {
+            if (!m_catalogId.isEmpty() && saveApps(apps)) {
+                QFile::remove(legacyCacheFilePath());
+                qDebug() << "Migrated JSON apps cache to:" << m_cacheFilePath;
+            }
+            return true;
+        }
         qDebug() << "Cache file does not exist:" << m_cacheFilePath;
         return false;
     }
@@ -80,48 +230,113 @@ bool AppsCache::loadApps(QList<InstalledApp> &apps)
         return false;
     }
     
-    QByteArray data = file.readAll();
-    file.close();
-    
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(data);
-    if (!jsonDoc.isObject()) {
+    const quint64 size = static_cast<quint64>(file.size());
+    if (size < kHeaderFields * 4) {
         qWarning() << "Invalid cache file format";
         return false;
     }
+    // Every record is decoded below, so mapping the file would save nothing
+    const QByteArray bytes = file.readAll();
+    if (static_cast<quint64>(bytes.size()) != size) {
+        qWarning() << "Failed to read cache file:" << m_cacheFilePath;
+        return false;
+    }
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+
+    auto header = [data](HeaderField field) { return readU32(data, field * 4); };
+    const quint64 recordCount = header(RecordCount);
+    const quint64 stringCount = header(StringCount);
+    const quint64 recordsOffset = header(RecordsOffset);
+    const quint64 stringIndexOffset = header(StringIndexOffset);
+    const quint64 stringDataOffset = header(StringDataOffset);
+    const quint64 stringDataSize = header(StringDataSize);
+    if (header(Magic) != kCacheMagic || header(Version) != kCacheVersion
+        || recordsOffset + recordCount * kRecordFields * 4 > size
+        || stringIndexOffset + stringCount * 8 > size
+        || stringDataOffset + stringDataSize > size) {
+        qWarning() << "Invalid cache file format";
+        return false;
+    }
+
+    // Each distinct string is decoded once and then shared by every record
+    QVector<QString> strings(static_cast<int>(stringCount));
+    QVector<bool> decoded(static_cast<int>(stringCount), false);
+    auto string = [&](quint32 id, bool *valid) -> QString {
+        if (id >= stringCount) {
+            *valid = false;
+            return QString();
+        }
+        if (!decoded[id]) {
+            const quint64 offset = readU32(data, stringIndexOffset + id * 8ull);
+            const quint64 length = readU32(data, stringIndexOffset + id * 8ull + 4);
+            if (offset + length > stringDataSize) {
+                *valid = false;
+                return QString();
+            }
+            strings[id] = QString::fromUtf8(reinterpret_cast<const char *>(data + stringDataOffset + offset),
+                                            static_cast<int>(length));
+            decoded[id] = true;
+        }
+        return strings[id];
+    };
+
+    QList<InstalledApp> loaded;
+    loaded.reserve(static_cast<int>(recordCount));
+    bool valid = true;
+    for (quint64 record = 0; record < recordCount && valid; ++record) {
+        InstalledApp app;
+        const quint64 offset = recordsOffset + record * kRecordFields * 4;
+        for (int field = 0; field < kRecordFields; ++field) {
+            recordField(app, field) = string(readU32(data, offset + field * 4), &valid);
+        }
+        if (!app.name.isEmpty()) {
+            loaded.append(app);
+        }
+    }
+
+    if (!valid) {
+        qWarning() << "Invalid cache file format";
+        return false;
+    }
+    apps = loaded;
+    
+    qDebug() << "Apps cache loaded from:" << m_cacheFilePath << "(" << apps.size() << "apps)";
+    return true;
+}
+
+bool AppsCache::loadLegacyApps(QList<InstalledApp> &apps)
+{
+    QFile file(legacyCacheFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open cache file for reading:" << file.fileName();
+        return false;
+    }
     
-    QJsonObject rootObj = jsonDoc.object();
-    QJsonArray appsArray = rootObj["apps"].toArray();
+    // Same layout as the /apps response; inlined base64 icons are skipped,
+    // the IconStore fetches them again
+    AppsStreamDecoder decoder;
+    const QList<InstalledApp> decoded = decoder.feed(file.readAll());
+    file.close();
+    if (!decoder.isComplete()) {
+        qWarning() << "Invalid cache file format";
+        return false;
+    }
     
     apps.clear();
-    
-    for (const QJsonValue &value : appsArray) {
-        QJsonObject appObj = value.toObject();
-        
-        InstalledApp app;
-        app.name = appObj["name"].toString();
-        app.publisher = appObj["publisher"].toString();
-        app.installLocation = appObj["install_location"].toString();
-        app.displayVersion = appObj["display_version"].toString();
-        app.iconPath = appObj["icon_path"].toString();
-        app.uninstallString = appObj["uninstall_string"].toString();
-        
-        // Load icon data if available
-        if (appObj.contains("icon_data")) {
-            QString base64Data = appObj["icon_data"].toString();
-            app.iconData = QByteArray::fromBase64(base64Data.toLatin1());
-        }
-        
+    for (const InstalledApp &app : decoded) {
         if (!app.name.isEmpty()) {
             apps.append(app);
         }
     }
     
-    qDebug() << "Apps cache loaded from:" << m_cacheFilePath << "(" << apps.size() << "apps)";
     return true;
 }
 
 bool AppsCache::clearCache()
 {
+    if (m_catalogId.isEmpty()) {
+        QFile::remove(legacyCacheFilePath());
+    }
     QFile file(m_cacheFilePath);
     if (file.exists()) {
         if (!file.remove()) {
@@ -136,5 +351,5 @@ bool AppsCache::clearCache()
 
 bool AppsCache::cacheExists() const
 {
-    return QFile::exists(m_cacheFilePath);
+    return QFile::exists(m_cacheFilePath) || QFile::exists(legacyCacheFilePath());
 }
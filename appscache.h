@@ -8,6 +8,13 @@
 // Forward declaration - we'll include the full header in cpp
 struct InstalledApp;
 
+// Installed apps cache. The file is a versioned binary table: a header, one
+// fixed-size record per app whose fields are indices into an interned string
+// pool, the pool's (offset, length) index and the UTF-8 string data. It is
+// read in one go and decoded eagerly; repeated strings (publishers, install
+// roots, empty fields) are stored and decoded once and then shared. Icons are
+// not part of the file; they live in the IconStore and are read when a tile
+// shows them.
 class AppsCache : public QObject
 {
     Q_OBJECT
@@ -15,9 +22,26 @@ class AppsCache : public QObject
 public:
     explicit AppsCache(QObject *parent = nullptr);
     
+    // Catalogs are kept per VM (domain UUID); an empty id is the shared
+    // catalog of earlier versions
+    void setCatalog(const QString &catalogId);
+    QString catalog() const { return m_catalogId; }
+    
+    // Catalog shown when the application last ran, so startup can show it
+    // before the VM list is known
+    static QString lastCatalog();
+    static void setLastCatalog(const QString &catalogId);
+    
     // Save apps to cache file
     bool saveApps(const QList<InstalledApp> &apps);
     
+    // Saves in the background through WriteBehind; repeated calls within
+    // a short window write only the latest list
+    void scheduleSave(const QList<InstalledApp> &apps);
+    
+    // Writes a cache file; safe to call from any thread
+    static bool writeApps(const QString &filePath, const QList<InstalledApp> &apps);
+    
     // Load apps from cache file
     bool loadApps(QList<InstalledApp> &apps);
     
@@ -25,12 +49,19 @@ public:
     bool clearCache();
     
     // Get cache file path
-    static QString getCacheFilePath();
+    static QString getCacheFilePath(const QString &catalogId = QString());
     
     // Check if cache exists
     bool cacheExists() const;
 
 private:
+    // JSON cache written by earlier versions; moved into the first VM
+    // catalog loaded after the upgrade
+    static QString legacyCacheFilePath();
+    static QString lastCatalogFilePath();
+    bool loadLegacyApps(QList<InstalledApp> &apps);
+
+    QString m_catalogId;
     QString m_cacheFilePath;
 };
 
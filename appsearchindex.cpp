@@ -0,0 +1,348 @@
+#include "appsearchindex.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <utility>
+
+namespace {
+// Tombstones are compacted away once there are more of them than this and
+// than live apps
+constexpr int kMinTombstones = 256;
+
+// Scores, highest first
+constexpr int kExactScore = 1000;
+constexpr int kPrefixScore = 900;
+constexpr int kWordStartScore = 800;
+constexpr int kSubstringScore = 700;
+constexpr int kAllWordsScore = 500;
+constexpr int kInOrderScore = 300;
+constexpr int kFuzzyScore = 100;
+
+// Grams are three UTF-16 units packed into 48 bits; word prefixes of one or
+// two letters are tagged above that so they never collide with trigrams
+constexpr quint64 kPrefixTag = quint64(1) << 62;
+constexpr quint64 kTwoLetterTag = quint64(1) << 48;
+
+quint64 trigram(const QString &text, int i)
+{
+    return (quint64(text.at(i).unicode()) << 32) | (quint64(text.at(i + 1).unicode()) << 16)
+           | quint64(text.at(i + 2).unicode());
+}
+
+quint64 prefixGram(const QString &word)
+{
+    if (word.size() == 1) {
+        return kPrefixTag | quint64(word.at(0).unicode());
+    }
+    return kPrefixTag | kTwoLetterTag | (quint64(word.at(0).unicode()) << 16) | quint64(word.at(1).unicode());
+}
+
+void appendTrigrams(QVector<quint64> &grams, const QString &text)
+{
+    for (int i = 0; i + 2 < text.size(); ++i) {
+        grams.append(trigram(text, i));
+    }
+}
+
+void appendWordPrefixes(QVector<quint64> &grams, const QString &text)
+{
+    for (int i = 0; i < text.size(); ++i) {
+        if (text.at(i).isLetterOrNumber() && (i == 0 || !text.at(i - 1).isLetterOrNumber())) {
+            grams.append(prefixGram(text.mid(i, 1)));
+            if (i + 1 < text.size() && text.at(i + 1).isLetterOrNumber()) {
+                grams.append(prefixGram(text.mid(i, 2)));
+            }
+        }
+    }
+}
+
+void sortUnique(QVector<quint64> &grams)
+{
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+}
+
+bool startsWord(const QString &text, const QString &query)
+{
+    for (int at = text.indexOf(query); at >= 0; at = text.indexOf(query, at + 1)) {
+        if (at == 0 || !text.at(at - 1).isLetterOrNumber()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Letters of query appear in text in order; returns how spread out they are,
+// or -1 if they do not
+int inOrderSpread(const QString &text, const QString &query)
+{
+    int first = -1;
+    int at = -1;
+    for (const QChar c : query) {
+        if (c.isSpace()) {
+            continue;
+        }
+        at = text.indexOf(c, at + 1);
+        if (at < 0) {
+            return -1;
+        }
+        if (first < 0) {
+            first = at;
+        }
+    }
+    return at - first;
+}
+} // namespace
+
+AppSearchIndex::AppSearchIndex()
+    : m_liveCount(0)
+    , m_lastSearchNs(0)
+{
+}
+
+QString AppSearchIndex::docKey(const InstalledApp &app)
+{
+    // Everything that is indexed, so a changed field makes a new document
+    return app.name + QLatin1Char('\n') + app.publisher + QLatin1Char('\n') + app.installLocation;
+}
+
+void AppSearchIndex::setApps(const QList<InstalledApp> &apps)
+{
+    QVector<bool> seen(m_docs.size(), false);
+    for (int row = 0; row < apps.size(); ++row) {
+        const InstalledApp &app = apps.at(row);
+        // Identical entries are matched up in order, one doc each
+        int match = -1;
+        auto it = m_docsByKey.constFind(docKey(app));
+        if (it != m_docsByKey.constEnd()) {
+            for (int id : *it) {
+                if (!seen.at(id)) {
+                    match = id;
+                    break;
+                }
+            }
+        }
+        if (match >= 0) {
+            m_docs[match].row = row;
+            seen[match] = true;
+            continue;
+        }
+
+        addDoc(app, row);
+        seen.append(true);
+    }
+
+    for (int id = 0; id < seen.size(); ++id) {
+        Doc &doc = m_docs[id];
+        if (doc.live && !seen.at(id)) {
+            doc.live = false;
+            --m_liveCount;
+            auto ids = m_docsByKey.find(doc.key);
+            ids->removeOne(id);
+            if (ids->isEmpty()) {
+                m_docsByKey.erase(ids);
+            }
+        }
+    }
+
+    const int tombstones = m_docs.size() - m_liveCount;
+    if (tombstones > kMinTombstones && tombstones > m_liveCount) {
+        rebuildPostings();
+    }
+}
+
+void AppSearchIndex::appendApps(const QList<InstalledApp> &apps, int firstRow)
+{
+    for (int i = 0; i < apps.size(); ++i) {
+        addDoc(apps.at(i), firstRow + i);
+    }
+}
+
+void AppSearchIndex::addDoc(const InstalledApp &app, int row)
+{
+    Doc doc;
+    doc.key = docKey(app);
+    doc.name = app.name.toCaseFolded();
+    doc.publisher = app.publisher.toCaseFolded();
+    doc.location = app.installLocation.toCaseFolded();
+    doc.row = row;
+    doc.live = true;
+    m_docs.append(doc);
+    m_docsByKey[doc.key].append(m_docs.size() - 1);
+    ++m_liveCount;
+    addPostings(m_docs.size() - 1);
+}
+
+void AppSearchIndex::clear()
+{
+    m_docs.clear();
+    m_docsByKey.clear();
+    m_postings.clear();
+    m_counts.clear();
+    m_liveCount = 0;
+}
+
+QVector<int> AppSearchIndex::search(const QString &query, int limit) const
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    QVector<int> rows;
+    const QString folded = query.toCaseFolded().simplified();
+    if (folded.isEmpty()) {
+        m_lastSearchNs = elapsed.nsecsElapsed();
+        return rows;
+    }
+
+    // Count the grams each app shares with the query
+    const QVector<quint64> grams = queryGrams(folded);
+    if (m_counts.size() < m_docs.size()) {
+        m_counts.resize(m_docs.size());
+    }
+    QVector<int> touched;
+    for (quint64 gram : grams) {
+        auto postings = m_postings.constFind(gram);
+        if (postings == m_postings.constEnd()) {
+            continue;
+        }
+        for (int id : *postings) {
+            if (m_counts[id]++ == 0) {
+                touched.append(id);
+            }
+        }
+    }
+
+    // Half the grams in common lets a typo through; the scorer decides
+    const int needed = qMax(1, (grams.size() + 1) / 2);
+    struct Hit {
+        int score;
+        int id;
+    };
+    QVector<Hit> hits;
+    for (int id : std::as_const(touched)) {
+        const int shared = m_counts.at(id);
+        m_counts[id] = 0;
+        const Doc &doc = m_docs.at(id);
+        if (!doc.live || shared < needed) {
+            continue;
+        }
+        const int docScore = score(doc, folded, shared, grams.size());
+        if (docScore > 0) {
+            hits.append(Hit{docScore, id});
+        }
+    }
+
+    // Best score, then the shorter (closer) name, then catalog order
+    std::sort(hits.begin(), hits.end(), [this](const Hit &a, const Hit &b) {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        const Doc &docA = m_docs.at(a.id);
+        const Doc &docB = m_docs.at(b.id);
+        if (docA.name.size() != docB.name.size()) {
+            return docA.name.size() < docB.name.size();
+        }
+        return docA.row < docB.row;
+    });
+
+    const int count = limit < 0 ? hits.size() : qMin(limit, hits.size());
+    rows.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        rows.append(m_docs.at(hits.at(i).id).row);
+    }
+    m_lastSearchNs = elapsed.nsecsElapsed();
+    return rows;
+}
+
+QVector<quint64> AppSearchIndex::gramsOf(const Doc &doc)
+{
+    QVector<quint64> grams;
+    appendTrigrams(grams, doc.name);
+    appendTrigrams(grams, doc.publisher);
+    appendTrigrams(grams, doc.location);
+    // Paths would make every one-letter query match, so only names and
+    // publishers get word prefixes
+    appendWordPrefixes(grams, doc.name);
+    appendWordPrefixes(grams, doc.publisher);
+    sortUnique(grams);
+    return grams;
+}
+
+QVector<quint64> AppSearchIndex::queryGrams(const QString &query)
+{
+    // The query is simplified, so words are separated by single spaces
+    QVector<quint64> grams;
+    const QStringList words = query.split(QLatin1Char(' '));
+    for (const QString &word : words) {
+        if (word.size() < 3) {
+            grams.append(prefixGram(word));
+        } else {
+            appendTrigrams(grams, word);
+        }
+    }
+    sortUnique(grams);
+    return grams;
+}
+
+int AppSearchIndex::score(const Doc &doc, const QString &query, int sharedGrams, int queryGramCount) const
+{
+    if (doc.name == query) {
+        return kExactScore;
+    }
+    if (doc.name.startsWith(query)) {
+        return kPrefixScore;
+    }
+    if (startsWord(doc.name, query)) {
+        return kWordStartScore;
+    }
+    if (doc.name.contains(query)) {
+        return kSubstringScore;
+    }
+
+    const QStringList words = query.split(QLatin1Char(' '));
+    const bool allWords = std::all_of(words.cbegin(), words.cend(), [&doc](const QString &word) {
+        return doc.name.contains(word) || doc.publisher.contains(word) || doc.location.contains(word);
+    });
+    if (allWords) {
+        return kAllWordsScore;
+    }
+
+    // "vscode" -> "visual studio code"; tighter matches rank higher
+    const int spread = inOrderSpread(doc.name, query);
+    if (spread >= 0) {
+        return kInOrderScore - qMin(spread, kInOrderScore - kFuzzyScore - 1);
+    }
+
+    // Typos: at least half the query's trigrams, and more than one
+    if (queryGramCount > 1) {
+        return kFuzzyScore * sharedGrams / queryGramCount;
+    }
+    return 0;
+}
+
+void AppSearchIndex::addPostings(int docId)
+{
+    const QVector<quint64> grams = gramsOf(m_docs.at(docId));
+    for (quint64 gram : grams) {
+        m_postings[gram].append(docId);
+    }
+}
+
+void AppSearchIndex::rebuildPostings()
+{
+    QVector<Doc> live;
+    live.reserve(m_liveCount);
+    for (const Doc &doc : std::as_const(m_docs)) {
+        if (doc.live) {
+            live.append(doc);
+        }
+    }
+
+    m_docs = live;
+    m_docsByKey.clear();
+    m_postings.clear();
+    m_counts.clear();
+    for (int id = 0; id < m_docs.size(); ++id) {
+        m_docsByKey[m_docs.at(id).key].append(id);
+        addPostings(id);
+    }
+}
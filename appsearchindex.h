@@ -0,0 +1,65 @@
+#ifndef APPSEARCHINDEX_H
+#define APPSEARCHINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "guestserverappsclient.h"
+
+// In-memory search over a catalog's apps by name, publisher and install
+// location. Every app is indexed by the trigrams of those fields and by the
+// first one and two letters of each word, so a query only looks at apps that
+// share grams with it; those are then ranked by how well the name matches
+// (prefix, word start, substring, in-order letters), with half the trigrams
+// in common enough to tolerate a typo.
+//
+// setApps() only indexes apps that are new or changed; apps that went away
+// are tombstoned and the postings are rebuilt once they outnumber the rest.
+class AppSearchIndex
+{
+public:
+    AppSearchIndex();
+
+    // Rows in search results refer to this list
+    void setApps(const QList<InstalledApp> &apps);
+    // Indexes apps added at the end of the list, from row firstRow on
+    void appendApps(const QList<InstalledApp> &apps, int firstRow);
+    void clear();
+
+    // Matching rows, best first. An empty query matches nothing.
+    QVector<int> search(const QString &query, int limit = -1) const;
+
+    int size() const { return m_liveCount; }
+    // Indexed docs, tombstones included
+    int docCount() const { return m_docs.size(); }
+    qint64 lastSearchNs() const { return m_lastSearchNs; }
+
+private:
+    struct Doc {
+        QString key;
+        QString name;           // Case-folded
+        QString publisher;
+        QString location;
+        int row = -1;
+        bool live = false;
+    };
+
+    static QString docKey(const InstalledApp &app);
+    static QVector<quint64> gramsOf(const Doc &doc);
+    static QVector<quint64> queryGrams(const QString &query);
+    int score(const Doc &doc, const QString &query, int sharedGrams, int queryGramCount) const;
+
+    void addDoc(const InstalledApp &app, int row);
+    void addPostings(int docId);
+    void rebuildPostings();
+
+    QVector<Doc> m_docs;
+    QHash<QString, QVector<int>> m_docsByKey;   // Live docs with that key
+    QHash<quint64, QVector<int>> m_postings;
+    int m_liveCount;
+    // Scratch space for search(), one counter per doc
+    mutable QVector<quint16> m_counts;
+    mutable qint64 m_lastSearchNs;
+};
+
+#endif // APPSEARCHINDEX_H
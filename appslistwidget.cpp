@@ -1,13 +1,25 @@
 #include "appslistwidget.h"
-#include <QPixmap>
-#include <QIcon>
-#include <QSize>
+#include "appsmodel.h"
+#include "apptiledelegate.h"
+#include "framecoalescer.h"
+#include "iconstore.h"
+#include <QVBoxLayout>
+#include <QKeyEvent>
 #include <QFrame>
 #include <QDebug>
 #include <QProcess>
 
+namespace {
+constexpr int kTileSpacing = 15;
+} // namespace
+
 AppsListWidget::AppsListWidget(QWidget *parent)
     : QWidget(parent)
+    , m_staleLabel(nullptr)
+    , m_searchBox(nullptr)
+    , m_view(nullptr)
+    , m_model(new AppsModel(this))
+    , m_stale(false)
 {
     setupUI();
 }
@@ -20,13 +32,53 @@ void AppsListWidget::setupUI()
 {
     QVBoxLayout *mainLayout = new QVBoxLayout(this);
     mainLayout->setContentsMargins(0, 0, 0, 0);
-    mainLayout->setSpacing(0);
+    mainLayout->setSpacing(10);
+    
+    m_staleLabel = new QLabel(tr("Showing the last known apps. They will be updated when the VM is online."), this);
+    m_staleLabel->setWordWrap(true);
+    m_staleLabel->setStyleSheet("color: #7f8c8d; font-size: 12px;");
+    m_staleLabel->hide();
+    mainLayout->addWidget(m_staleLabel);
     
-    m_scrollArea = new QScrollArea(this);
-    m_scrollArea->setWidgetResizable(true);
-    m_scrollArea->setFrameShape(QFrame::NoFrame);
-    m_scrollArea->setStyleSheet(
-        "QScrollArea { "
+    m_searchBox = new QLineEdit(this);
+    m_searchBox->setPlaceholderText(tr("Search apps"));
+    m_searchBox->setClearButtonEnabled(true);
+    m_searchBox->setStyleSheet(
+        "QLineEdit { "
+        "    padding: 8px 12px; "
+        "    border: 1px solid #e0e0e0; "
+        "    border-radius: 8px; "
+        "    background-color: white; "
+        "    color: #1a535c; "
+        "}"
+        "QLineEdit:focus { "
+        "    border-color: #1a535c; "
+        "}"
+    );
+    m_searchBox->installEventFilter(this);
+    connect(m_searchBox, &QLineEdit::textChanged, this, &AppsListWidget::onSearchTextChanged);
+    connect(m_searchBox, &QLineEdit::returnPressed, this, &AppsListWidget::launchTopHit);
+    mainLayout->addWidget(m_searchBox);
+    
+    m_view = new QListView(this);
+    m_view->setModel(m_model);
+    m_view->setItemDelegate(new AppTileDelegate(m_view));
+    
+    // Fixed-size tiles flowing left to right; as many columns as fit
+    m_view->setViewMode(QListView::IconMode);
+    m_view->setFlow(QListView::LeftToRight);
+    m_view->setWrapping(true);
+    m_view->setResizeMode(QListView::Adjust);
+    m_view->setMovement(QListView::Static);
+    m_view->setUniformItemSizes(true);
+    m_view->setGridSize(QSize(AppTileDelegate::kTileWidth + kTileSpacing,
+                              AppTileDelegate::kTileHeight + kTileSpacing));
+    m_view->setSelectionMode(QAbstractItemView::NoSelection);
+    m_view->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_view->setMouseTracking(true);
+    m_view->setFrameShape(QFrame::NoFrame);
+    m_view->setStyleSheet(
+        "QListView { "
         "    border: none; "
         "    background-color: transparent; "
         "}"
@@ -44,195 +96,121 @@ void AppsListWidget::setupUI()
         "    background: #a0a0a0; "
         "}"
     );
+    m_view->viewport()->setAutoFillBackground(false);
     
-    m_scrollContent = new QWidget();
-    m_gridLayout = new QGridLayout(m_scrollContent);
-    m_gridLayout->setSpacing(15);
-    m_gridLayout->setContentsMargins(10, 10, 10, 10);
-    
-    m_scrollArea->setWidget(m_scrollContent);
-    mainLayout->addWidget(m_scrollArea);
+    connect(m_view, &QListView::clicked, this, &AppsListWidget::onAppClicked);
+    // Icons read from disk in the background for tiles that were painted
+    // without them
+    connect(IconStore::shared(), &IconStore::iconLoaded, this,
+            [this](const QString &catalog, const QString &iconPath, const QImage &icon) {
+        if (catalog == m_model->catalogId()) {
+            setIcon(iconPath, icon);
+        }
+    });
+    m_view->installEventFilter(this);
+    mainLayout->addWidget(m_view);
 }
 
-void AppsListWidget::setApps(const QList<InstalledApp> &apps)
+void AppsListWidget::setApps(const QString &catalogId, const QList<InstalledApp> &apps)
 {
-    m_apps = apps;
-    updateAppsDisplay();
+    // Only new or changed apps are indexed
+    m_searchIndex.setApps(apps);
+    m_model->setApps(catalogId, apps);
+    m_staleLabel->setVisible(m_stale && !apps.isEmpty());
+    if (!m_searchBox->text().trimmed().isEmpty()) {
+        onSearchTextChanged(m_searchBox->text());
+    }
 }
 
-void AppsListWidget::setIcon(const QString &iconPath, const QByteArray &iconData)
+void AppsListWidget::appendApps(const QString &catalogId, const QList<InstalledApp> &apps)
 {
-    // Update the specific icon if we have a button for it
-    if (m_iconPathToButton.contains(iconPath)) {
-        QPushButton *button = m_iconPathToButton[iconPath];
-        if (m_buttonToIconLabel.contains(button)) {
-            QLabel *iconLabel = m_buttonToIconLabel[button];
-            
-            // If icon data is empty, it means icon fetch failed - keep showing first letter
-            if (iconData.isEmpty()) {
-                qDebug() << "Icon fetch failed for:" << iconPath << "- keeping first letter display";
-                return;
-            }
-            
-            // Cache the icon data
-            m_iconCache[iconPath] = iconData;
-            
-            // Load and display the icon
-            QPixmap pixmap;
-            if (pixmap.loadFromData(iconData)) {
-                iconLabel->setPixmap(pixmap.scaled(64, 64, Qt::KeepAspectRatio, Qt::SmoothTransformation));
-                iconLabel->setStyleSheet("background-color: transparent;");
-                qDebug() << "Icon loaded successfully for:" << iconPath;
-            } else {
-                // Failed to load pixmap from data - keep showing first letter
-                qDebug() << "Failed to load pixmap from icon data for:" << iconPath;
-            }
-        }
+    if (catalogId != m_model->catalogId()) {
+        setApps(catalogId, apps);
+        return;
     }
+    m_searchIndex.appendApps(apps, m_model->appCount());
+    m_model->appendApps(catalogId, apps);
+}
+
+void AppsListWidget::setIcon(const QString &iconPath, const QImage &icon)
+{
+    // A failed fetch keeps whatever is shown; a stored one is picked up from
+    // the IconStore on repaint
+    if (icon.isNull()) {
+        return;
+    }
+
+    // A burst of icons repaints once per frame, and only the visible tiles
+    m_changedIcons.insert(iconPath);
+    FrameCoalescer::shared()->post(this, QStringLiteral("icons"), [this]() {
+        const QSet<QString> changed = std::move(m_changedIcons);
+        m_changedIcons.clear();
+        return m_model->refreshIcons(changed);
+    });
 }
 
 void AppsListWidget::clear()
 {
-    m_apps.clear();
-    m_iconCache.clear();
-    m_buttonToApp.clear();
-    m_iconPathToButton.clear();
-    m_buttonToIconLabel.clear();
-    
-    // Clear all widgets from grid
-    QLayoutItem *item;
-    while ((item = m_gridLayout->takeAt(0)) != nullptr) {
-        if (item->widget()) {
-            item->widget()->deleteLater();
-        }
-        delete item;
+    // Icons stay in the IconStore and show up again without a download
+    m_searchIndex.clear();
+    m_model->clear();
+    m_staleLabel->hide();
+}
+
+void AppsListWidget::setStale(bool stale)
+{
+    m_stale = stale;
+    m_staleLabel->setVisible(m_stale && m_searchIndex.size() > 0);
+}
+
+void AppsListWidget::onSearchTextChanged(const QString &text)
+{
+    if (text.trimmed().isEmpty()) {
+        m_model->clearFilter();
+        return;
     }
+    m_model->setFilter(m_searchIndex.search(text));
+    m_view->scrollToTop();
 }
 
-void AppsListWidget::updateAppsDisplay()
+void AppsListWidget::launchTopHit()
 {
-    // Clear existing widgets
-    QLayoutItem *item;
-    while ((item = m_gridLayout->takeAt(0)) != nullptr) {
-        if (item->widget()) {
-            item->widget()->deleteLater();
-        }
-        delete item;
+    if (m_model->isFiltered() && m_model->rowCount() > 0) {
+        onAppClicked(m_model->index(0));
     }
-    m_buttonToApp.clear();
-    m_iconPathToButton.clear();
-    m_buttonToIconLabel.clear();
-    
-    const int columns = 4;
-    int row = 0;
-    int col = 0;
-    
-    for (const InstalledApp &app : m_apps) {
-        // Create app button
-        QPushButton *appButton = new QPushButton(m_scrollContent);
-        appButton->setFixedSize(120, 140);
-        appButton->setStyleSheet(
-            "QPushButton { "
-            "    background-color: white; "
-            "    border: 1px solid #e0e0e0; "
-            "    border-radius: 8px; "
-            "    padding: 10px; "
-            "    text-align: center; "
-            "}"
-            "QPushButton:hover { "
-            "    background-color: #f5f5f5; "
-            "    border: 1px solid #1a535c; "
-            "}"
-        );
-        
-        // Create vertical layout for button content
-        QVBoxLayout *buttonLayout = new QVBoxLayout(appButton);
-        buttonLayout->setContentsMargins(5, 5, 5, 5);
-        buttonLayout->setSpacing(8);
-        
-        // Icon
-        QLabel *iconLabel = new QLabel(appButton);
-        iconLabel->setFixedSize(64, 64);
-        iconLabel->setAlignment(Qt::AlignCenter);
-        iconLabel->setStyleSheet("background-color: transparent;");
-        
-        // Store mapping for icon updates
-        m_buttonToIconLabel[appButton] = iconLabel;
-        if (!app.iconPath.isEmpty()) {
-            m_iconPathToButton[app.iconPath] = appButton;
+}
+
+bool AppsListWidget::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == m_searchBox && event->type() == QEvent::KeyPress) {
+        const int key = static_cast<QKeyEvent *>(event)->key();
+        if (key == Qt::Key_Escape && !m_searchBox->text().isEmpty()) {
+            m_searchBox->clear();
+            return true;
         }
-        
-        // Try to load icon from cache
-        if (!app.iconPath.isEmpty() && m_iconCache.contains(app.iconPath)) {
-            QPixmap pixmap;
-            if (pixmap.loadFromData(m_iconCache[app.iconPath])) {
-                iconLabel->setPixmap(pixmap.scaled(64, 64, Qt::KeepAspectRatio, Qt::SmoothTransformation));
-            } else {
-                // Fallback: show first letter
-                iconLabel->setText(app.name.isEmpty() ? QString("?") : QString(app.name.at(0).toUpper()));
-                iconLabel->setStyleSheet(
-                    "background-color: #1a535c; "
-                    "color: white; "
-                    "border-radius: 8px; "
-                    "font-size: 24px; "
-                    "font-weight: bold;"
-                );
-            }
-        } else {
-            // Fallback: show first letter (icon will be updated when received)
-            iconLabel->setText(app.name.isEmpty() ? QString("?") : QString(app.name.at(0).toUpper()));
-            iconLabel->setStyleSheet(
-                "background-color: #1a535c; "
-                "color: white; "
-                "border-radius: 8px; "
-                "font-size: 24px; "
-                "font-weight: bold;"
-            );
+        if (key == Qt::Key_Down && m_model->rowCount() > 0) {
+            // Arrow keys then move between tiles and Enter launches
+            m_view->setFocus();
+            m_view->setCurrentIndex(m_model->index(0));
+            return true;
         }
-        
-        // App name
-        QLabel *nameLabel = new QLabel(app.name, appButton);
-        nameLabel->setAlignment(Qt::AlignCenter);
-        nameLabel->setWordWrap(true);
-        nameLabel->setStyleSheet(
-            "color: #1a535c; "
-            "font-size: 12px; "
-            "font-weight: 500; "
-            "background-color: transparent;"
-        );
-        nameLabel->setMaximumHeight(40);
-        
-        buttonLayout->addWidget(iconLabel, 0, Qt::AlignCenter);
-        buttonLayout->addWidget(nameLabel);
-        buttonLayout->addStretch();
-        
-        // Store mapping for click handler - store full app info
-        m_buttonToApp[appButton] = app;
-        
-        connect(appButton, &QPushButton::clicked, this, &AppsListWidget::onAppClicked);
-        
-        // Add to grid
-        m_gridLayout->addWidget(appButton, row, col);
-        
-        col++;
-        if (col >= columns) {
-            col = 0;
-            row++;
+    } else if (watched == m_view && event->type() == QEvent::KeyPress) {
+        const int key = static_cast<QKeyEvent *>(event)->key();
+        if (key == Qt::Key_Return || key == Qt::Key_Enter) {
+            onAppClicked(m_view->currentIndex());
+            return true;
         }
     }
-    
-    // Add stretch at the end
-    m_gridLayout->setRowStretch(row + 1, 1);
+    return QWidget::eventFilter(watched, event);
 }
 
-void AppsListWidget::onAppClicked()
+void AppsListWidget::onAppClicked(const QModelIndex &index)
 {
-    QPushButton *button = qobject_cast<QPushButton*>(sender());
-    if (!button || !m_buttonToApp.contains(button)) {
+    if (!index.isValid()) {
         return;
     }
     
-    const InstalledApp &app = m_buttonToApp[button];
+    const InstalledApp app = m_model->app(index.row());
     qDebug() << "App clicked:" << app.name;
     
     QString executablePath;
@@ -2,14 +2,19 @@
 #define APPSLISTWIDGET_H
 
 #include <QWidget>
-#include <QScrollArea>
-#include <QVBoxLayout>
-#include <QGridLayout>
 #include <QLabel>
-#include <QPushButton>
-#include <QMap>
+#include <QLineEdit>
+#include <QListView>
+#include <QSet>
+#include "appsearchindex.h"
 #include "guestserverappsclient.h"
 
+class AppsModel;
+
+// All Apps grid: a QListView in icon mode over an AppsModel. Only visible
+// tiles are painted and the column count follows the width of the view.
+// The search box above it filters the grid as you type; Enter launches the
+// best match.
 class AppsListWidget : public QWidget
 {
     Q_OBJECT
@@ -18,27 +23,35 @@ public:
     explicit AppsListWidget(QWidget *parent = nullptr);
     ~AppsListWidget();
     
-    void setApps(const QList<InstalledApp> &apps);
-    void setIcon(const QString &iconPath, const QByteArray &iconData);
+    void setApps(const QString &catalogId, const QList<InstalledApp> &apps);
+    // Part of a list that is still downloading
+    void appendApps(const QString &catalogId, const QList<InstalledApp> &apps);
+    void setIcon(const QString &iconPath, const QImage &icon);
     void clear();
+    
+    // Stale apps come from the cache and are not confirmed by the guest yet
+    void setStale(bool stale);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private slots:
-    void onAppClicked();
+    void onAppClicked(const QModelIndex &index);
+    void onSearchTextChanged(const QString &text);
+    void launchTopHit();
 
 private:
     void setupUI();
-    void updateAppsDisplay();
     void launchAppWithXfreerdp(const QString &appName, const QString &appPath);
     
-    QScrollArea *m_scrollArea;
-    QWidget *m_scrollContent;
-    QGridLayout *m_gridLayout;
-    QList<InstalledApp> m_apps;
-    QMap<QString, QByteArray> m_iconCache;
-    QMap<QPushButton*, InstalledApp> m_buttonToApp;  // Store full app info for launching
-    QMap<QString, QPushButton*> m_iconPathToButton;
-    QMap<QPushButton*, QLabel*> m_buttonToIconLabel;
+    QLabel *m_staleLabel;
+    QLineEdit *m_searchBox;
+    QListView *m_view;
+    AppsModel *m_model;
+    AppSearchIndex m_searchIndex;
+    bool m_stale;
+    // Icons that arrived since the last frame
+    QSet<QString> m_changedIcons;
 };
 
 #endif // APPSLISTWIDGET_H
-
@@ -0,0 +1,204 @@
+#include "appsmodel.h"
+#include "iconstore.h"
+
+namespace {
+// Same tiles in the same order; other fields are not shown
+bool sameTiles(const QList<InstalledApp> &a, const QList<InstalledApp> &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int i = 0; i < a.size(); ++i) {
+        if (a.at(i).name != b.at(i).name || a.at(i).iconPath != b.at(i).iconPath
+            || a.at(i).publisher != b.at(i).publisher) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+AppsModel::AppsModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_filtered(false)
+{
+}
+
+int AppsModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return m_filtered ? m_visible.size() : m_apps.size();
+}
+
+QVariant AppsModel::data(const QModelIndex &index, int role) const
+{
+    const int row = index.isValid() ? sourceRow(index.row()) : -1;
+    if (row < 0) {
+        return QVariant();
+    }
+
+    const InstalledApp &app = m_apps.at(row);
+    switch (role) {
+    case Qt::DisplayRole:
+        return app.name;
+    case Qt::ToolTipRole:
+        return app.publisher.isEmpty() ? app.name : QStringLiteral("%1\n%2").arg(app.name, app.publisher);
+    case Qt::DecorationRole: {
+        const QPixmap icon = iconFor(app.iconPath);
+        return icon.isNull() ? QVariant() : QVariant(icon);
+    }
+    case IconPathRole:
+        return app.iconPath;
+    case InitialRole:
+        return app.name.isEmpty() ? QStringLiteral("?") : QString(app.name.at(0).toUpper());
+    case PublisherRole:
+        return app.publisher;
+    }
+    return QVariant();
+}
+
+void AppsModel::setApps(const QString &catalogId, const QList<InstalledApp> &apps)
+{
+    if (catalogId == m_catalogId && sameTiles(apps, m_apps)) {
+        m_apps = apps;
+        return;
+    }
+
+    beginResetModel();
+    m_catalogId = catalogId;
+    m_apps = apps;
+    m_filtered = false;
+    m_visible.clear();
+    m_visibleRow.clear();
+    m_rowsByIconPath.clear();
+    for (int row = 0; row < m_apps.size(); ++row) {
+        const QString &iconPath = m_apps.at(row).iconPath;
+        if (!iconPath.isEmpty()) {
+            m_rowsByIconPath[iconPath].append(row);
+        }
+    }
+    endResetModel();
+}
+
+void AppsModel::appendApps(const QString &catalogId, const QList<InstalledApp> &apps)
+{
+    if (catalogId != m_catalogId) {
+        setApps(catalogId, apps);
+        return;
+    }
+    if (apps.isEmpty()) {
+        return;
+    }
+
+    // Search results stay as they are until the list is complete
+    const int first = m_apps.size();
+    if (!m_filtered) {
+        beginInsertRows(QModelIndex(), first, first + apps.size() - 1);
+    }
+    for (int i = 0; i < apps.size(); ++i) {
+        m_apps.append(apps.at(i));
+        const QString &iconPath = apps.at(i).iconPath;
+        if (!iconPath.isEmpty()) {
+            m_rowsByIconPath[iconPath].append(first + i);
+        }
+        if (m_filtered) {
+            m_visibleRow.append(-1);
+        }
+    }
+    if (!m_filtered) {
+        endInsertRows();
+    }
+}
+
+bool AppsModel::refreshIcons(const QSet<QString> &iconPaths)
+{
+    int first = m_apps.size();
+    int last = -1;
+    for (const QString &iconPath : iconPaths) {
+        auto rows = m_rowsByIconPath.constFind(iconPath);
+        if (rows == m_rowsByIconPath.constEnd()) {
+            continue;
+        }
+        for (int row : *rows) {
+            if (m_filtered) {
+                row = m_visibleRow.at(row);
+                if (row < 0) {
+                    continue;
+                }
+            }
+            first = qMin(first, row);
+            last = qMax(last, row);
+        }
+    }
+    if (last < 0) {
+        return false;
+    }
+
+    // The view only repaints the visible part of the span
+    emit dataChanged(index(first), index(last), {Qt::DecorationRole});
+    return true;
+}
+
+void AppsModel::clear()
+{
+    beginResetModel();
+    m_apps.clear();
+    m_rowsByIconPath.clear();
+    m_filtered = false;
+    m_visible.clear();
+    m_visibleRow.clear();
+    endResetModel();
+}
+
+void AppsModel::setFilter(const QVector<int> &rows)
+{
+    beginResetModel();
+    m_filtered = true;
+    m_visible.clear();
+    m_visibleRow.fill(-1, m_apps.size());
+    for (int row : rows) {
+        if (row >= 0 && row < m_apps.size() && m_visibleRow.at(row) < 0) {
+            m_visibleRow[row] = m_visible.size();
+            m_visible.append(row);
+        }
+    }
+    endResetModel();
+}
+
+void AppsModel::clearFilter()
+{
+    if (!m_filtered) {
+        return;
+    }
+    beginResetModel();
+    m_filtered = false;
+    m_visible.clear();
+    m_visibleRow.clear();
+    endResetModel();
+}
+
+InstalledApp AppsModel::app(int row) const
+{
+    row = sourceRow(row);
+    return row >= 0 ? m_apps.at(row) : InstalledApp();
+}
+
+int AppsModel::sourceRow(int row) const
+{
+    if (m_filtered) {
+        return row >= 0 && row < m_visible.size() ? m_visible.at(row) : -1;
+    }
+    return row >= 0 && row < m_apps.size() ? row : -1;
+}
+
+QPixmap AppsModel::iconFor(const QString &iconPath) const
+{
+    if (iconPath.isEmpty()) {
+        return QPixmap();
+    }
+    // A null pixmap means "no icon (yet), show the letter". Painting never
+    // waits for the disk; AppsListWidget repaints once a blob is read.
+    return IconStore::shared()->pixmapIfLoaded(m_catalogId, iconPath);
+}
@@ -0,0 +1,63 @@
+#ifndef APPSMODEL_H
+#define APPSMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QList>
+#include <QPixmap>
+#include <QSet>
+#include <QVector>
+#include "guestserverappsclient.h"
+
+// Flat list of a guest's installed apps for the All Apps grid. Icons are
+// looked up in the IconStore (and its QPixmapCache) when a tile is painted,
+// so only the visible ones are ever loaded, in the background, and repainted
+// when a fresh one arrives.
+class AppsModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        IconPathRole = Qt::UserRole + 1,
+        InitialRole,             // Letter shown while there is no icon
+        PublisherRole
+    };
+
+    explicit AppsModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    // An unchanged list (e.g. a revalidated cache) keeps the view as it is
+    void setApps(const QString &catalogId, const QList<InstalledApp> &apps);
+    // Adds rows at the end, e.g. while a list is still downloading
+    void appendApps(const QString &catalogId, const QList<InstalledApp> &apps);
+    // Repaints the tiles showing these icons with one dataChanged for the
+    // span they cover; returns false if none of them is in the list
+    bool refreshIcons(const QSet<QString> &iconPaths);
+    void clear();
+
+    // Shows only these rows of the list, in this order (search results)
+    void setFilter(const QVector<int> &rows);
+    void clearFilter();
+    bool isFiltered() const { return m_filtered; }
+
+    InstalledApp app(int row) const;
+    QString catalogId() const { return m_catalogId; }
+    // Whole list, filtered or not
+    int appCount() const { return m_apps.size(); }
+
+private:
+    QPixmap iconFor(const QString &iconPath) const;
+    int sourceRow(int row) const;
+
+    QString m_catalogId;
+    QList<InstalledApp> m_apps;
+    QHash<QString, QList<int>> m_rowsByIconPath;
+    bool m_filtered;
+    QVector<int> m_visible;         // Shown row -> list row
+    QVector<int> m_visibleRow;      // List row -> shown row, or -1
+};
+
+#endif // APPSMODEL_H
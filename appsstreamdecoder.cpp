@@ -0,0 +1,276 @@
+#include "appsstreamdecoder.h"
+#include "cborcodec.h"
+
+namespace {
+// A single app record is small; anything larger is not a sane response
+constexpr int kMaxObjectBytes = 1024 * 1024;
+} // namespace
+
+AppsStreamDecoder::AppsStreamDecoder()
+    : m_pos(0)
+    , m_depth(0)
+    , m_inString(false)
+    , m_escape(false)
+    , m_stringStart(-1)
+    , m_objectStart(-1)
+    , m_phase(SeekingApps)
+    , m_afterColon(false)
+    , m_format(Unknown)
+    , m_cborInMap(false)
+    , m_cborKeyRead(false)
+    , m_cborPairs(0)
+    , m_cborItems(0)
+    , m_failed(false)
+    , m_bytesRead(0)
+    , m_peakBuffered(0)
+{
+}
+
+QList<InstalledApp> AppsStreamDecoder::feed(const QByteArray &chunk)
+{
+    QList<InstalledApp> apps;
+    if (m_failed || chunk.isEmpty()) {
+        return apps;
+    }
+    m_bytesRead += chunk.size();
+    m_buffer.append(chunk);
+    m_peakBuffered = qMax(m_peakBuffered, m_buffer.size());
+
+    // REDFLAG only sends CBOR when asked; the first byte tells which arrived
+    if (m_format == Unknown) {
+        int first = 0;
+        while (first < m_buffer.size() && QChar::isSpace(uchar(m_buffer.at(first)))) {
+            ++first;
+        }
+        if (first == m_buffer.size()) {
+            return apps;
+        }
+        m_format = CborCodec::startsWithMap(m_buffer.constData() + first, m_buffer.size() - first) ? Cbor : Json;
+    }
+    if (m_format == Cbor) {
+        feedCbor(apps);
+    } else {
+        feedJson(apps);
+    }
+    return apps;
+}
+
+void AppsStreamDecoder::feedJson(QList<InstalledApp> &apps)
+{
+    const char *data = m_buffer.constData();
+    const int size = m_buffer.size();
+    for (int i = m_pos; i < size; ++i) {
+        const char c = data[i];
+        if (m_inString) {
+            if (m_escape) {
+                m_escape = false;
+            } else if (c == '\\') {
+                m_escape = true;
+            } else if (c == '"') {
+                m_inString = false;
+                // Top-level keys and the "error" value; app strings are left
+                // to the object parser
+                if (m_depth == 1 && m_phase != InApps) {
+                    const QString text = decodeString(data + m_stringStart, data + i + 1);
+                    if (!m_afterColon) {
+                        m_key = text;
+                    } else if (m_key == QLatin1String("error")) {
+                        m_error = text;
+                    }
+                }
+                m_stringStart = -1;
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            m_inString = true;
+            m_stringStart = i;
+            break;
+        case '{':
+        case '[':
+            if (m_phase == InApps && m_depth == 2 && c == '{') {
+                m_objectStart = i;
+            } else if (m_phase == SeekingApps && m_depth == 1 && c == '[' && m_afterColon
+                       && m_key == QLatin1String("apps")) {
+                m_phase = InApps;
+            }
+            ++m_depth;
+            break;
+        case '}':
+        case ']':
+            --m_depth;
+            if (m_depth < 0) {
+                m_failed = true;
+                m_error = QStringLiteral("Malformed apps response");
+                return;
+            }
+            if (m_phase == InApps) {
+                if (c == '}' && m_depth == 2 && m_objectStart >= 0) {
+                    InstalledApp app;
+                    if (JsonCodec::decode(data + m_objectStart, data + i + 1, app)) {
+                        apps.append(app);
+                    }
+                    m_objectStart = -1;
+                } else if (c == ']' && m_depth == 1) {
+                    m_phase = AfterApps;
+                }
+            }
+            break;
+        case ':':
+            if (m_depth == 1) {
+                m_afterColon = true;
+            }
+            break;
+        case ',':
+            if (m_depth == 1) {
+                m_afterColon = false;
+                m_key.clear();
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Keep only what an unfinished object or string still needs
+    int keep = size;
+    if (m_objectStart >= 0) {
+        keep = m_objectStart;
+    } else if (m_inString && m_stringStart >= 0) {
+        keep = m_stringStart;
+    }
+    if (size - keep > kMaxObjectBytes) {
+        m_failed = true;
+        m_error = QStringLiteral("Apps response record too large");
+        m_buffer.clear();
+        return;
+    }
+    m_buffer.remove(0, keep);
+    m_pos = m_buffer.size();
+    if (m_objectStart >= 0) {
+        m_objectStart -= keep;
+    }
+    if (m_stringStart >= 0) {
+        m_stringStart -= keep;
+    }
+}
+
+void AppsStreamDecoder::feedCbor(QList<InstalledApp> &apps)
+{
+    // Nothing after the apps array is read
+    if (m_phase == AfterApps) {
+        m_buffer.clear();
+        return;
+    }
+
+    // Items are only decoded once they are complete, so each step either
+    // consumes a whole header or item or waits for more data
+    const char *data = m_buffer.constData();
+    const int size = m_buffer.size();
+    int pos = 0;
+    while (!m_failed && m_phase != AfterApps) {
+        CborCodec::Header header;
+        if (!m_cborInMap) {
+            const int length = CborCodec::readHeader(data, size, pos, header);
+            if (length == 0) {
+                break;
+            }
+            if (length < 0 || header.type != CborCodec::Map) {
+                m_failed = true;
+                break;
+            }
+            m_cborInMap = true;
+            m_cborPairs = header.indefinite ? -1 : qint64(header.value);
+            pos += length;
+            continue;
+        }
+
+        if (m_phase == InApps) {
+            const bool breakByte = pos < size && uchar(data[pos]) == 0xff;
+            if (m_cborItems == 0 || (m_cborItems < 0 && breakByte)) {
+                m_phase = AfterApps;
+                pos = size;
+                break;
+            }
+            const int end = CborCodec::itemEnd(data, size, pos);
+            if (end == -1) {
+                break;
+            }
+            if (end < 0) {
+                m_failed = true;
+                break;
+            }
+            InstalledApp app;
+            if (CborCodec::decode(data + pos, data + end, app)) {
+                apps.append(app);
+            }
+            pos = end;
+            if (m_cborItems > 0) {
+                --m_cborItems;
+            }
+            continue;
+        }
+
+        // Between top-level pairs; a map without "apps" is only an error
+        if (m_cborPairs == 0 || (m_cborPairs < 0 && pos < size && uchar(data[pos]) == 0xff)) {
+            pos = size;
+            break;
+        }
+        if (m_cborKeyRead && m_key == QLatin1String("apps")) {
+            const int length = CborCodec::readHeader(data, size, pos, header);
+            if (length == 0) {
+                break;
+            }
+            if (length < 0 || header.type != CborCodec::Array) {
+                m_failed = true;
+                break;
+            }
+            m_phase = InApps;
+            m_cborItems = header.indefinite ? -1 : qint64(header.value);
+            pos += length;
+            continue;
+        }
+        const int end = CborCodec::itemEnd(data, size, pos);
+        if (end == -1) {
+            break;
+        }
+        if (end < 0) {
+            m_failed = true;
+            break;
+        }
+        if (!m_cborKeyRead) {
+            m_key.clear();
+            CborCodec::decode(data + pos, data + end, m_key);
+        } else if (m_key == QLatin1String("error")) {
+            CborCodec::decode(data + pos, data + end, m_error);
+        }
+        if (m_cborKeyRead && m_cborPairs > 0) {
+            --m_cborPairs;
+        }
+        m_cborKeyRead = !m_cborKeyRead;
+        pos = end;
+    }
+
+    if (m_failed) {
+        m_error = QStringLiteral("Malformed apps response");
+        m_buffer.clear();
+        return;
+    }
+    if (size - pos > kMaxObjectBytes) {
+        m_failed = true;
+        m_error = QStringLiteral("Apps response record too large");
+        m_buffer.clear();
+        return;
+    }
+    m_buffer.remove(0, pos);
+}
+
+QString AppsStreamDecoder::decodeString(const char *begin, const char *end)
+{
+    JsonCodec::Reader reader(begin, end);
+    QString text;
+    reader.readValue(text);
+    return text;
+}
@@ -0,0 +1,61 @@
+#ifndef APPSSTREAMDECODER_H
+#define APPSSTREAMDECODER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include "guestserverappsclient.h"
+
+// Incremental decoder for the /apps response, {"apps": [{...}, ...], ...},
+// sent as JSON or CBOR. Bytes are fed as they arrive; every app is decoded
+// straight from the buffer as soon as it is complete, and only the record
+// being read is buffered, so memory does not grow with the size of the
+// response. A top-level "error" string is picked up as well.
+class AppsStreamDecoder
+{
+public:
+    AppsStreamDecoder();
+
+    // Returns the apps completed by this chunk, in order. Records that do not
+    // decode are skipped.
+    QList<InstalledApp> feed(const QByteArray &chunk);
+
+    bool sawApps() const { return m_phase != SeekingApps; }
+    bool isComplete() const { return m_phase == AfterApps; }
+    bool hasFailed() const { return m_failed; }
+    bool isCbor() const { return m_format == Cbor; }
+    QString errorString() const { return m_error; }
+    qint64 bytesRead() const { return m_bytesRead; }
+    // Largest amount of the response held at once
+    int peakBuffered() const { return m_peakBuffered; }
+
+private:
+    enum Phase { SeekingApps, InApps, AfterApps };
+    enum Format { Unknown, Json, Cbor };
+
+    void feedJson(QList<InstalledApp> &apps);
+    void feedCbor(QList<InstalledApp> &apps);
+    static QString decodeString(const char *begin, const char *end);
+
+    QByteArray m_buffer;
+    int m_pos;
+    int m_depth;
+    bool m_inString;
+    bool m_escape;
+    int m_stringStart;
+    int m_objectStart;
+    Phase m_phase;
+    QString m_key;          // Top-level key whose value is being read
+    bool m_afterColon;
+    Format m_format;
+    bool m_cborInMap;       // Top-level map header read
+    bool m_cborKeyRead;     // m_key holds the key of the next value
+    qint64 m_cborPairs;     // Left in the top-level map; -1 if indefinite
+    qint64 m_cborItems;     // Left in the apps array; -1 if indefinite
+    bool m_failed;
+    QString m_error;
+    qint64 m_bytesRead;
+    int m_peakBuffered;
+};
+
+#endif // APPSSTREAMDECODER_H
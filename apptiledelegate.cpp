@@ -0,0 +1,106 @@
+#include "apptiledelegate.h"
+#include "appsmodel.h"
+#include "iconstore.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <QTextLayout>
+#include <utility>
+
+namespace {
+constexpr int kPadding = 10;
+constexpr int kNameSpacing = 8;
+constexpr int kNameMaxLines = 2;
+const QColor kTileColor(Qt::white);
+const QColor kTileHoverColor(0xf5, 0xf5, 0xf5);
+const QColor kBorderColor(0xe0, 0xe0, 0xe0);
+const QColor kAccentColor(0x1a, 0x53, 0x5c);
+
+// Word-wrapped text, elided on the last line that fits
+void drawWrappedText(QPainter *painter, const QRect &rect, const QString &text, const QFont &font)
+{
+    const QFontMetrics metrics(font);
+    QTextLayout layout(text, font);
+    QTextOption option(Qt::AlignHCenter);
+    option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    layout.setTextOption(option);
+
+    QStringList lines;
+    layout.beginLayout();
+    for (int i = 0; i < kNameMaxLines; ++i) {
+        QTextLine line = layout.createLine();
+        if (!line.isValid()) {
+            break;
+        }
+        line.setLineWidth(rect.width());
+        if (i == kNameMaxLines - 1) {
+            lines.append(metrics.elidedText(text.mid(line.textStart()), Qt::ElideRight, rect.width()));
+        } else {
+            lines.append(text.mid(line.textStart(), line.textLength()).trimmed());
+        }
+    }
+    layout.endLayout();
+
+    painter->setFont(font);
+    int y = rect.top();
+    for (const QString &line : std::as_const(lines)) {
+        painter->drawText(QRect(rect.left(), y, rect.width(), metrics.height()), Qt::AlignHCenter | Qt::AlignTop, line);
+        y += metrics.height();
+    }
+}
+} // namespace
+
+AppTileDelegate::AppTileDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+{
+    m_initialFont.setPixelSize(24);
+    m_initialFont.setBold(true);
+    m_nameFont.setPixelSize(12);
+    m_nameFont.setWeight(QFont::Medium);
+}
+
+void AppTileDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+
+    // Card
+    const bool hovered = option.state & QStyle::State_MouseOver;
+    const QRectF card = QRectF(option.rect).adjusted(0.5, 0.5, -0.5, -0.5);
+    painter->setPen(hovered ? kAccentColor : kBorderColor);
+    painter->setBrush(hovered ? kTileHoverColor : kTileColor);
+    painter->drawRoundedRect(card, 8, 8);
+
+    // Icon, or the initial on an accent square until one arrives
+    const int iconSize = IconStore::kIconSize;
+    const QRect iconRect(option.rect.left() + (option.rect.width() - iconSize) / 2,
+                         option.rect.top() + kPadding, iconSize, iconSize);
+    const QPixmap icon = index.data(Qt::DecorationRole).value<QPixmap>();
+    if (!icon.isNull()) {
+        QSize size = icon.size() / icon.devicePixelRatio();
+        size.scale(iconRect.size(), Qt::KeepAspectRatio);
+        QRect target(QPoint(), size);
+        target.moveCenter(iconRect.center());
+        painter->setRenderHint(QPainter::SmoothPixmapTransform);
+        painter->drawPixmap(target, icon);
+    } else {
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(kAccentColor);
+        painter->drawRoundedRect(iconRect, 8, 8);
+        painter->setPen(Qt::white);
+        painter->setFont(m_initialFont);
+        painter->drawText(iconRect, Qt::AlignCenter, index.data(AppsModel::InitialRole).toString());
+    }
+
+    // Name
+    const QRect nameRect(option.rect.left() + kPadding / 2, iconRect.bottom() + 1 + kNameSpacing,
+                         option.rect.width() - kPadding, option.rect.bottom() - iconRect.bottom() - kNameSpacing);
+    painter->setPen(kAccentColor);
+    drawWrappedText(painter, nameRect, index.data(Qt::DisplayRole).toString(), m_nameFont);
+
+    painter->restore();
+}
+
+QSize AppTileDelegate::sizeHint(const QStyleOptionViewItem &, const QModelIndex &) const
+{
+    return QSize(kTileWidth, kTileHeight);
+}
@@ -0,0 +1,28 @@
+#ifndef APPTILEDELEGATE_H
+#define APPTILEDELEGATE_H
+
+#include <QFont>
+#include <QStyledItemDelegate>
+
+// Paints one app tile of the All Apps grid: a rounded card with the icon (or
+// the app's initial) above its name. Tiles are painted on demand instead of
+// being built from per-app widgets.
+class AppTileDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kTileWidth = 120;
+    static constexpr int kTileHeight = 140;
+
+    explicit AppTileDelegate(QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+    QFont m_initialFont;
+    QFont m_nameFont;
+};
+
+#endif // APPTILEDELEGATE_H
@@ -0,0 +1,287 @@
+#include "asynctask.h"
+#include <QProcess>
+#include <QNetworkReply>
+#include <QRunnable>
+#include <QDebug>
+
+namespace {
+class FunctionRunnable : public QRunnable
+{
+public:
+    explicit FunctionRunnable(std::function<void()> func) : m_func(std::move(func)) {}
+    void run() override { m_func(); }
+
+private:
+    std::function<void()> m_func;
+};
+} // namespace
+
+AsyncTask::AsyncTask(int deadlineMs, QObject *parent)
+    : QObject(parent)
+    , m_state(Pending)
+    , m_deadline(deadlineMs > 0 ? QDeadlineTimer(deadlineMs) : QDeadlineTimer(QDeadlineTimer::Forever))
+    , m_deadlineTimer(new QTimer(this))
+{
+    static const int typeId = qRegisterMetaType<TaskResult>("TaskResult");
+    Q_UNUSED(typeId);
+
+    m_deadlineTimer->setSingleShot(true);
+    connect(m_deadlineTimer, &QTimer::timeout, this, &AsyncTask::onDeadline);
+}
+
+void AsyncTask::cancel()
+{
+    if (m_state == Finished) {
+        return;
+    }
+    if (m_state == Running) {
+        abortWork();
+    }
+    finishWithStatus(TaskResult::Canceled, QStringLiteral("canceled"));
+}
+
+void AsyncTask::begin()
+{
+    if (m_state != Pending) {
+        return;
+    }
+    if (m_deadline.hasExpired()) {
+        finishWithStatus(TaskResult::TimedOut, QStringLiteral("timeout"));
+        return;
+    }
+
+    m_state = Running;
+    if (!m_deadline.isForever()) {
+        m_deadlineTimer->start(static_cast<int>(qMax<qint64>(0, m_deadline.remainingTime())));
+    }
+    emit started();
+    startWork();
+}
+
+void AsyncTask::onDeadline()
+{
+    if (m_state != Running) {
+        return;
+    }
+    abortWork();
+    finishWithStatus(TaskResult::TimedOut, QStringLiteral("timeout"));
+}
+
+void AsyncTask::finish(TaskResult result)
+{
+    if (m_state == Finished) {
+        return;
+    }
+    m_state = Finished;
+    m_deadlineTimer->stop();
+    m_result = std::move(result);
+    emit finished(m_result);
+
+    if (canDeleteNow()) {
+        deleteLater();
+    }
+}
+
+void AsyncTask::finishWithStatus(TaskResult::Status status, const QString &error)
+{
+    TaskResult result;
+    result.status = status;
+    result.errorString = error;
+    finish(result);
+}
+
+ProcessTask::ProcessTask(const QString &program, const QStringList &args, int deadlineMs, QObject *parent)
+    : AsyncTask(deadlineMs, parent)
+    , m_program(program)
+    , m_args(args)
+    , m_process(nullptr)
+{
+}
+
+void ProcessTask::startWork()
+{
+    m_process = new QProcess(this);
+
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            finishWithStatus(TaskResult::Failed, m_process->errorString());
+        }
+    });
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [this](int exitCode, QProcess::ExitStatus exitStatus) {
+                TaskResult result;
+                result.exitCode = exitCode;
+                result.output = m_process->readAllStandardOutput();
+                result.errorString = QString::fromLocal8Bit(m_process->readAllStandardError());
+                result.status = (exitStatus == QProcess::NormalExit && exitCode == 0)
+                    ? TaskResult::Ok : TaskResult::Failed;
+                finish(result);
+            });
+
+    m_process->start(m_program, m_args);
+}
+
+void ProcessTask::abortWork()
+{
+    if (m_process && m_process->state() != QProcess::NotRunning) {
+        // Drop the signals first so the kill does not report a second result
+        m_process->disconnect(this);
+        m_process->kill();
+    }
+}
+
+ReplyTask::ReplyTask(std::function<QNetworkReply *()> send, int deadlineMs, QObject *parent)
+    : AsyncTask(deadlineMs, parent)
+    , m_send(std::move(send))
+{
+}
+
+void ReplyTask::startWork()
+{
+    m_reply = m_send ? m_send() : nullptr;
+    if (!m_reply) {
+        finishWithStatus(TaskResult::Failed, QStringLiteral("request could not be sent"));
+        return;
+    }
+
+    connect(m_reply, &QNetworkReply::finished, this, [this]() {
+        QNetworkReply *reply = m_reply;
+        if (!reply) {
+            return;
+        }
+        reply->deleteLater();
+
+        TaskResult result;
+        result.exitCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (reply->error() == QNetworkReply::NoError) {
+            result.status = TaskResult::Ok;
+            result.output = reply->readAll();
+        } else {
+            result.status = TaskResult::Failed;
+            result.errorString = reply->errorString();
+        }
+        finish(result);
+    });
+}
+
+void ReplyTask::abortWork()
+{
+    if (m_reply) {
+        QNetworkReply *reply = m_reply;
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+FunctionTask::FunctionTask(QThreadPool *pool, std::function<QVariant()> work, int deadlineMs, QObject *parent)
+    : AsyncTask(deadlineMs, parent)
+    , m_pool(pool)
+    , m_work(std::move(work))
+    , m_workRunning(false)
+{
+}
+
+void FunctionTask::startWork()
+{
+    m_workRunning = true;
+    std::function<QVariant()> work = m_work;
+    // The task is kept alive until the worker reports back (see canDeleteNow),
+    // and the owning queue waits for its pool before deleting its tasks.
+    m_pool->start(new FunctionRunnable([this, work]() {
+        const QVariant value = work();
+        QMetaObject::invokeMethod(this, [this, value]() { onWorkDone(value); }, Qt::QueuedConnection);
+    }));
+}
+
+void FunctionTask::onWorkDone(const QVariant &value)
+{
+    m_workRunning = false;
+    if (isFinished()) {
+        // Canceled or timed out while the worker was busy; nothing to report
+        deleteLater();
+        return;
+    }
+
+    TaskResult result;
+    result.status = TaskResult::Ok;
+    result.value = value;
+    finish(result);
+}
+
+TaskQueue::TaskQueue(int maxConcurrent, QObject *parent)
+    : QObject(parent)
+    , m_maxConcurrent(qMax(1, maxConcurrent))
+{
+    m_pool.setMaxThreadCount(m_maxConcurrent);
+}
+
+TaskQueue::~TaskQueue()
+{
+    const QList<AsyncTask *> tasks = findChildren<AsyncTask *>(QString(), Qt::FindDirectChildrenOnly);
+    for (AsyncTask *task : tasks) {
+        task->disconnect(this);
+    }
+    m_pending.clear();
+    m_running.clear();
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+AsyncTask *TaskQueue::runProcess(const QString &program, const QStringList &args, int deadlineMs)
+{
+    return enqueue(new ProcessTask(program, args, deadlineMs, this));
+}
+
+AsyncTask *TaskQueue::runReply(std::function<QNetworkReply *()> send, int deadlineMs)
+{
+    return enqueue(new ReplyTask(std::move(send), deadlineMs, this));
+}
+
+AsyncTask *TaskQueue::run(std::function<QVariant()> work, int deadlineMs)
+{
+    return enqueue(new FunctionTask(&m_pool, std::move(work), deadlineMs, this));
+}
+
+void TaskQueue::setMaxConcurrent(int maxConcurrent)
+{
+    m_maxConcurrent = qMax(1, maxConcurrent);
+    m_pool.setMaxThreadCount(m_maxConcurrent);
+    startPending();
+}
+
+void TaskQueue::cancelAll()
+{
+    const QList<AsyncTask *> tasks = findChildren<AsyncTask *>(QString(), Qt::FindDirectChildrenOnly);
+    for (AsyncTask *task : tasks) {
+        task->cancel();
+    }
+}
+
+AsyncTask *TaskQueue::enqueue(AsyncTask *task)
+{
+    connect(task, &AsyncTask::started, this, [this, task]() { m_running.insert(task); });
+    connect(task, &AsyncTask::finished, this, [this, task]() { onTaskFinished(task); });
+    m_pending.enqueue(task);
+
+    // Start on the next event loop turn so callers can attach continuations first
+    QTimer::singleShot(0, this, &TaskQueue::startPending);
+    return task;
+}
+
+void TaskQueue::onTaskFinished(AsyncTask *task)
+{
+    m_pending.removeOne(task);
+    m_running.remove(task);
+    startPending();
+}
+
+void TaskQueue::startPending()
+{
+    while (m_running.size() < m_maxConcurrent && !m_pending.isEmpty()) {
+        AsyncTask *task = m_pending.dequeue();
+        if (task->state() == AsyncTask::Pending) {
+            task->begin();
+        }
+    }
+}
@@ -0,0 +1,193 @@
+#ifndef ASYNCTASK_H
+#define ASYNCTASK_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QDeadlineTimer>
+#include <QPointer>
+#include <QQueue>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
+#include <functional>
+#include <utility>
+
+class QProcess;
+class QNetworkReply;
+
+struct TaskResult {
+    enum Status {
+        Ok,
+        Failed,
+        TimedOut,
+        Canceled
+    };
+
+    Status status = Failed;
+    int exitCode = -1;        // Process exit code or HTTP status code
+    QByteArray output;        // Process stdout or reply body
+    QString errorString;      // Process stderr or reply error
+    QVariant value;           // Return value of TaskQueue::run()
+
+    bool ok() const { return status == Ok; }
+    QString text() const { return QString::fromLocal8Bit(output); }
+};
+
+Q_DECLARE_METATYPE(TaskResult)
+
+// Handle to a unit of work scheduled on a TaskQueue. A task finishes exactly
+// once (ok, failed, timed out or canceled) and deletes itself afterwards, so
+// callers should only keep it in a QPointer.
+class AsyncTask : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State {
+        Pending,
+        Running,
+        Finished
+    };
+
+    State state() const { return m_state; }
+    bool isFinished() const { return m_state == Finished; }
+    const TaskResult &result() const { return m_result; }
+
+    // Cancels the task. Pending tasks never start, running processes are
+    // killed and running replies aborted.
+    void cancel();
+
+    // Runs func(const TaskResult &) once the task has finished. The callback
+    // is dropped if context is destroyed first.
+    template <typename Func>
+    AsyncTask *then(QObject *context, Func &&func)
+    {
+        if (isFinished()) {
+            TaskResult result = m_result;
+            QTimer::singleShot(0, context, [func = std::forward<Func>(func), result]() mutable {
+                func(result);
+            });
+        } else {
+            connect(this, &AsyncTask::finished, context, std::forward<Func>(func));
+        }
+        return this;
+    }
+
+signals:
+    void started();
+    void finished(const TaskResult &result);
+
+protected:
+    explicit AsyncTask(int deadlineMs, QObject *parent = nullptr);
+
+    virtual void startWork() = 0;
+    virtual void abortWork() {}
+    virtual bool canDeleteNow() const { return true; }
+
+    void finish(TaskResult result);
+    void finishWithStatus(TaskResult::Status status, const QString &error);
+
+private:
+    friend class TaskQueue;
+
+    void begin();
+    void onDeadline();
+
+    State m_state;
+    TaskResult m_result;
+    QDeadlineTimer m_deadline;
+    QTimer *m_deadlineTimer;
+};
+
+class ProcessTask : public AsyncTask
+{
+    Q_OBJECT
+
+public:
+    ProcessTask(const QString &program, const QStringList &args, int deadlineMs, QObject *parent = nullptr);
+
+protected:
+    void startWork() override;
+    void abortWork() override;
+
+private:
+    QString m_program;
+    QStringList m_args;
+    QProcess *m_process;
+};
+
+class ReplyTask : public AsyncTask
+{
+    Q_OBJECT
+
+public:
+    ReplyTask(std::function<QNetworkReply *()> send, int deadlineMs, QObject *parent = nullptr);
+
+    QNetworkReply *reply() const { return m_reply; }
+
+protected:
+    void startWork() override;
+    void abortWork() override;
+
+private:
+    std::function<QNetworkReply *()> m_send;
+    QPointer<QNetworkReply> m_reply;
+};
+
+class FunctionTask : public AsyncTask
+{
+    Q_OBJECT
+
+public:
+    FunctionTask(QThreadPool *pool, std::function<QVariant()> work, int deadlineMs, QObject *parent = nullptr);
+
+protected:
+    void startWork() override;
+    bool canDeleteNow() const override { return !m_workRunning; }
+
+private:
+    void onWorkDone(const QVariant &value);
+
+    QThreadPool *m_pool;
+    std::function<QVariant()> m_work;
+    bool m_workRunning;
+};
+
+// Schedules process, network and worker-thread tasks without ever blocking
+// the calling (GUI) thread. At most maxConcurrent tasks run at once, the rest
+// wait in FIFO order. Deadlines count from the moment a task is queued.
+class TaskQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TaskQueue(int maxConcurrent = 4, QObject *parent = nullptr);
+    ~TaskQueue();
+
+    AsyncTask *runProcess(const QString &program, const QStringList &args, int deadlineMs = 5000);
+    AsyncTask *runReply(std::function<QNetworkReply *()> send, int deadlineMs = 10000);
+    AsyncTask *run(std::function<QVariant()> work, int deadlineMs = 10000);
+
+    void setMaxConcurrent(int maxConcurrent);
+    int maxConcurrent() const { return m_maxConcurrent; }
+    int runningCount() const { return m_running.size(); }
+    int pendingCount() const { return m_pending.size(); }
+
+    // Cancels every pending and running task of this queue
+    void cancelAll();
+
+private:
+    AsyncTask *enqueue(AsyncTask *task);
+    void onTaskFinished(AsyncTask *task);
+    void startPending();
+
+    QThreadPool m_pool;
+    QQueue<AsyncTask *> m_pending;
+    QSet<AsyncTask *> m_running;
+    int m_maxConcurrent;
+};
+
+#endif // ASYNCTASK_H
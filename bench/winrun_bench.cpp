@@ -0,0 +1,536 @@
+#include "appscache.h"
+#include "appsearchindex.h"
+#include "appsstreamdecoder.h"
+#include "guestserverappsclient.h"
+#include "iconstore.h"
+#include "theme.h"
+#include "writebehind.h"
+#include <QApplication>
+#include <QBuffer>
+#include <QCborValue>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGridLayout>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLabel>
+#include <QLinearGradient>
+#include <QLoggingCategory>
+#include <QPainter>
+#include <QPixmapCache>
+#include <QPushButton>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+// Micro-benchmarks of the apps grid's hot paths on synthetic data. Run as
+// winrun_bench [section...]; without arguments every section runs.
+//   cache   apps cache load (binary table vs the old JSON file), 1k and 10k apps
+//   icons   icon store: decode and scale, blob load, painted pixmap lookup,
+//           background blob loads for painting
+//   theme   per-widget style sheets (the old look) vs Theme roles and palettes
+//   codec   /apps decoding: QJsonDocument vs the stream decoder (JSON and CBOR)
+//   search  search-as-you-type latency over 10k apps, by query length
+// Times are the best of several runs; RSS is the growth of the resident set
+// while the result is held (Linux only, 0 elsewhere).
+
+namespace {
+constexpr int kRuns = 5;
+constexpr int kIconCount = 500;
+constexpr int kButtonCount = 40;
+constexpr int kLabelCount = 200;
+constexpr int kStatusRounds = 20;
+// Roughly what one read from the guest socket hands the decoder
+constexpr int kChunkBytes = 16 * 1024;
+constexpr int kSearchApps = 10000;
+constexpr int kMaxQueryLength = 6;
+
+double rssMb()
+{
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    while (!status.atEnd()) {
+        const QByteArray line = status.readLine();
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').value(0).toDouble() / 1024.0;
+        }
+    }
+    return 0;
+}
+
+template <typename Func>
+double bestOfMs(int runs, Func func)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < runs; ++run) {
+        QElapsedTimer elapsed;
+        elapsed.start();
+        func();
+        best = qMin(best, elapsed.nsecsElapsed() / 1.0e6);
+    }
+    return best;
+}
+
+// Shaped like a real registry listing: publishers and install roots repeat,
+// every app has its own name, path and uninstaller
+QList<InstalledApp> syntheticCatalog(int count)
+{
+    static const char *const publishers[] = {
+        "Microsoft Corporation", "Adobe Inc.", "Google LLC", "Mozilla", "JetBrains s.r.o.",
+        "Valve Corporation", "NVIDIA Corporation", "Oracle Corporation"
+    };
+    constexpr int publisherCount = sizeof(publishers) / sizeof(publishers[0]);
+
+    QList<InstalledApp> apps;
+    apps.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        InstalledApp app;
+        app.name = QStringLiteral("Application %1").arg(i);
+        app.publisher = QString::fromLatin1(publishers[i % publisherCount]);
+        app.installLocation = QStringLiteral("C:\\Program Files\\%1\\Application %2").arg(app.publisher).arg(i);
+        app.displayVersion = QStringLiteral("%1.%2.%3").arg(i % 7).arg(i % 13).arg(i % 101);
+        app.iconPath = app.installLocation + QStringLiteral("\\app.exe");
+        app.uninstallString = QStringLiteral("\"%1\\uninstall.exe\" /S").arg(app.installLocation);
+        app.iconStamp = QString::number(1600000000 + i, 16);
+        apps.append(app);
+    }
+    return apps;
+}
+
+// {"apps": [...]}, as the guest sends it and the old cache stored it
+QByteArray appsJson(const QList<InstalledApp> &apps)
+{
+    QJsonArray list;
+    for (const InstalledApp &app : apps) {
+        QJsonObject object;
+        object["name"] = app.name;
+        object["publisher"] = app.publisher;
+        object["install_location"] = app.installLocation;
+        object["display_version"] = app.displayVersion;
+        object["icon_path"] = app.iconPath;
+        object["uninstall_string"] = app.uninstallString;
+        object["icon_stamp"] = app.iconStamp;
+        list.append(object);
+    }
+    QJsonObject root;
+    root["apps"] = list;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+// The QJsonDocument path the cache and the client used before
+QList<InstalledApp> appsFromJsonDocument(const QByteArray &json)
+{
+    QList<InstalledApp> apps;
+    const QJsonArray list = QJsonDocument::fromJson(json).object().value("apps").toArray();
+    apps.reserve(list.size());
+    for (const QJsonValue &value : list) {
+        const QJsonObject object = value.toObject();
+        InstalledApp app;
+        app.name = object["name"].toString();
+        app.publisher = object["publisher"].toString();
+        app.installLocation = object["install_location"].toString();
+        app.displayVersion = object["display_version"].toString();
+        app.iconPath = object["icon_path"].toString();
+        app.uninstallString = object["uninstall_string"].toString();
+        app.iconStamp = object["icon_stamp"].toString();
+        apps.append(app);
+    }
+    return apps;
+}
+
+void benchCache()
+{
+    std::printf("\n[cache] apps cache load\n");
+    std::printf("%8s  %-12s %10s %10s %10s\n", "apps", "format", "bytes", "load ms", "rss MB");
+    for (int count : {1000, 10000}) {
+        const QList<InstalledApp> apps = syntheticCatalog(count);
+        AppsCache cache;
+        cache.setCatalog(QStringLiteral("bench-%1").arg(count));
+        if (!cache.saveApps(apps)) {
+            std::printf("%8d  could not write the cache file\n", count);
+            continue;
+        }
+        const qint64 binaryBytes = QFileInfo(AppsCache::getCacheFilePath(cache.catalog())).size();
+
+        double rssBefore = rssMb();
+        QList<InstalledApp> loaded;
+        cache.loadApps(loaded);
+        const double binaryRss = rssMb() - rssBefore;
+        const double binaryMs = bestOfMs(kRuns, [&cache]() {
+            QList<InstalledApp> again;
+            cache.loadApps(again);
+        });
+        std::printf("%8d  %-12s %10lld %10.2f %10.1f\n", count, "binary", binaryBytes, binaryMs, binaryRss);
+
+        const QByteArray json = appsJson(apps);
+        rssBefore = rssMb();
+        const QList<InstalledApp> parsed = appsFromJsonDocument(json);
+        const double jsonRss = rssMb() - rssBefore;
+        const double jsonMs = bestOfMs(kRuns, [&json]() {
+            appsFromJsonDocument(json);
+        });
+        std::printf("%8d  %-12s %10lld %10.2f %10.1f\n", count, "json", qint64(json.size()), jsonMs, jsonRss);
+
+        if (loaded.size() != apps.size() || parsed.size() != apps.size()) {
+            std::printf("%8d  loaded %d and %d apps, expected %d\n", count, int(loaded.size()),
+                        int(parsed.size()), int(apps.size()));
+        }
+        cache.clearCache();
+    }
+}
+
+// Distinct 256x256 PNGs, about the size Windows hands out for app icons
+QList<QByteArray> syntheticIcons(int count)
+{
+    QList<QByteArray> icons;
+    icons.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QImage image(256, 256, QImage::Format_ARGB32);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        QLinearGradient gradient(0, 0, 256, 256);
+        gradient.setColorAt(0, QColor::fromHsv(i * 37 % 360, 200, 230));
+        gradient.setColorAt(1, QColor::fromHsv(i * 11 % 360, 255, 120));
+        painter.setBrush(gradient);
+        painter.setPen(Qt::NoPen);
+        painter.drawRoundedRect(16, 16, 224, 224, 40, 40);
+        painter.end();
+
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "PNG");
+        icons.append(data);
+    }
+    return icons;
+}
+
+void benchIcons()
+{
+    std::printf("\n[icons] icon store, %d distinct icons\n", kIconCount);
+    std::printf("%-28s %10s %12s\n", "step", "total ms", "icons/s");
+    auto report = [](const char *step, double ms) {
+        std::printf("%-28s %10.2f %12.0f\n", step, ms, ms > 0 ? kIconCount * 1000.0 / ms : 0.0);
+    };
+
+    const QList<QByteArray> icons = syntheticIcons(kIconCount);
+    const QString catalog = QStringLiteral("bench-icons");
+    const QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/bench-icons";
+    auto iconPath = [](int i) {
+        return QStringLiteral("C:\\Program Files\\App %1\\app.exe").arg(i);
+    };
+
+    {
+        IconStore store(directory);
+        int stored = 0;
+        QElapsedTimer elapsed;
+        elapsed.start();
+        for (int i = 0; i < icons.size(); ++i) {
+            store.store(catalog, iconPath(i), QStringLiteral("1"), icons.at(i), &store,
+                        [&stored](const QImage &) { ++stored; });
+        }
+        while (stored < icons.size()) {
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        }
+        report("decode + scale", elapsed.nsecsElapsed() / 1.0e6);
+
+        const double memoryMs = bestOfMs(kRuns, [&store, &catalog, &iconPath]() {
+            for (int i = 0; i < kIconCount; ++i) {
+                store.image(catalog, iconPath(i));
+            }
+        });
+        report("image() from memory", memoryMs);
+        // Blobs and the index reach the disk before the next store opens it
+        WriteBehind::shared()->finish();
+    }
+
+    IconStore store(directory);
+    QElapsedTimer elapsed;
+    elapsed.start();
+    int loaded = 0;
+    for (int i = 0; i < kIconCount; ++i) {
+        loaded += store.image(catalog, iconPath(i)).isNull() ? 0 : 1;
+    }
+    report("image() from blobs", elapsed.nsecsElapsed() / 1.0e6);
+
+    elapsed.restart();
+    for (int i = 0; i < kIconCount; ++i) {
+        store.pixmap(catalog, iconPath(i));
+    }
+    report("pixmap(), first paint", elapsed.nsecsElapsed() / 1.0e6);
+    const double paintedMs = bestOfMs(kRuns, [&store, &catalog, &iconPath]() {
+        for (int i = 0; i < kIconCount; ++i) {
+            store.pixmap(catalog, iconPath(i));
+        }
+    });
+    report("pixmap(), repaint", paintedMs);
+
+    // What painting a page costs the GUI thread now that blobs are read in
+    // the background, and how long until every tile has its icon
+    QPixmapCache::clear();
+    IconStore cold(directory);
+    int arrived = 0;
+    QObject::connect(&cold, &IconStore::iconLoaded, [&arrived](const QString &, const QString &, const QImage &) {
+        ++arrived;
+    });
+    elapsed.restart();
+    for (int i = 0; i < kIconCount; ++i) {
+        cold.pixmapIfLoaded(catalog, iconPath(i));
+    }
+    report("pixmapIfLoaded(), paint", elapsed.nsecsElapsed() / 1.0e6);
+    while (arrived < kIconCount) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    report("pixmapIfLoaded(), loaded", elapsed.nsecsElapsed() / 1.0e6);
+
+    if (loaded != kIconCount) {
+        std::printf("loaded %d icons from blobs, expected %d\n", loaded, kIconCount);
+    }
+}
+
+struct ThemeTimes {
+    double buildMs = 0;     // Creating, styling, polishing and painting once
+    double statusUs = 0;    // Per label status change
+    double paintMs = 0;     // Repainting the whole page
+};
+
+// A page of control buttons and status labels styled the way MainWindow
+// did before Theme, or through Theme
+ThemeTimes timeTheme(bool styleSheets)
+{
+    static const char *const statusColors[Theme::StatusCount] = {
+        "#7f8c8d", "#27ae60", "#f39c12", "#2980b9", "#e74c3c"
+    };
+    const QString buttonSheet = QStringLiteral(
+        "QPushButton { background-color: #1a535c; color: white; border: none; padding: 12px; border-radius: 6px; } "
+        "QPushButton:hover { background-color: #2a7a83; }");
+    auto setStatus = [styleSheets](QLabel *label, int status) {
+        if (styleSheets) {
+            label->setStyleSheet(QStringLiteral("font-size: 18px; font-weight: 700; color: %1;")
+                                     .arg(QLatin1String(statusColors[status])));
+        } else {
+            Theme::setStatus(label, Theme::Status(status));
+        }
+    };
+
+    ThemeTimes times;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    QWidget page;
+    auto *layout = new QGridLayout(&page);
+    for (int i = 0; i < kButtonCount; ++i) {
+        auto *button = new QPushButton(QStringLiteral("Button %1").arg(i));
+        if (styleSheets) {
+            button->setStyleSheet(buttonSheet);
+        } else {
+            Theme::setRole(button, Theme::Primary);
+        }
+        layout->addWidget(button, i, 0);
+    }
+    QList<QLabel *> labels;
+    for (int i = 0; i < kLabelCount; ++i) {
+        auto *label = new QLabel(QStringLiteral("Status %1").arg(i));
+        setStatus(label, i % Theme::StatusCount);
+        layout->addWidget(label, i % kButtonCount, 1 + i / kButtonCount);
+        labels.append(label);
+    }
+    page.resize(1200, 1200);
+    page.grab();
+    times.buildMs = elapsed.nsecsElapsed() / 1.0e6;
+
+    // Every update changes the status, so Theme's no-op shortcut never helps
+    elapsed.restart();
+    for (int round = 1; round <= kStatusRounds; ++round) {
+        for (int i = 0; i < labels.size(); ++i) {
+            setStatus(labels.at(i), (round + i) % Theme::StatusCount);
+        }
+    }
+    page.grab();
+    times.statusUs = elapsed.nsecsElapsed() / 1.0e3 / (kStatusRounds * kLabelCount);
+
+    times.paintMs = bestOfMs(kRuns, [&page]() { page.grab(); });
+    return times;
+}
+
+void benchTheme()
+{
+    QApplication::setStyle(Theme::createStyle());
+    QApplication::setPalette(Theme::palette());
+
+    std::printf("\n[theme] %d buttons and %d status labels\n", kButtonCount, kLabelCount);
+    std::printf("%-28s %12s %12s\n", "step", "style sheet", "theme");
+    const ThemeTimes sheets = timeTheme(true);
+    const ThemeTimes themed = timeTheme(false);
+    std::printf("%-28s %12.2f %12.2f\n", "build + first paint ms", sheets.buildMs, themed.buildMs);
+    std::printf("%-28s %12.2f %12.2f\n", "status change us", sheets.statusUs, themed.statusUs);
+    std::printf("%-28s %12.2f %12.2f\n", "repaint ms", sheets.paintMs, themed.paintMs);
+}
+
+// Feeds data to a fresh decoder in chunks of chunkBytes (all at once if 0)
+int streamDecode(const QByteArray &data, int chunkBytes, int *peakBuffered = nullptr)
+{
+    AppsStreamDecoder decoder;
+    int count = 0;
+    const int step = chunkBytes > 0 ? chunkBytes : int(data.size());
+    for (int pos = 0; pos < data.size(); pos += step) {
+        count += int(decoder.feed(data.mid(pos, step)).size());
+    }
+    if (peakBuffered) {
+        *peakBuffered = decoder.peakBuffered();
+    }
+    return count;
+}
+
+void benchCodec()
+{
+    std::printf("\n[codec] /apps decoding\n");
+    std::printf("%8s  %-28s %10s %10s %10s\n", "apps", "path", "bytes", "ms", "MB/s");
+    for (int count : {1000, 10000}) {
+        const QList<InstalledApp> apps = syntheticCatalog(count);
+        const QByteArray json = appsJson(apps);
+        const QByteArray cbor = QCborValue::fromJsonValue(QJsonDocument::fromJson(json).object()).toCbor();
+        auto report = [count](const char *path, qint64 bytes, double ms) {
+            std::printf("%8d  %-28s %10lld %10.2f %10.1f\n", count, path, bytes, ms,
+                        ms > 0 ? bytes / 1048576.0 / (ms / 1000.0) : 0.0);
+        };
+
+        report("json, QJsonDocument", json.size(), bestOfMs(kRuns, [&json]() {
+            appsFromJsonDocument(json);
+        }));
+        report("json, stream decoder", json.size(), bestOfMs(kRuns, [&json]() {
+            streamDecode(json, 0);
+        }));
+        report("json, stream decoder, 16K", json.size(), bestOfMs(kRuns, [&json]() {
+            streamDecode(json, kChunkBytes);
+        }));
+        report("cbor, stream decoder, 16K", cbor.size(), bestOfMs(kRuns, [&cbor]() {
+            streamDecode(cbor, kChunkBytes);
+        }));
+
+        report("encode, QJsonDocument", json.size(), bestOfMs(kRuns, [&apps]() {
+            appsJson(apps);
+        }));
+        report("encode, JsonCodec", json.size(), bestOfMs(kRuns, [&apps]() {
+            QByteArray out = "{\"apps\":[";
+            for (int i = 0; i < apps.size(); ++i) {
+                if (i > 0) {
+                    out.append(',');
+                }
+                out.append(JsonCodec::encode(apps.at(i)));
+            }
+            out.append("]}");
+        }));
+
+        int peakBuffered = 0;
+        const int jsonApps = streamDecode(json, kChunkBytes, &peakBuffered);
+        const int cborApps = streamDecode(cbor, kChunkBytes);
+        if (jsonApps != count || cborApps != count) {
+            std::printf("%8d  decoded %d (json) and %d (cbor) apps\n", count, jsonApps, cborApps);
+        }
+        std::printf("%8d  %-28s %10d\n", count, "stream peak buffered", peakBuffered);
+    }
+}
+// Names built from words real catalogs are full of, so queries share grams
+// with many apps the way they do on a real guest
+QList<InstalledApp> searchCatalog(int count)
+{
+    static const char *const words[] = {
+        "Visual", "Studio", "Code", "Player", "Media", "Driver", "Runtime", "Update", "Helper", "Tools",
+        "Office", "Reader", "Editor", "Service", "Audio", "Graphics", "Control", "Center", "Manager", "Cloud",
+        "Security", "Redistributable", "Launcher", "Studio", "Notepad", "Browser", "Sync", "Capture"
+    };
+    constexpr int wordCount = sizeof(words) / sizeof(words[0]);
+
+    QList<InstalledApp> apps = syntheticCatalog(count);
+    for (int i = 0; i < apps.size(); ++i) {
+        apps[i].name = QStringLiteral("%1 %2 %3 %4")
+                           .arg(QLatin1String(words[i % wordCount]))
+                           .arg(QLatin1String(words[(i / wordCount + 7 * i) % wordCount]))
+                           .arg(QLatin1String(words[(i / 3 + 11) % wordCount]))
+                           .arg(i % 100);
+    }
+    return apps;
+}
+
+double percentileUs(QVector<qint64> samples, int percent)
+{
+    if (samples.isEmpty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    const int at = qMin(int(samples.size()) - 1, int(samples.size()) * percent / 100);
+    return samples.at(at) / 1000.0;
+}
+
+void benchSearch()
+{
+    const QList<InstalledApp> apps = searchCatalog(kSearchApps);
+    AppSearchIndex index;
+    const double buildMs = bestOfMs(1, [&index, &apps]() {
+        index.setApps(apps);
+    });
+    const double resetMs = bestOfMs(kRuns, [&index, &apps]() {
+        index.setApps(apps);
+    });
+
+    std::printf("\n[search] %d apps, index %.2f ms, unchanged setApps %.2f ms\n", kSearchApps, buildMs, resetMs);
+    std::printf("%6s %10s %10s %10s %10s\n", "chars", "p50 us", "p99 us", "max us", "hits");
+    // Each word typed a letter at a time, as the search field sends it
+    static const char *const typed[] = {
+        "studio", "player", "notepd", "runtim", "vscode", "office", "micros", "graphx", "launch", "xyzzyq"
+    };
+    for (int length = 1; length <= kMaxQueryLength; ++length) {
+        QVector<qint64> samples;
+        int hits = 0;
+        for (int round = 0; round < kRuns * 4; ++round) {
+            for (const char *word : typed) {
+                hits += int(index.search(QString::fromLatin1(word, length)).size());
+                samples.append(index.lastSearchNs());
+            }
+        }
+        std::printf("%6d %10.1f %10.1f %10.1f %10d\n", length, percentileUs(samples, 50), percentileUs(samples, 99),
+                    percentileUs(samples, 100), hits / (kRuns * 4));
+    }
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    // Keeps catalogs and icons out of the real cache directory
+    QStandardPaths::setTestModeEnabled(true);
+    QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false"));
+
+    const QStringList sections = app.arguments().mid(1);
+    auto wanted = [&sections](const char *name) {
+        return sections.isEmpty() || sections.contains(QLatin1String(name));
+    };
+    if (wanted("cache")) {
+        benchCache();
+    }
+    if (wanted("icons")) {
+        benchIcons();
+    }
+    if (wanted("theme")) {
+        benchTheme();
+    }
+    if (wanted("codec")) {
+        benchCodec();
+    }
+    if (wanted("search")) {
+        benchSearch();
+    }
+
+    QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).removeRecursively();
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include "cborcodec.h"
+#include <QtEndian>
+#include <cmath>
+#include <limits>
+
+namespace CborCodec {
+
+namespace {
+// Deeper nesting than any REDFLAG reply is treated as malformed
+constexpr int kMaxDepth = 32;
+
+int itemEnd(const char *data, int size, int pos, int depth)
+{
+    if (depth > kMaxDepth) {
+        return -2;
+    }
+    Header header;
+    const int length = readHeader(data, size, pos, header);
+    if (length <= 0) {
+        return length == 0 ? -1 : -2;
+    }
+    pos += length;
+
+    switch (header.type) {
+    case ByteString:
+    case TextString:
+        if (header.indefinite) {
+            // Definite-length chunks of the same type, then a break
+            while (pos < size && uchar(data[pos]) != 0xff) {
+                pos = itemEnd(data, size, pos, depth + 1);
+                if (pos < 0) {
+                    return pos;
+                }
+            }
+            return pos < size ? pos + 1 : -1;
+        }
+        if (header.value > quint64(size - pos)) {
+            return -1;
+        }
+        return pos + int(header.value);
+    case Array:
+    case Map: {
+        if (header.indefinite) {
+            while (pos < size && uchar(data[pos]) != 0xff) {
+                pos = itemEnd(data, size, pos, depth + 1);
+                if (pos < 0) {
+                    return pos;
+                }
+            }
+            return pos < size ? pos + 1 : -1;
+        }
+        // Every item takes at least a byte, which bounds the count
+        const quint64 items = header.type == Map ? header.value * 2 : header.value;
+        if (header.value > quint64(std::numeric_limits<int>::max()) || items > quint64(size - pos)) {
+            return -1;
+        }
+        for (quint64 i = 0; i < items; ++i) {
+            pos = itemEnd(data, size, pos, depth + 1);
+            if (pos < 0) {
+                return pos;
+            }
+        }
+        return pos;
+    }
+    case Tag:
+        return itemEnd(data, size, pos, depth + 1);
+    default:
+        return pos;
+    }
+}
+
+template <typename Int>
+bool readInteger(QCborStreamReader &reader, Int &value)
+{
+    if (reader.isUnsignedInteger()) {
+        value = Int(qMin(reader.toUnsignedInteger(), quint64(std::numeric_limits<Int>::max())));
+        return reader.next();
+    }
+    double number = 0;
+    if (!readValue(reader, number)) {
+        return false;
+    }
+    value = Int(qBound(double(std::numeric_limits<Int>::min()), std::trunc(number),
+                       double(std::numeric_limits<Int>::max())));
+    return true;
+}
+} // namespace
+
+int readHeader(const char *data, int size, int pos, Header &header)
+{
+    if (pos >= size) {
+        return 0;
+    }
+    const uchar initial = uchar(data[pos]);
+    header.type = MajorType(initial >> 5);
+    header.indefinite = false;
+    const uchar info = initial & 0x1f;
+    if (info < 24) {
+        header.value = info;
+        return 1;
+    }
+    if (info == 31) {
+        // Indefinite length; for simple values this is the break byte
+        if (header.type == UnsignedInteger || header.type == NegativeInteger || header.type == Tag) {
+            return -1;
+        }
+        header.indefinite = true;
+        header.value = 0;
+        return 1;
+    }
+    if (info > 27) {
+        return -1;
+    }
+    const int bytes = 1 << (info - 24);
+    if (size - pos - 1 < bytes) {
+        return 0;
+    }
+    const char *field = data + pos + 1;
+    switch (bytes) {
+    case 1: header.value = uchar(*field); break;
+    case 2: header.value = qFromBigEndian<quint16>(field); break;
+    case 4: header.value = qFromBigEndian<quint32>(field); break;
+    default: header.value = qFromBigEndian<quint64>(field); break;
+    }
+    return 1 + bytes;
+}
+
+int itemEnd(const char *data, int size, int pos)
+{
+    return itemEnd(data, size, pos, 0);
+}
+
+bool startsWithMap(const char *data, int size)
+{
+    return size > 0 && (uchar(data[0]) >> 5) == Map;
+}
+
+bool readValue(QCborStreamReader &reader, QString &value)
+{
+    if (reader.isNull()) {
+        value.clear();
+        return reader.next();
+    }
+    if (!reader.isString()) {
+        return false;
+    }
+    QString text;
+    auto chunk = reader.readString();
+    while (chunk.status == QCborStreamReader::Ok) {
+        text += chunk.data;
+        chunk = reader.readString();
+    }
+    if (chunk.status == QCborStreamReader::Error) {
+        return false;
+    }
+    value = text;
+    return true;
+}
+
+bool readValue(QCborStreamReader &reader, bool &value)
+{
+    if (reader.isNull()) {
+        value = false;
+        return reader.next();
+    }
+    if (!reader.isBool()) {
+        return false;
+    }
+    value = reader.toBool();
+    return reader.next();
+}
+
+bool readValue(QCborStreamReader &reader, double &value)
+{
+    switch (reader.type()) {
+    case QCborStreamReader::UnsignedInteger:
+        value = double(reader.toUnsignedInteger());
+        break;
+    case QCborStreamReader::NegativeInteger:
+        value = double(reader.toInteger());
+        break;
+    case QCborStreamReader::Float16:
+        value = double(float(reader.toFloat16()));
+        break;
+    case QCborStreamReader::Float:
+        value = double(reader.toFloat());
+        break;
+    case QCborStreamReader::Double:
+        value = reader.toDouble();
+        break;
+    default:
+        if (!reader.isNull()) {
+            return false;
+        }
+        value = 0;
+        break;
+    }
+    return reader.next();
+}
+
+bool readValue(QCborStreamReader &reader, qint64 &value)
+{
+    return readInteger(reader, value);
+}
+
+bool readValue(QCborStreamReader &reader, quint64 &value)
+{
+    return readInteger(reader, value);
+}
+
+bool readValue(QCborStreamReader &reader, int &value)
+{
+    return readInteger(reader, value);
+}
+
+} // namespace CborCodec
@@ -0,0 +1,104 @@
+#ifndef CBORCODEC_H
+#define CBORCODEC_H
+
+#include <QCborStreamReader>
+#include <QString>
+#include "jsoncodec.h"
+
+// CBOR side of the schema codec: reads the structs described by
+// JsonCodec::Schema from CBOR with QCborStreamReader, straight into the
+// members. As with JSON, unknown keys are skipped, missing ones leave the
+// member as it was and null reads as an empty string or 0.
+namespace CborCodec {
+
+enum MajorType {
+    UnsignedInteger = 0,
+    NegativeInteger = 1,
+    ByteString = 2,
+    TextString = 3,
+    Array = 4,
+    Map = 5,
+    Tag = 6,
+    Simple = 7
+};
+
+struct Header {
+    MajorType type = UnsignedInteger;
+    quint64 value = 0;          // Length, count or the value itself
+    bool indefinite = false;
+};
+
+// Reads the head of the item at pos. Returns its size in bytes, 0 if the
+// data ends first and -1 if it is malformed.
+int readHeader(const char *data, int size, int pos, Header &header);
+// Offset just past the item starting at pos, nested items included; -1 if
+// the data ends first, -2 if it is malformed
+int itemEnd(const char *data, int size, int pos);
+// True if the first byte starts a CBOR map, which no JSON text can
+bool startsWithMap(const char *data, int size);
+
+bool readValue(QCborStreamReader &reader, QString &value);
+bool readValue(QCborStreamReader &reader, bool &value);
+bool readValue(QCborStreamReader &reader, double &value);
+bool readValue(QCborStreamReader &reader, qint64 &value);
+bool readValue(QCborStreamReader &reader, quint64 &value);
+bool readValue(QCborStreamReader &reader, int &value);
+
+template <typename T>
+std::enable_if_t<JsonCodec::HasSchema<T>::value, bool> readValue(QCborStreamReader &reader, T &value);
+
+template <typename T, typename M>
+bool readField(QCborStreamReader &reader, T &object, const JsonCodec::Field<T, M> &field,
+               const QString &key, bool &matched)
+{
+    if (matched || key.size() != field.length || key != QLatin1String(field.name, field.length)) {
+        return true;
+    }
+    matched = true;
+    return readValue(reader, object.*field.member);
+}
+
+template <typename T>
+std::enable_if_t<JsonCodec::HasSchema<T>::value, bool> readValue(QCborStreamReader &reader, T &value)
+{
+    if (reader.isNull()) {
+        // A null object keeps its defaults
+        return reader.next();
+    }
+    if (!reader.isMap() || !reader.enterContainer()) {
+        return false;
+    }
+    while (reader.hasNext()) {
+        QString key;
+        if (!readValue(reader, key)) {
+            return false;
+        }
+        bool matched = false;
+        const bool ok = std::apply([&](const auto &...fields) {
+            return (readField(reader, value, fields, key, matched) && ...);
+        }, JsonCodec::Schema<T>::fields);
+        if (!ok || (!matched && !reader.next())) {
+            return false;
+        }
+    }
+    return reader.lastError() == QCborError::NoError && reader.leaveContainer();
+}
+
+// Reads one CBOR item, which must be all of [begin, end), into value
+template <typename T>
+bool decode(const char *begin, const char *end, T &value)
+{
+    QCborStreamReader reader(begin, end - begin);
+    return readValue(reader, value) && reader.lastError() == QCborError::NoError
+        && reader.currentOffset() == end - begin;
+}
+
+template <typename T>
+bool decode(const QByteArray &data, T &value)
+{
+    return decode(data.constData(), data.constData() + data.size(), value);
+}
+
+} // namespace CborCodec
+
+#endif // CBORCODEC_H
@@ -1,11 +1,8 @@
 #include "connectdialog.h"
+#include "guestaddressresolver.h"
 
-#include <QRegularExpression>
-#include <QProcess>
-#include <QCoreApplication>
-
-ConnectDialog::ConnectDialog(const QString &vmName, QWidget *parent)
-    : QDialog(parent), vm(vmName)
+ConnectDialog::ConnectDialog(const QString &vmName, GuestAddressResolver *resolver, QWidget *parent)
+    : QDialog(parent), vm(vmName), resolver(resolver)
 {
     setWindowTitle("Connect to Desktop");
     setWindowFlags(Qt::Dialog | Qt::FramelessWindowHint);
@@ -72,49 +69,16 @@ QString ConnectDialog::ipAddress() const { return ip; }
 
 void ConnectDialog::resolveIp()
 {
-    bool ok = false;
-    QString xml = runProcess("virsh", {"dumpxml", vm}, &ok);
-    if (!ok || xml.isEmpty()) {
-        ipLabel->setText("IP: unknown");
-        return;
-    }
-    QString mac = getMacFromXml(xml);
-    if (mac.isEmpty()) {
-        ipLabel->setText("IP: unknown");
-        return;
-    }
-    ip = getIpForMac(mac);
-    if (ip.isEmpty()) ipLabel->setText("IP: unknown");
-    else ipLabel->setText(QStringLiteral("IP: %1").arg(ip));
-}
-
-QString ConnectDialog::getMacFromXml(const QString &xml)
-{
-    QRegularExpression re("<mac\\s+address=\"?([^\"'/>]+)\"?");
-    auto m = re.match(xml);
-    if (m.hasMatch()) return m.captured(1);
-    return QString();
+    // Shares the main window's cache and in-flight lookups, so the dialog
+    // usually has the address before it is shown
+    resolver->resolve(vm, this, [this](const QString &address) {
+        setResolvedIp(address);
+    });
 }
 
-QString ConnectDialog::runProcess(const QString &program, const QStringList &args, bool *ok)
+void ConnectDialog::setResolvedIp(const QString &address)
 {
-    QProcess p;
-    p.start(program, args);
-    if (!p.waitForFinished(5000)) { if (ok) *ok = false; p.kill(); return {}; }
-    if (ok) *ok = (p.exitStatus() == QProcess::NormalExit && p.exitCode() == 0);
-    return QString::fromLocal8Bit(p.readAllStandardOutput());
-}
-
-QString ConnectDialog::getIpForMac(const QString &mac)
-{
-    const QStringList nets = {"default", "virbr0", "bridge"};
-    QRegularExpression ipre("(\\d{1,3}(?:\\.\\d{1,3}){3})(?:/\\d{1,2})?");
-    for (const QString &net : nets) {
-        bool ok = false;
-        QString out = runProcess("virsh", {"net-dhcp-leases", net, "--mac", mac}, &ok);
-        if (!ok || out.isEmpty()) continue;
-        auto m = ipre.match(out);
-        if (m.hasMatch()) return m.captured(1);
-    }
-    return QString();
+    ip = address;
+    if (ip.isEmpty()) ipLabel->setText("IP: unknown");
+    else ipLabel->setText(QStringLiteral("IP: %1").arg(ip));
 }
@@ -10,10 +10,12 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 
+class GuestAddressResolver;
+
 class ConnectDialog : public QDialog {
     Q_OBJECT
 public:
-    explicit ConnectDialog(const QString &vmName, QWidget *parent = nullptr);
+    ConnectDialog(const QString &vmName, GuestAddressResolver *resolver, QWidget *parent = nullptr);
     QString username() const;
     QString password() const;
     int port() const;
@@ -22,11 +24,10 @@ public:
 private:
     void initUI();
     void resolveIp();
-    static QString getMacFromXml(const QString &xml);
-    static QString runProcess(const QString &program, const QStringList &args, bool *ok);
-    static QString getIpForMac(const QString &mac);
+    void setResolvedIp(const QString &address);
 
     QString vm;
+    GuestAddressResolver *resolver;
     QLabel *ipLabel;
     QLineEdit *usernameEdit;
     QLineEdit *passwordEdit;
@@ -0,0 +1,144 @@
+#include "contentdecoder.h"
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+constexpr int kOutputChunk = 64 * 1024;
+// A reply larger than this once decoded is refused rather than buffered
+constexpr qint64 kMaxDecodedBytes = 256 * 1024 * 1024;
+} // namespace
+
+QByteArray ContentDecoder::acceptedEncodings()
+{
+#ifdef HAVE_ZSTD
+    return QByteArrayLiteral("zstd, gzip");
+#else
+    return QByteArrayLiteral("gzip");
+#endif
+}
+
+ContentDecoder::ContentDecoder(const QByteArray &encoding)
+    : m_kind(Identity)
+    , m_zlib(nullptr)
+    , m_zstd(nullptr)
+    , m_decodedBytes(0)
+{
+    const QByteArray name = encoding.trimmed().toLower();
+    if (name.isEmpty() || name == "identity") {
+        return;
+    }
+    if (name == "gzip" || name == "x-gzip" || name == "deflate") {
+        m_kind = Zlib;
+        m_zlib = new z_stream;
+        m_zlib->zalloc = Z_NULL;
+        m_zlib->zfree = Z_NULL;
+        m_zlib->opaque = Z_NULL;
+        m_zlib->next_in = Z_NULL;
+        m_zlib->avail_in = 0;
+        // 32: detect gzip or zlib headers
+        if (inflateInit2(m_zlib, MAX_WBITS + 32) != Z_OK) {
+            delete m_zlib;
+            m_zlib = nullptr;
+            fail(QStringLiteral("zlib could not be initialised"));
+        }
+        return;
+    }
+#ifdef HAVE_ZSTD
+    if (name == "zstd") {
+        m_kind = Zstd;
+        m_zstd = ZSTD_createDStream();
+        if (!m_zstd || ZSTD_isError(ZSTD_initDStream(m_zstd))) {
+            fail(QStringLiteral("zstd could not be initialised"));
+        }
+        return;
+    }
+#endif
+    fail(QStringLiteral("unsupported content encoding %1").arg(QString::fromLatin1(name)));
+}
+
+ContentDecoder::~ContentDecoder()
+{
+    if (m_zlib) {
+        inflateEnd(m_zlib);
+        delete m_zlib;
+    }
+#ifdef HAVE_ZSTD
+    if (m_zstd) {
+        ZSTD_freeDStream(m_zstd);
+    }
+#endif
+}
+
+QByteArray ContentDecoder::fail(const QString &error)
+{
+    if (m_error.isEmpty()) {
+        m_error = error;
+    }
+    return QByteArray();
+}
+
+bool ContentDecoder::append(QByteArray &out, const char *data, qint64 size)
+{
+    m_decodedBytes += size;
+    if (m_decodedBytes > kMaxDecodedBytes) {
+        fail(QStringLiteral("decoded reply too large"));
+        return false;
+    }
+    out.append(data, static_cast<int>(size));
+    return true;
+}
+
+QByteArray ContentDecoder::decode(const QByteArray &chunk)
+{
+    if (hasFailed()) {
+        return QByteArray();
+    }
+    if (m_kind == Identity) {
+        m_decodedBytes += chunk.size();
+        return chunk;
+    }
+
+    QByteArray out;
+    char buffer[kOutputChunk];
+    if (m_kind == Zlib) {
+        m_zlib->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(chunk.constData()));
+        m_zlib->avail_in = static_cast<uInt>(chunk.size());
+        // Runs until the input is used up and no more output is pending
+        do {
+            m_zlib->next_out = reinterpret_cast<Bytef *>(buffer);
+            m_zlib->avail_out = sizeof(buffer);
+            const int status = inflate(m_zlib, Z_NO_FLUSH);
+            if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+                return fail(QStringLiteral("corrupt compressed reply"));
+            }
+            if (!append(out, buffer, sizeof(buffer) - m_zlib->avail_out)) {
+                return QByteArray();
+            }
+            if (status == Z_STREAM_END) {
+                break;
+            }
+        } while (m_zlib->avail_in > 0 || m_zlib->avail_out == 0);
+        return out;
+    }
+
+#ifdef HAVE_ZSTD
+    ZSTD_inBuffer input = {chunk.constData(), static_cast<size_t>(chunk.size()), 0};
+    for (;;) {
+        ZSTD_outBuffer output = {buffer, sizeof(buffer), 0};
+        const size_t status = ZSTD_decompressStream(m_zstd, &output, &input);
+        if (ZSTD_isError(status)) {
+            return fail(QStringLiteral("corrupt compressed reply: %1").arg(QString::fromLatin1(ZSTD_getErrorName(status))));
+        }
+        if (!append(out, buffer, static_cast<qint64>(output.pos))) {
+            return QByteArray();
+        }
+        // A full output buffer may leave more to flush
+        if (output.pos < output.size && input.pos == input.size) {
+            break;
+        }
+    }
+#endif
+    return out;
+}
@@ -0,0 +1,48 @@
+#ifndef CONTENTDECODER_H
+#define CONTENTDECODER_H
+
+#include <QByteArray>
+#include <QString>
+
+typedef struct z_stream_s z_stream;
+typedef struct ZSTD_DCtx_s ZSTD_DStream;
+
+// Undoes the Content-Encoding of a reply (gzip, deflate and, when built with
+// libzstd, zstd) chunk by chunk. GuestHttpPipeline asks for compressed
+// replies itself instead of leaving it to Qt, so it sees the bytes as they
+// came over the wire.
+class ContentDecoder
+{
+public:
+    // Value for Accept-Encoding, best first
+    static QByteArray acceptedEncodings();
+
+    // An empty or "identity" encoding passes data through unchanged
+    explicit ContentDecoder(const QByteArray &encoding);
+    ~ContentDecoder();
+
+    ContentDecoder(const ContentDecoder &) = delete;
+    ContentDecoder &operator=(const ContentDecoder &) = delete;
+
+    // Returns the decoded bytes for chunk; empty once decoding has failed
+    QByteArray decode(const QByteArray &chunk);
+
+    bool isIdentity() const { return m_kind == Identity; }
+    bool hasFailed() const { return !m_error.isEmpty(); }
+    QString errorString() const { return m_error; }
+    qint64 decodedBytes() const { return m_decodedBytes; }
+
+private:
+    enum Kind { Identity, Zlib, Zstd };
+
+    QByteArray fail(const QString &error);
+    bool append(QByteArray &out, const char *data, qint64 size);
+
+    Kind m_kind;
+    z_stream *m_zlib;
+    ZSTD_DStream *m_zstd;
+    qint64 m_decodedBytes;
+    QString m_error;
+};
+
+#endif // CONTENTDECODER_H
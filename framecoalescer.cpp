@@ -0,0 +1,71 @@
+#include "framecoalescer.h"
+#include <QCoreApplication>
+#include <QTimer>
+#include <QDebug>
+
+FrameCoalescer::FrameCoalescer(QObject *parent)
+    : QObject(parent)
+    , m_frame(new QTimer(this))
+{
+    m_frame->setSingleShot(true);
+    m_frame->setTimerType(Qt::PreciseTimer);
+    connect(m_frame, &QTimer::timeout, this, &FrameCoalescer::flush);
+}
+
+FrameCoalescer::~FrameCoalescer()
+{
+    if (m_stats.frames > 0) {
+        qDebug() << "UI updates:" << m_stats.applied << "applied," << m_stats.dropped() << "dropped ("
+                 << m_stats.superseded << "superseded," << m_stats.unchanged << "unchanged) in"
+                 << m_stats.frames << "frames";
+    }
+}
+
+FrameCoalescer *FrameCoalescer::shared()
+{
+    static QPointer<FrameCoalescer> instance;
+    if (!instance) {
+        instance = new FrameCoalescer(QCoreApplication::instance());
+    }
+    return instance;
+}
+
+void FrameCoalescer::post(QObject *context, const QString &key, Apply apply)
+{
+    const Key pendingKey(context, key);
+    auto it = m_pending.find(pendingKey);
+    if (it != m_pending.end()) {
+        ++m_stats.superseded;
+        *it = Pending{context, std::move(apply)};
+    } else {
+        m_pending.insert(pendingKey, Pending{context, std::move(apply)});
+        m_order.append(pendingKey);
+    }
+
+    // Not restarted by later posts, so a steady stream still gets a frame
+    if (!m_frame->isActive()) {
+        m_frame->start(kFrameMs);
+    }
+}
+
+void FrameCoalescer::flush()
+{
+    // Posts made while applying go to the next frame
+    const QHash<Key, Pending> pending = std::move(m_pending);
+    const QList<Key> order = std::move(m_order);
+    m_pending.clear();
+    m_order.clear();
+
+    ++m_stats.frames;
+    for (const Key &key : order) {
+        const Pending update = pending.value(key);
+        if (!update.context) {
+            continue;
+        }
+        if (update.apply()) {
+            ++m_stats.applied;
+        } else {
+            ++m_stats.unchanged;
+        }
+    }
+}
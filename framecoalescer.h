@@ -0,0 +1,64 @@
+#ifndef FRAMECOALESCER_H
+#define FRAMECOALESCER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QPointer>
+#include <QString>
+#include <functional>
+
+class QTimer;
+
+// Applies UI updates at most once per display frame. Widgets post an update
+// per (context, key) whenever their data changes; later posts for the same
+// key replace earlier ones within a frame, and all pending updates run
+// together on the next frame tick. Bursts of icons or metric samples then
+// cost one repaint per frame instead of one per arrival.
+class FrameCoalescer : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Returns whether anything visible changed; false counts as unchanged
+    using Apply = std::function<bool()>;
+
+    struct Stats {
+        quint64 frames = 0;
+        quint64 applied = 0;
+        quint64 superseded = 0;     // Replaced by a later post in the same frame
+        quint64 unchanged = 0;      // Applied, but nothing needed repainting
+        quint64 dropped() const { return superseded + unchanged; }
+    };
+
+    static constexpr int kFrameMs = 16;
+
+    explicit FrameCoalescer(QObject *parent = nullptr);
+    ~FrameCoalescer();
+
+    // Process-wide instance, owned by the application object
+    static FrameCoalescer *shared();
+
+    // The update is dropped if context is destroyed before the frame
+    void post(QObject *context, const QString &key, Apply apply);
+
+    int pendingCount() const { return m_pending.size(); }
+    Stats stats() const { return m_stats; }
+
+private:
+    using Key = QPair<QObject *, QString>;
+    struct Pending {
+        QPointer<QObject> context;
+        Apply apply;
+    };
+
+    void flush();
+
+    QTimer *m_frame;
+    QHash<Key, Pending> m_pending;
+    QList<Key> m_order;
+    Stats m_stats;
+};
+
+#endif // FRAMECOALESCER_H
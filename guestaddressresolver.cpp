@@ -0,0 +1,267 @@
+#include "guestaddressresolver.h"
+#include "asynctask.h"
+#include "libvirtsession.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QPair>
+#include <QDebug>
+
+namespace {
+constexpr int kDefaultTtlMs = 60000;
+constexpr int kStrategyDeadlineMs = 5000;
+const char kLeaseDirectory[] = "/var/lib/libvirt/dnsmasq";
+} // namespace
+
+struct GuestAddressResolver::Lookup {
+    QString vmName;
+    QString address;
+    int pending = 0;
+    bool arpStarted = false;
+    bool finished = false;
+    QList<QPair<QPointer<QObject>, Callback>> waiters;
+};
+
+GuestAddressResolver::GuestAddressResolver(LibvirtSession *session, TaskQueue *queue, QObject *parent)
+    : QObject(parent)
+    , m_session(session)
+    , m_queue(queue)
+    , m_leaseWatcher(new QFileSystemWatcher(this))
+    , m_ttlMs(kDefaultTtlMs)
+{
+    connect(m_leaseWatcher, &QFileSystemWatcher::fileChanged,
+            this, &GuestAddressResolver::onLeaseFileChanged);
+    connect(m_leaseWatcher, &QFileSystemWatcher::directoryChanged,
+            this, &GuestAddressResolver::watchLeaseFiles);
+    watchLeaseFiles();
+}
+
+GuestAddressResolver::~GuestAddressResolver()
+{
+}
+
+QString GuestAddressResolver::cachedAddress(const QString &vmName) const
+{
+    const QString mac = m_macByVm.value(vmName);
+    if (mac.isEmpty()) {
+        return QString();
+    }
+    auto it = m_cacheByMac.constFind(mac);
+    if (it == m_cacheByMac.constEnd() || it->expiry.hasExpired()) {
+        return QString();
+    }
+    return it->address;
+}
+
+void GuestAddressResolver::invalidate(const QString &vmName)
+{
+    m_cacheByMac.remove(m_macByVm.value(vmName));
+}
+
+void GuestAddressResolver::resolve(const QString &vmName, QObject *context, Callback done)
+{
+    if (vmName.isEmpty()) {
+        done(QString());
+        return;
+    }
+
+    const QString cached = cachedAddress(vmName);
+    if (!cached.isEmpty()) {
+        done(cached);
+        return;
+    }
+
+    // Join a lookup that is already racing for this VM
+    std::shared_ptr<Lookup> &lookup = m_lookups[vmName];
+    const bool start = !lookup;
+    if (start) {
+        lookup = std::make_shared<Lookup>();
+        lookup->vmName = vmName;
+    }
+    lookup->waiters.append(qMakePair(QPointer<QObject>(context), std::move(done)));
+    if (start) {
+        startLookup(lookup);
+    }
+}
+
+void GuestAddressResolver::startLookup(const std::shared_ptr<Lookup> &lookup)
+{
+    LibvirtSession *session = m_session;
+    const QString vmName = lookup->vmName;
+
+    // DHCP lease from libvirtd; also tells us the MAC for the ARP strategy
+    ++lookup->pending;
+    m_queue->run([session, vmName]() {
+        return QVariant::fromValue(session->domain(vmName));
+    }, kStrategyDeadlineMs)->then(this, [this, lookup](const TaskResult &result) {
+        const VmDomain domain = result.value.value<VmDomain>();
+        if (!domain.macAddress.isEmpty()) {
+            m_macByVm.insert(lookup->vmName, domain.macAddress);
+            if (lookup->finished) {
+                // Another strategy won before the MAC was known
+                storeAddress(domain.macAddress, lookup->address);
+            } else {
+                startArpLookup(lookup, domain.macAddress);
+            }
+        }
+        offer(lookup, domain.isRunning() ? domain.ipAddress : QString());
+    });
+
+    // QEMU guest agent
+    ++lookup->pending;
+    m_queue->run([session, vmName]() {
+        return QVariant(session->guestAddress(vmName, LibvirtSession::AgentAddress));
+    }, kStrategyDeadlineMs)->then(this, [this, lookup](const TaskResult &result) {
+        offer(lookup, result.value.toString());
+    });
+
+    // Host ARP cache, right away if the MAC is known from an earlier lookup
+    const QString mac = m_macByVm.value(vmName);
+    if (!mac.isEmpty()) {
+        startArpLookup(lookup, mac);
+    }
+}
+
+void GuestAddressResolver::startArpLookup(const std::shared_ptr<Lookup> &lookup, const QString &mac)
+{
+    if (lookup->arpStarted) {
+        return;
+    }
+    lookup->arpStarted = true;
+
+    ++lookup->pending;
+    m_queue->run([mac]() {
+        return QVariant(addressFromArpTable(mac));
+    }, kStrategyDeadlineMs)->then(this, [this, lookup](const TaskResult &result) {
+        offer(lookup, result.value.toString());
+    });
+}
+
+void GuestAddressResolver::offer(const std::shared_ptr<Lookup> &lookup, const QString &address)
+{
+    --lookup->pending;
+    if (lookup->finished) {
+        return;
+    }
+    // First valid answer wins; an empty one only ends the race if it was the last
+    if (address.isEmpty() && lookup->pending > 0) {
+        return;
+    }
+    finishLookup(lookup, address);
+}
+
+void GuestAddressResolver::finishLookup(const std::shared_ptr<Lookup> &lookup, const QString &address)
+{
+    lookup->finished = true;
+    lookup->address = address;
+    if (m_lookups.value(lookup->vmName) == lookup) {
+        m_lookups.remove(lookup->vmName);
+    }
+
+    const QString mac = m_macByVm.value(lookup->vmName);
+    if (!mac.isEmpty()) {
+        storeAddress(mac, address);
+    }
+
+    for (const auto &waiter : lookup->waiters) {
+        if (waiter.first) {
+            waiter.second(address);
+        }
+    }
+    lookup->waiters.clear();
+}
+
+void GuestAddressResolver::storeAddress(const QString &mac, const QString &address)
+{
+    if (address.isEmpty()) {
+        return;
+    }
+    CacheEntry entry;
+    entry.address = address;
+    entry.expiry = QDeadlineTimer(m_ttlMs);
+    m_cacheByMac.insert(mac, entry);
+}
+
+QString GuestAddressResolver::addressFromArpTable(const QString &mac)
+{
+    // IP address  HW type  Flags  HW address  Mask  Device
+    QFile file(QStringLiteral("/proc/net/arp"));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return QString();
+    }
+
+    // /proc files report a size of 0, so read to EOF instead of using atEnd()
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (int i = 1; i < lines.size(); ++i) {
+        const QList<QByteArray> fields = lines.at(i).simplified().split(' ');
+        if (fields.size() < 4) {
+            continue;
+        }
+        // Flags 0x0 marks an incomplete entry
+        if (fields.at(2) != "0x0" && QString::fromLatin1(fields.at(3)).compare(mac, Qt::CaseInsensitive) == 0) {
+            return QString::fromLatin1(fields.at(0));
+        }
+    }
+    return QString();
+}
+
+void GuestAddressResolver::watchLeaseFiles()
+{
+    QDir dir(QString::fromLatin1(kLeaseDirectory));
+    if (!dir.exists()) {
+        return;
+    }
+    if (!m_leaseWatcher->directories().contains(dir.absolutePath())) {
+        m_leaseWatcher->addPath(dir.absolutePath());
+    }
+
+    const QStringList watched = m_leaseWatcher->files();
+    const QFileInfoList statusFiles = dir.entryInfoList({QStringLiteral("*.status")}, QDir::Files);
+    for (const QFileInfo &info : statusFiles) {
+        if (!watched.contains(info.absoluteFilePath())) {
+            m_leaseWatcher->addPath(info.absoluteFilePath());
+        }
+    }
+}
+
+void GuestAddressResolver::onLeaseFileChanged(const QString &path)
+{
+    // dnsmasq replaces the file, which drops the inotify watch
+    if (QFileInfo::exists(path) && !m_leaseWatcher->files().contains(path)) {
+        m_leaseWatcher->addPath(path);
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    // [{"ip-address": "...", "mac-address": "...", "expiry-time": ...}, ...]
+    QHash<QString, QString> leaseByMac;
+    const QJsonArray leases = QJsonDocument::fromJson(file.readAll()).array();
+    for (const QJsonValue &value : leases) {
+        const QJsonObject lease = value.toObject();
+        const QString ip = lease.value(QStringLiteral("ip-address")).toString();
+        if (!ip.isEmpty() && !ip.contains(QLatin1Char(':'))) {
+            leaseByMac.insert(lease.value(QStringLiteral("mac-address")).toString().toLower(), ip);
+        }
+    }
+
+    for (auto it = m_macByVm.constBegin(); it != m_macByVm.constEnd(); ++it) {
+        const QString lease = leaseByMac.value(it.value().toLower());
+        if (lease.isEmpty()) {
+            continue;
+        }
+        auto cached = m_cacheByMac.find(it.value());
+        if (cached == m_cacheByMac.end() || cached->address != lease) {
+            qDebug() << "Guest lease changed:" << it.key() << lease;
+            storeAddress(it.value(), lease);
+            emit addressChanged(it.key(), lease);
+        }
+    }
+}
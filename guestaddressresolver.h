@@ -0,0 +1,71 @@
+#ifndef GUESTADDRESSRESOLVER_H
+#define GUESTADDRESSRESOLVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QPointer>
+#include <QDeadlineTimer>
+#include <functional>
+#include <memory>
+
+class LibvirtSession;
+class TaskQueue;
+class QFileSystemWatcher;
+
+// Resolves guest IPv4 addresses for libvirt domains. Results are cached per
+// MAC address for a TTL; fresh lookups race the guest agent, the DHCP lease
+// table and the host ARP cache and take the first answer. The dnsmasq lease
+// status files are watched (inotify), so lease changes update the cache
+// without polling.
+class GuestAddressResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Callback = std::function<void(const QString &address)>;
+
+    GuestAddressResolver(LibvirtSession *session, TaskQueue *queue, QObject *parent = nullptr);
+    ~GuestAddressResolver();
+
+    // Calls done with the address (empty if unknown). Cached answers are
+    // delivered synchronously; done is dropped if context is destroyed first.
+    void resolve(const QString &vmName, QObject *context, Callback done);
+
+    QString cachedAddress(const QString &vmName) const;
+    void invalidate(const QString &vmName);
+
+    void setTtl(int ttlMs) { m_ttlMs = ttlMs; }
+    int ttl() const { return m_ttlMs; }
+
+signals:
+    // A cached address changed without being asked (lease renewed or moved)
+    void addressChanged(const QString &vmName, const QString &address);
+
+private:
+    struct Lookup;
+    struct CacheEntry {
+        QString address;
+        QDeadlineTimer expiry;
+    };
+
+    void startLookup(const std::shared_ptr<Lookup> &lookup);
+    void startArpLookup(const std::shared_ptr<Lookup> &lookup, const QString &mac);
+    void offer(const std::shared_ptr<Lookup> &lookup, const QString &address);
+    void finishLookup(const std::shared_ptr<Lookup> &lookup, const QString &address);
+    void storeAddress(const QString &mac, const QString &address);
+
+    void watchLeaseFiles();
+    void onLeaseFileChanged(const QString &path);
+
+    static QString addressFromArpTable(const QString &mac);
+
+    LibvirtSession *m_session;
+    TaskQueue *m_queue;
+    QFileSystemWatcher *m_leaseWatcher;
+    QHash<QString, CacheEntry> m_cacheByMac;
+    QHash<QString, QString> m_macByVm;
+    QHash<QString, std::shared_ptr<Lookup>> m_lookups;
+    int m_ttlMs;
+};
+
+#endif // GUESTADDRESSRESOLVER_H
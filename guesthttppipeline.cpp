@@ -0,0 +1,385 @@
+#include "guesthttppipeline.h"
+#include "contentdecoder.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTimer>
+#include <QUrl>
+#include <QDebug>
+#include <algorithm>
+#include <memory>
+
+namespace {
+// QNetworkAccessManager keeps up to six connections per host alive
+constexpr int kMaxConcurrentRequests = 6;
+// Streams multiplexed over one HTTP/2 connection
+constexpr int kMaxConcurrentHttp2Requests = 32;
+constexpr int kFailureThreshold = 3;
+constexpr int kInitialCooldownMs = 2000;
+constexpr int kMaxCooldownMs = 30000;
+constexpr int kLatencyWindow = 64;
+constexpr int kDiscoveryDeadlineMs = 5000;
+} // namespace
+
+// Body bytes of one reply as they came over the wire and once decoded
+struct GuestHttpPipeline::Transfer {
+    std::unique_ptr<ContentDecoder> decoder;
+    quint64 wireBytes = 0;
+    quint64 bytes = 0;
+    bool http2 = false;
+
+    // Headers are in by the first readyRead or finished
+    void begin(QNetworkReply *reply)
+    {
+        if (!decoder) {
+            decoder.reset(new ContentDecoder(reply->rawHeader("Content-Encoding")));
+            http2 = reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool();
+        }
+    }
+
+    QByteArray decode(const QByteArray &chunk)
+    {
+        wireBytes += chunk.size();
+        const QByteArray decoded = decoder->decode(chunk);
+        bytes += decoded.size();
+        return decoded;
+    }
+
+    bool compressed() const { return decoder && !decoder->isIdentity(); }
+    bool failed() const { return decoder && decoder->hasFailed(); }
+};
+
+GuestHttpPipeline::GuestHttpPipeline(QObject *parent)
+    : QObject(parent)
+    , m_queue(new TaskQueue(kMaxConcurrentRequests, this))
+    , m_network(new QNetworkAccessManager(this))
+{
+}
+
+GuestHttpPipeline::~GuestHttpPipeline()
+{
+    for (auto it = m_stats.constBegin(); it != m_stats.constEnd(); ++it) {
+        const EndpointStats &stats = it->stats;
+        if (stats.wireBytes > 0) {
+            qDebug() << "Guest traffic" << it.key() << ":" << stats.requests << "requests," << stats.wireBytes
+                     << "bytes on the wire for" << stats.bytes << "(" << stats.compressed << "compressed,"
+                     << stats.http2 << "over HTTP/2)";
+        }
+    }
+
+    // Abort what is still running before the network manager goes away
+    delete m_queue;
+    m_queue = nullptr;
+}
+
+GuestHttpPipeline *GuestHttpPipeline::shared()
+{
+    static QPointer<GuestHttpPipeline> instance;
+    if (!instance) {
+        instance = new GuestHttpPipeline(QCoreApplication::instance());
+    }
+    return instance;
+}
+
+void GuestHttpPipeline::get(const QNetworkRequest &request, QObject *context, Callback done, int deadlineMs)
+{
+    send(QNetworkAccessManager::GetOperation, request, QByteArray(), context, std::move(done), deadlineMs);
+}
+
+void GuestHttpPipeline::post(const QNetworkRequest &request, const QByteArray &body, QObject *context,
+                             Callback done, int deadlineMs)
+{
+    send(QNetworkAccessManager::PostOperation, request, body, context, std::move(done), deadlineMs);
+}
+
+AsyncTask *GuestHttpPipeline::postStreaming(const QNetworkRequest &request, const QByteArray &body,
+                                            QObject *context, DataCallback onData, Callback done, int deadlineMs)
+{
+    return send(QNetworkAccessManager::PostOperation, request, body, context, std::move(done), deadlineMs,
+         std::move(onData));
+}
+
+AsyncTask *GuestHttpPipeline::getStreaming(const QNetworkRequest &request, QObject *context, DataCallback onData,
+                                           Callback done, int deadlineMs)
+{
+    return send(QNetworkAccessManager::GetOperation, request, QByteArray(), context, std::move(done), deadlineMs,
+         std::move(onData));
+}
+
+QString GuestHttpPipeline::hostKey(const QUrl &url)
+{
+    return QStringLiteral("%1:%2").arg(url.host()).arg(url.port(80));
+}
+
+bool GuestHttpPipeline::supports(const QUrl &url, const QString &capability)
+{
+    const QString host = hostKey(url);
+    auto it = m_capabilities.constFind(host);
+    if (it == m_capabilities.constEnd()) {
+        discover(url, host);
+        return false;
+    }
+    return it->contains(capability);
+}
+
+void GuestHttpPipeline::negotiateFormat(QNetworkRequest &request)
+{
+    if (supports(request.url(), QStringLiteral("cbor"))) {
+        request.setRawHeader("Accept", "application/cbor, application/json;q=0.5");
+    } else {
+        request.setRawHeader("Accept", "application/json");
+    }
+}
+
+void GuestHttpPipeline::discover(const QUrl &url, const QString &host)
+{
+    if (m_discovering.contains(host)) {
+        return;
+    }
+    m_discovering.insert(host);
+
+    QUrl versionUrl(url);
+    versionUrl.setPath(QStringLiteral("/version"));
+    versionUrl.setQuery(QString());
+    get(QNetworkRequest(versionUrl), this, [this, host](const TaskResult &result) {
+        m_discovering.remove(host);
+        // Asked again on next use if the guest could not be reached
+        if (!result.ok() && result.exitCode <= 0) {
+            return;
+        }
+        QStringList capabilities;
+        const QJsonArray list = QJsonDocument::fromJson(result.output).object().value("capabilities").toArray();
+        for (const QJsonValue &value : list) {
+            capabilities.append(value.toString());
+        }
+        m_capabilities.insert(host, capabilities);
+        // Only one guest is talked to at a time, so the queue follows it
+        m_queue->setMaxConcurrent(capabilities.contains(QStringLiteral("h2c")) ? kMaxConcurrentHttp2Requests
+                                                                               : kMaxConcurrentRequests);
+        qDebug() << "Guest capabilities:" << host << capabilities;
+    }, kDiscoveryDeadlineMs);
+}
+
+void GuestHttpPipeline::recordDecode(const QUrl &url, bool cbor, double parseMs)
+{
+    EndpointStats &stats = m_stats[hostKey(url) + url.path()].stats;
+    ++stats.decoded;
+    if (cbor) {
+        ++stats.cborDecoded;
+    }
+    stats.lastParseMs = parseMs;
+    stats.meanParseMs += (parseMs - stats.meanParseMs) / static_cast<double>(stats.decoded);
+}
+
+bool GuestHttpPipeline::isCircuitOpen(const QUrl &url) const
+{
+    return m_circuits.value(hostKey(url)).open;
+}
+
+void GuestHttpPipeline::resetCircuit(const QUrl &url)
+{
+    m_circuits.remove(hostKey(url));
+    forgetCapabilities(hostKey(url));
+}
+
+void GuestHttpPipeline::forgetCapabilities(const QString &host)
+{
+    // The guest may come back with another REDFLAG build
+    if (m_capabilities.remove(host) > 0) {
+        m_queue->setMaxConcurrent(kMaxConcurrentRequests);
+    }
+}
+
+QStringList GuestHttpPipeline::endpoints() const
+{
+    return m_stats.keys();
+}
+
+GuestHttpPipeline::EndpointStats GuestHttpPipeline::stats(const QString &endpoint) const
+{
+    return m_stats.value(endpoint).stats;
+}
+
+AsyncTask *GuestHttpPipeline::send(QNetworkAccessManager::Operation operation, const QNetworkRequest &request,
+                                   const QByteArray &body, QObject *context, Callback done, int deadlineMs,
+                                   DataCallback onData)
+{
+    const QUrl url = request.url();
+    const QString host = hostKey(url);
+    const QString endpoint = host + url.path();
+
+    if (!admit(host)) {
+        ++m_stats[endpoint].stats.rejected;
+        TaskResult result;
+        result.status = TaskResult::Failed;
+        result.errorString = QStringLiteral("guest unreachable (circuit open)");
+        // Same delivery as a real reply: later, and only while context lives
+        QTimer::singleShot(0, context, [done = std::move(done), result]() {
+            done(result);
+        });
+        return nullptr;
+    }
+
+    // Single flight: identical requests share one reply. A streamed body
+    // can only be consumed once, so those always get their own.
+    QByteArray key;
+    Waiter streamWaiter;
+    if (onData) {
+        streamWaiter = Waiter{context, std::move(done)};
+    } else {
+        key = QByteArray::number(operation) + ' ' + url.toEncoded();
+        if (!body.isEmpty()) {
+            key += '\n' + body;
+        }
+        auto it = m_inFlight.find(key);
+        if (it != m_inFlight.end()) {
+            ++m_stats[endpoint].stats.coalesced;
+            it->append(Waiter{context, std::move(done)});
+            return nullptr;
+        }
+        m_inFlight.insert(key, {Waiter{context, std::move(done)}});
+    }
+
+    // Compressed replies are decoded here rather than by Qt, to see how much
+    // they saved. Prior-knowledge h2c only once the guest has said it speaks
+    // it; older REDFLAG builds would not understand the preface.
+    QNetworkRequest outgoing(request);
+    if (!outgoing.hasRawHeader("Accept-Encoding")) {
+        outgoing.setRawHeader("Accept-Encoding", ContentDecoder::acceptedEncodings());
+    }
+    if (supports(url, QStringLiteral("h2c"))) {
+        outgoing.setAttribute(QNetworkRequest::Http2DirectAttribute, true);
+    }
+
+    QNetworkAccessManager *network = m_network;
+    QPointer<QObject> guard(context);
+    QElapsedTimer elapsed;
+    elapsed.start();
+    auto transfer = std::make_shared<Transfer>();
+    return m_queue->runReply([network, operation, outgoing, body, guard, onData, transfer]() -> QNetworkReply * {
+        QNetworkReply *reply = operation == QNetworkAccessManager::PostOperation
+            ? network->post(outgoing, body)
+            : network->get(outgoing);
+        // Connected before ReplyTask's own handler, which takes the body
+        QObject::connect(reply, &QNetworkReply::finished, reply, [reply, transfer]() {
+            transfer->begin(reply);
+        });
+        if (onData) {
+            QObject::connect(reply, &QNetworkReply::readyRead, reply, [reply, guard, onData, transfer]() {
+                transfer->begin(reply);
+                const QByteArray chunk = transfer->decode(reply->readAll());
+                if (transfer->failed()) {
+                    reply->abort();
+                    return;
+                }
+                if (guard && !chunk.isEmpty()) {
+                    onData(chunk);
+                }
+            });
+        }
+        return reply;
+    }, deadlineMs)->then(this, [this, key, host, endpoint, elapsed, streamWaiter, transfer](const TaskResult &reply) {
+        TaskResult result = reply;
+        if (!result.output.isEmpty() && transfer->decoder) {
+            result.output = transfer->decode(result.output);
+        }
+        if (transfer->failed()) {
+            result.status = TaskResult::Failed;
+            result.output.clear();
+            result.errorString = transfer->decoder->errorString();
+        }
+        record(host, endpoint, result, elapsed.nsecsElapsed() / 1.0e6, *transfer);
+        const QList<Waiter> waiters = key.isEmpty() ? QList<Waiter>{streamWaiter} : m_inFlight.take(key);
+        for (const Waiter &waiter : waiters) {
+            if (waiter.context) {
+                waiter.done(result);
+            }
+        }
+    });
+}
+
+bool GuestHttpPipeline::admit(const QString &host)
+{
+    auto it = m_circuits.find(host);
+    if (it == m_circuits.end() || !it->open) {
+        return true;
+    }
+    if (it->probing || !it->retryAt.hasExpired()) {
+        return false;
+    }
+    // Half open: let one trial request through
+    it->probing = true;
+    return true;
+}
+
+void GuestHttpPipeline::record(const QString &host, const QString &endpoint, const TaskResult &result,
+                               double elapsedMs, const Transfer &transfer)
+{
+    // Any HTTP response proves the guest reachable; only transport errors
+    // and timeouts count against the circuit. Requests canceled on this side
+    // (streams closed, catalogs switched) say nothing about the guest.
+    const bool reachable = result.ok() || result.exitCode > 0;
+    const bool canceled = result.status == TaskResult::Canceled;
+
+    Samples &samples = m_stats[endpoint];
+    EndpointStats &stats = samples.stats;
+    ++stats.requests;
+    if (!result.ok() && !canceled) {
+        ++stats.failures;
+    }
+    stats.lastMs = elapsedMs;
+    stats.bytes += transfer.bytes;
+    stats.lastBytes = transfer.bytes;
+    stats.wireBytes += transfer.wireBytes;
+    stats.lastWireBytes = transfer.wireBytes;
+    if (transfer.compressed()) {
+        ++stats.compressed;
+    }
+    if (transfer.http2) {
+        ++stats.http2;
+    }
+    stats.maxMs = qMax(stats.maxMs, elapsedMs);
+    stats.meanMs += (elapsedMs - stats.meanMs) / static_cast<double>(stats.requests);
+    if (samples.window.size() < kLatencyWindow) {
+        samples.window.append(elapsedMs);
+    } else {
+        samples.window[samples.next] = elapsedMs;
+        samples.next = (samples.next + 1) % kLatencyWindow;
+    }
+    QVector<double> sorted = samples.window;
+    std::sort(sorted.begin(), sorted.end());
+    stats.p95Ms = sorted.at(qMin(sorted.size() - 1, static_cast<int>(sorted.size() * 0.95)));
+
+    Circuit &circuit = m_circuits[host];
+    if (reachable) {
+        if (circuit.open) {
+            qDebug() << "Guest circuit closed:" << host;
+        }
+        circuit = Circuit();
+        return;
+    }
+    if (canceled) {
+        // A canceled trial request lets the next one try instead
+        circuit.probing = false;
+        return;
+    }
+    // Stragglers sent before the circuit opened do not extend the cooldown
+    if (circuit.open && !circuit.probing) {
+        return;
+    }
+
+    ++circuit.failures;
+    if (circuit.probing || circuit.failures >= kFailureThreshold) {
+        circuit.cooldownMs = circuit.open ? qMin(circuit.cooldownMs * 2, kMaxCooldownMs) : kInitialCooldownMs;
+        circuit.open = true;
+        circuit.probing = false;
+        forgetCapabilities(host);
+        circuit.retryAt = QDeadlineTimer(circuit.cooldownMs);
+        qDebug() << "Guest circuit open:" << host << "retry in" << circuit.cooldownMs << "ms:"
+                 << result.errorString;
+    }
+}
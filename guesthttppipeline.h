@@ -0,0 +1,134 @@
+#ifndef GUESTHTTPPIPELINE_H
+#define GUESTHTTPPIPELINE_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QSet>
+#include <QDeadlineTimer>
+#include <QNetworkAccessManager>
+#include <QVector>
+#include <functional>
+#include "asynctask.h"
+
+class QNetworkRequest;
+
+// One keep-alive QNetworkAccessManager shared by every REDFLAG client.
+// Replies are requested compressed and decoded here, and guests that announce
+// h2c are spoken to over cleartext HTTP/2, so all requests share one
+// multiplexed connection instead of queueing for six.
+// Requests go through a TaskQueue, so each has a deadline; identical requests
+// in flight (same method, URL and body) are sent once and every caller gets
+// the result. A per-host circuit breaker opens after consecutive transport
+// failures and fails requests fast until a single trial request after the
+// cooldown gets through again.
+class GuestHttpPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Callback = std::function<void(const TaskResult &result)>;
+    using DataCallback = std::function<void(const QByteArray &chunk)>;
+
+    struct EndpointStats {
+        quint64 requests = 0;   // Sent over the network
+        quint64 coalesced = 0;  // Joined an identical request in flight
+        quint64 rejected = 0;   // Failed fast by the circuit breaker
+        quint64 failures = 0;
+        double lastMs = 0;
+        double meanMs = 0;
+        double p95Ms = 0;       // Over the most recent requests
+        double maxMs = 0;
+        quint64 bytes = 0;      // Reply bodies, decoded, summed
+        quint64 lastBytes = 0;
+        quint64 wireBytes = 0;  // The same before Content-Encoding is undone
+        quint64 lastWireBytes = 0;
+        quint64 compressed = 0; // Replies that came with a Content-Encoding
+        quint64 http2 = 0;      // Replies that came over HTTP/2
+        quint64 decoded = 0;    // Replies decoded by the client
+        quint64 cborDecoded = 0;
+        double lastParseMs = 0;
+        double meanParseMs = 0;
+    };
+
+    explicit GuestHttpPipeline(QObject *parent = nullptr);
+    ~GuestHttpPipeline();
+
+    // Process-wide instance, owned by the application object
+    static GuestHttpPipeline *shared();
+
+    // done(result) runs on this thread unless context is destroyed first.
+    // result.exitCode is the HTTP status, 0 if no response arrived.
+    void get(const QNetworkRequest &request, QObject *context, Callback done, int deadlineMs = 10000);
+    void post(const QNetworkRequest &request, const QByteArray &body, QObject *context, Callback done,
+              int deadlineMs = 10000);
+
+    // Hands the reply body to onData chunk by chunk as it arrives, then calls
+    // done with an empty result.output. Streaming requests are not coalesced.
+    // The returned task (null if the circuit is open) can be canceled to end
+    // the stream early; a deadline of 0 lets it run until then.
+    AsyncTask *postStreaming(const QNetworkRequest &request, const QByteArray &body, QObject *context,
+                             DataCallback onData, Callback done, int deadlineMs = 30000);
+    AsyncTask *getStreaming(const QNetworkRequest &request, QObject *context, DataCallback onData, Callback done,
+                            int deadlineMs = 30000);
+
+    // Whether the guest listed capability (e.g. "cbor") in /version. The
+    // first call for a guest starts the lookup and returns false, as do
+    // REDFLAG builds that predate the list.
+    bool supports(const QUrl &url, const QString &capability);
+    // Asks for a CBOR reply if the guest speaks it. Either way the reply may
+    // be JSON, so callers decode by what arrives.
+    void negotiateFormat(QNetworkRequest &request);
+    // Client-side decode time of a reply from url, for stats()
+    void recordDecode(const QUrl &url, bool cbor, double parseMs);
+
+    bool isCircuitOpen(const QUrl &url) const;
+    // Forgets past failures, e.g. once the guest is known to be reachable
+    void resetCircuit(const QUrl &url);
+
+    // Endpoints are keyed "host:port/path"
+    QStringList endpoints() const;
+    EndpointStats stats(const QString &endpoint) const;
+
+private:
+    struct Waiter {
+        QPointer<QObject> context;
+        Callback done;
+    };
+    struct Circuit {
+        int failures = 0;
+        bool open = false;
+        bool probing = false;
+        int cooldownMs = 0;
+        QDeadlineTimer retryAt;
+    };
+    struct Transfer;
+    struct Samples {
+        EndpointStats stats;
+        QVector<double> window;
+        int next = 0;
+    };
+
+    // Returns null for requests that joined another or were rejected
+    AsyncTask *send(QNetworkAccessManager::Operation operation, const QNetworkRequest &request,
+                    const QByteArray &body, QObject *context, Callback done, int deadlineMs,
+                    DataCallback onData = DataCallback());
+    bool admit(const QString &host);
+    void record(const QString &host, const QString &endpoint, const TaskResult &result, double elapsedMs,
+                const Transfer &transfer);
+    void forgetCapabilities(const QString &host);
+    void discover(const QUrl &url, const QString &host);
+
+    static QString hostKey(const QUrl &url);
+
+    TaskQueue *m_queue;
+    QNetworkAccessManager *m_network;
+    QHash<QByteArray, QList<Waiter>> m_inFlight;
+    QHash<QString, Circuit> m_circuits;
+    QHash<QString, Samples> m_stats;
+    QHash<QString, QStringList> m_capabilities;
+    QSet<QString> m_discovering;
+};
+
+#endif // GUESTHTTPPIPELINE_H
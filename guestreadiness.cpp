@@ -0,0 +1,234 @@
+#include "guestreadiness.h"
+#include "asynctask.h"
+#include "guestaddressresolver.h"
+#include "guesthttppipeline.h"
+#include <QNetworkRequest>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+#include <QDebug>
+
+namespace {
+constexpr int kInitialDelayMs = 250;
+constexpr int kMaxDelayMs = 5000;
+constexpr int kConnectTimeoutMs = 1500;
+constexpr int kProbeDeadlineMs = 3000;
+// Failed RDP/health probes after which the address is assumed stale
+constexpr int kReResolveAfter = 8;
+// Health checks of a Ready guest, and the failures in a row it may have
+constexpr int kHealthIntervalMs = 10000;
+constexpr int kHealthFailuresAllowed = 2;
+constexpr quint16 kDefaultRdpPort = 3389;
+constexpr quint16 kDefaultGuestServerPort = 7148;
+} // namespace
+
+GuestReadiness::GuestReadiness(GuestAddressResolver *resolver, TaskQueue *queue, QObject *parent)
+    : QObject(parent)
+    , m_resolver(resolver)
+    , m_queue(queue)
+    , m_rdpPort(kDefaultRdpPort)
+    , m_guestServerPort(kDefaultGuestServerPort)
+{
+    connect(m_resolver, &GuestAddressResolver::addressChanged,
+            this, &GuestReadiness::onAddressChanged);
+}
+
+GuestReadiness::~GuestReadiness()
+{
+    qDeleteAll(m_probes);
+}
+
+void GuestReadiness::setRunning(const QString &vmName, bool running)
+{
+    if (vmName.isEmpty()) {
+        return;
+    }
+
+    Probe *probe = probeFor(vmName);
+    if (!running) {
+        enterStage(probe, Stopped);
+    } else if (probe->stage == Stopped) {
+        enterStage(probe, WaitingForAddress);
+    }
+}
+
+void GuestReadiness::restart(const QString &vmName)
+{
+    Probe *probe = m_probes.value(vmName);
+    if (probe && probe->stage != Stopped) {
+        enterStage(probe, WaitingForAddress);
+    }
+}
+
+void GuestReadiness::forget(const QString &vmName)
+{
+    Probe *probe = m_probes.take(vmName);
+    if (probe) {
+        delete probe->timer;
+        delete probe;
+    }
+}
+
+GuestReadiness::Stage GuestReadiness::stage(const QString &vmName) const
+{
+    const Probe *probe = m_probes.value(vmName);
+    return probe ? probe->stage : Stopped;
+}
+
+QString GuestReadiness::address(const QString &vmName) const
+{
+    const Probe *probe = m_probes.value(vmName);
+    return probe ? probe->address : QString();
+}
+
+void GuestReadiness::setPorts(quint16 rdpPort, quint16 guestServerPort)
+{
+    m_rdpPort = rdpPort;
+    m_guestServerPort = guestServerPort;
+}
+
+GuestReadiness::Probe *GuestReadiness::probeFor(const QString &vmName)
+{
+    Probe *&probe = m_probes[vmName];
+    if (!probe) {
+        probe = new Probe;
+        probe->vmName = vmName;
+        probe->timer = new QTimer(this);
+        probe->timer->setSingleShot(true);
+        connect(probe->timer, &QTimer::timeout, this, [this, vmName]() {
+            runProbe(vmName);
+        });
+    }
+    return probe;
+}
+
+void GuestReadiness::enterStage(Probe *probe, Stage stage, const QString &address)
+{
+    const bool changed = probe->stage != stage || probe->address != address;
+    probe->stage = stage;
+    probe->address = address;
+    probe->attempt = 0;
+    // Results of probes still in flight for the old stage are dropped
+    ++probe->generation;
+
+    probe->timer->stop();
+    if (stage == Ready) {
+        probe->timer->start(kHealthIntervalMs);
+    } else if (stage != Stopped) {
+        probe->timer->start(0);
+    }
+
+    if (changed) {
+        qDebug() << "Guest readiness:" << probe->vmName << stage << address;
+        emit stageChanged(probe->vmName, stage, address);
+    }
+}
+
+void GuestReadiness::retry(Probe *probe)
+{
+    ++probe->attempt;
+    if (probe->stage != WaitingForAddress && probe->attempt >= kReResolveAfter) {
+        m_resolver->invalidate(probe->vmName);
+        enterStage(probe, WaitingForAddress);
+        return;
+    }
+    const int delay = qMin(kMaxDelayMs, kInitialDelayMs << qMin(probe->attempt, 8));
+    probe->timer->start(delay);
+}
+
+void GuestReadiness::runProbe(const QString &vmName)
+{
+    Probe *probe = m_probes.value(vmName);
+    if (!probe) {
+        return;
+    }
+
+    const quint64 generation = probe->generation;
+    const QString address = probe->address;
+    switch (probe->stage) {
+    case WaitingForAddress:
+        m_resolver->resolve(vmName, this, [this, vmName, generation](const QString &ip) {
+            onProbeResult(vmName, generation, !ip.isEmpty(), ip);
+        });
+        break;
+    case WaitingForRdp: {
+        const quint16 port = m_rdpPort;
+        m_queue->run([address, port]() {
+            QTcpSocket socket;
+            socket.connectToHost(address, port);
+            const bool open = socket.waitForConnected(kConnectTimeoutMs);
+            socket.abort();
+            return QVariant(open);
+        }, kProbeDeadlineMs)->then(this, [this, vmName, generation](const TaskResult &result) {
+            onProbeResult(vmName, generation, result.value.toBool());
+        });
+        break;
+    }
+    case WaitingForGuestServer:
+    case Ready: {
+        const QUrl url(QStringLiteral("http://%1:%2/health").arg(address).arg(m_guestServerPort));
+        if (probe->stage == WaitingForGuestServer && probe->attempt == 0) {
+            // RDP answered, so failures from while the guest was booting
+            // should not keep the shared circuit open
+            GuestHttpPipeline::shared()->resetCircuit(url);
+        }
+        GuestHttpPipeline::shared()->get(QNetworkRequest(url), this,
+                                         [this, vmName, generation](const TaskResult &result) {
+            onProbeResult(vmName, generation, result.ok());
+        }, kProbeDeadlineMs);
+        break;
+    }
+    case Stopped:
+        break;
+    }
+}
+
+void GuestReadiness::onProbeResult(const QString &vmName, quint64 generation, bool passed, const QString &address)
+{
+    Probe *probe = m_probes.value(vmName);
+    if (!probe || probe->generation != generation) {
+        return;
+    }
+    if (probe->stage == Ready) {
+        // REDFLAG can die while the VM keeps running
+        if (passed) {
+            probe->attempt = 0;
+            probe->timer->start(kHealthIntervalMs);
+        } else if (++probe->attempt >= kHealthFailuresAllowed) {
+            qDebug() << "Guest server stopped answering:" << vmName;
+            enterStage(probe, WaitingForGuestServer, probe->address);
+        } else {
+            probe->timer->start(kInitialDelayMs << probe->attempt);
+        }
+        return;
+    }
+    if (!passed) {
+        retry(probe);
+        return;
+    }
+
+    switch (probe->stage) {
+    case WaitingForAddress:
+        enterStage(probe, WaitingForRdp, address);
+        break;
+    case WaitingForRdp:
+        enterStage(probe, WaitingForGuestServer, probe->address);
+        break;
+    case WaitingForGuestServer:
+        enterStage(probe, Ready, probe->address);
+        break;
+    case Stopped:
+    case Ready:
+        break;
+    }
+}
+
+void GuestReadiness::onAddressChanged(const QString &vmName, const QString &address)
+{
+    Probe *probe = m_probes.value(vmName);
+    if (!probe || probe->stage == Stopped || probe->address == address) {
+        return;
+    }
+    // The new address has to prove itself again
+    enterStage(probe, WaitingForRdp, address);
+}
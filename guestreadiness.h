@@ -0,0 +1,78 @@
+#ifndef GUESTREADINESS_H
+#define GUESTREADINESS_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+
+class GuestAddressResolver;
+class TaskQueue;
+class QTimer;
+
+// Per-VM readiness pipeline: domain running -> IP known -> RDP port accepting
+// -> REDFLAG /health OK. Each stage is probed with exponential backoff that
+// starts short and is reset on every transition, so a fast guest is picked up
+// within a few hundred milliseconds and a slow one is not hammered. A Ready
+// VM keeps a slow /health check and drops back to WaitingForGuestServer when
+// REDFLAG stops answering; a lease change or restart() re-enters the pipeline.
+class GuestReadiness : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Stage {
+        Stopped,
+        WaitingForAddress,
+        WaitingForRdp,
+        WaitingForGuestServer,
+        Ready
+    };
+    Q_ENUM(Stage)
+
+    GuestReadiness(GuestAddressResolver *resolver, TaskQueue *queue, QObject *parent = nullptr);
+    ~GuestReadiness();
+
+    // Feeds the domain state; starts the pipeline when the VM comes up and
+    // drops back to Stopped when it goes down
+    void setRunning(const QString &vmName, bool running);
+
+    // Runs the pipeline again from the address stage (e.g. after a reboot)
+    void restart(const QString &vmName);
+
+    // Stops tracking the VM
+    void forget(const QString &vmName);
+
+    Stage stage(const QString &vmName) const;
+    QString address(const QString &vmName) const;
+    bool isReady(const QString &vmName) const { return stage(vmName) == Ready; }
+
+    void setPorts(quint16 rdpPort, quint16 guestServerPort);
+
+signals:
+    void stageChanged(const QString &vmName, GuestReadiness::Stage stage, const QString &address);
+
+private:
+    struct Probe {
+        QString vmName;
+        Stage stage = Stopped;
+        QString address;
+        int attempt = 0;
+        quint64 generation = 0;
+        QTimer *timer = nullptr;
+    };
+
+    Probe *probeFor(const QString &vmName);
+    void enterStage(Probe *probe, Stage stage, const QString &address = QString());
+    void retry(Probe *probe);
+    void runProbe(const QString &vmName);
+    void onProbeResult(const QString &vmName, quint64 generation, bool passed, const QString &address = QString());
+    void onAddressChanged(const QString &vmName, const QString &address);
+
+    GuestAddressResolver *m_resolver;
+    TaskQueue *m_queue;
+    QHash<QString, Probe *> m_probes;
+    quint16 m_rdpPort;
+    quint16 m_guestServerPort;
+};
+
+#endif // GUESTREADINESS_H
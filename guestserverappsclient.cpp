@@ -1,39 +1,192 @@
 #include "guestserverappsclient.h"
+#include "guesthttppipeline.h"
+#include "iconstore.h"
+#include "appsstreamdecoder.h"
 #include <QNetworkRequest>
+#include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QUrlQuery>
+#include <QtEndian>
 #include <QDebug>
+#include <memory>
+#include <utility>
+
+namespace {
+constexpr int kIconBatchSize = 32;
+// Apps shown per step while a list streams into an empty grid
+constexpr int kAppsBatchSize = 64;
+constexpr int kMaxIconBatches = 2;
+constexpr int kIconBatchDeadlineMs = 60000;
+constexpr quint32 kMaxIconPathBytes = 32 * 1024;
+constexpr quint32 kMaxIconBytes = 16 * 1024 * 1024;
+// Catalogs kept in memory for instant VM switching, the current one included
+constexpr int kMaxWarmCatalogs = 4;
+
+// /get-icons frame: u32 path length, path (UTF-8), u32 data length, PNG
+// bytes, big endian. Returns false until a whole frame is buffered.
+bool readIconFrame(const QByteArray &buffer, int *offset, QString *path, QByteArray *data, bool *corrupt)
+{
+    const int start = *offset;
+    if (buffer.size() - start < 4) {
+        return false;
+    }
+    const quint32 pathLength = qFromBigEndian<quint32>(buffer.constData() + start);
+    if (pathLength > kMaxIconPathBytes) {
+        *corrupt = true;
+        return false;
+    }
+    const int dataHeader = start + 4 + static_cast<int>(pathLength);
+    if (buffer.size() - dataHeader < 4) {
+        return false;
+    }
+    const quint32 dataLength = qFromBigEndian<quint32>(buffer.constData() + dataHeader);
+    if (dataLength > kMaxIconBytes) {
+        *corrupt = true;
+        return false;
+    }
+    const int end = dataHeader + 4 + static_cast<int>(dataLength);
+    if (buffer.size() < end) {
+        return false;
+    }
+    *path = QString::fromUtf8(buffer.constData() + start + 4, static_cast<int>(pathLength));
+    *data = buffer.mid(dataHeader + 4, static_cast<int>(dataLength));
+    *offset = end;
+    return true;
+}
+} // namespace
+
+struct GuestServerAppsClient::AppsStream {
+    AppsStreamDecoder decoder;
+    QList<InstalledApp> apps;
+    QHash<QString, QString> iconStamps;
+    QList<InstalledApp> batch;      // Not yet shown
+    QStringList iconPaths;          // Not yet requested
+    bool progressive = false;
+    double parseMs = 0;
+};
+
+struct GuestServerAppsClient::IconBatch {
+    QSet<QString> missing;
+    QByteArray buffer;
+    bool corrupt = false;
+};
 
 GuestServerAppsClient::GuestServerAppsClient(const QString &host, quint16 port, QObject *parent)
     : QObject(parent)
-    , m_networkManager(new QNetworkAccessManager(this))
     , m_baseUrl(host.isEmpty() || port == 0 ? QString() : QString("http://%1:%2").arg(host).arg(port))
+    , m_generation(0)
+    , m_activeIconBatches(0)
+    , m_batchIconsSupported(true)
+    , m_stale(true)
+    , m_appsLoading(false)
     , m_cache(new AppsCache(this))
 {
-    connect(m_networkManager, &QNetworkAccessManager::finished,
-            this, [this](QNetworkReply *reply) {
-                if (reply->request().url().path().contains("/apps")) {
-                    onAppsReply(reply);
-                } else if (reply->request().url().path().contains("/get-icon")) {
-                    onIconReply(reply);
-                }
-            });
 }
 
 GuestServerAppsClient::~GuestServerAppsClient()
 {
-    // Save apps to cache when client is destroyed
-    saveAppsToCache();
+    // Every change was already handed to the write-behind worker
 }
 
 void GuestServerAppsClient::setServerEndpoint(const QString &host, quint16 port)
 {
+    const QString previous = m_baseUrl;
     if (host.isEmpty() || port == 0) {
         m_baseUrl.clear();
     } else {
         m_baseUrl = QString("http://%1:%2").arg(host).arg(port);
     }
+    if (m_baseUrl != previous) {
+        dropIconFetches();
+        m_batchIconsSupported = true;
+        // Kept on screen, but no longer backed by a live guest
+        setStale(true);
+    }
+}
+
+void GuestServerAppsClient::setCatalog(const QString &catalogId)
+{
+    if (catalogId == m_catalogId) {
+        return;
+    }
+    
+    // Keep the outgoing catalog warm
+    if (!m_catalogId.isEmpty()) {
+        m_catalogs.insert(m_catalogId, Catalog{m_apps, m_iconStamps});
+    }
+    dropIconFetches();
+    m_catalogId = catalogId;
+    
+    auto warm = m_catalogs.find(catalogId);
+    if (warm != m_catalogs.end()) {
+        m_apps = warm->apps;
+        m_iconStamps = warm->iconStamps;
+        m_catalogs.erase(warm);
+    } else {
+        m_apps.clear();
+        m_cache->setCatalog(catalogId);
+        if (m_cache->cacheExists()) {
+            m_cache->loadApps(m_apps);
+        }
+        m_iconStamps = iconStampsOf(m_apps);
+    }
+    if (!catalogId.isEmpty()) {
+        touchCatalog(catalogId);
+        AppsCache::setLastCatalog(catalogId);
+    }
+    
+    qDebug() << "Apps catalog switched to:" << catalogId << "(" << m_apps.size() << "apps)";
+    emit appsReceived(m_catalogId, m_apps);
+    setStale(true);
+}
+
+bool GuestServerAppsClient::restoreLastCatalog()
+{
+    const QString catalogId = AppsCache::lastCatalog();
+    if (catalogId.isEmpty() || !m_catalogId.isEmpty()) {
+        return false;
+    }
+    setCatalog(catalogId);
+    return !m_apps.isEmpty();
+}
+
+void GuestServerAppsClient::setStale(bool stale)
+{
+    if (stale != m_stale) {
+        m_stale = stale;
+        emit staleChanged(stale);
+    }
+}
+
+void GuestServerAppsClient::touchCatalog(const QString &catalogId)
+{
+    m_recentCatalogs.removeAll(catalogId);
+    m_recentCatalogs.prepend(catalogId);
+    while (m_recentCatalogs.size() > kMaxWarmCatalogs) {
+        m_catalogs.remove(m_recentCatalogs.takeLast());
+    }
+}
+
+QHash<QString, QString> GuestServerAppsClient::iconStampsOf(const QList<InstalledApp> &apps)
+{
+    QHash<QString, QString> stamps;
+    for (const InstalledApp &app : apps) {
+        if (!app.iconPath.isEmpty()) {
+            stamps.insert(app.iconPath, app.iconStamp);
+        }
+    }
+    return stamps;
+}
+
+void GuestServerAppsClient::dropIconFetches()
+{
+    // Icons in flight or queued for the old guest or catalog are not delivered
+    ++m_generation;
+    m_appsLoading = false;
+    m_iconQueue.clear();
+    m_pendingIconRequests.clear();
+    IconStore::shared()->cancelDecodes();
 }
 
 void GuestServerAppsClient::fetchApps()
@@ -42,93 +195,119 @@ void GuestServerAppsClient::fetchApps()
         emit error("Server endpoint not configured");
         return;
     }
+    // Repeated calls while the list is loading share the download
+    if (m_appsLoading) {
+        return;
+    }
     
     QUrl url(m_baseUrl + "/apps");
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    GuestHttpPipeline::shared()->negotiateFormat(request);
     
-    // The reply will be handled by the QNetworkAccessManager::finished signal
-    // connected in the constructor, so we don't need to connect here
-    m_networkManager->get(request);
+    // Enumerating the registry can take a while on a cold guest. Apps are
+    // decoded as the body arrives; with nothing on screen yet they are shown
+    // batch by batch.
+    auto stream = std::make_shared<AppsStream>();
+    stream->progressive = m_apps.isEmpty();
+    m_appsLoading = true;
+    const quint64 generation = m_generation;
+    GuestHttpPipeline::shared()->getStreaming(request, this, [this, generation, stream](const QByteArray &chunk) {
+        // Drop lists from a guest or catalog we are no longer showing
+        if (generation == m_generation) {
+            onAppsData(*stream, chunk);
+        }
+    }, [this, generation, stream](const TaskResult &result) {
+        if (generation == m_generation) {
+            m_appsLoading = false;
+            onAppsFinished(*stream, result);
+        }
+    }, 30000);
 }
 
-void GuestServerAppsClient::onAppsReply(QNetworkReply *reply)
+void GuestServerAppsClient::onAppsData(AppsStream &stream, const QByteArray &chunk)
 {
-    // Check if reply is still valid (might have been deleted by duplicate call)
-    if (!reply) {
+    QElapsedTimer elapsed;
+    elapsed.start();
+    const QList<InstalledApp> apps = stream.decoder.feed(chunk);
+    stream.parseMs += elapsed.nsecsElapsed() / 1.0e6;
+    if (apps.isEmpty()) {
         return;
     }
     
-    // Mark for deletion first to prevent duplicate handling
-    reply->deleteLater();
-    
-    if (reply->error() != QNetworkReply::NoError) {
-        emit error(reply->errorString());
-        return;
+    IconStore *icons = IconStore::shared();
+    for (const InstalledApp &app : apps) {
+        if (app.name.isEmpty()) {
+            continue;
+        }
+        stream.apps.append(app);
+        if (stream.progressive) {
+            stream.batch.append(app);
+        }
+        
+        // Fetch icon if path is available and not an uninstaller
+        if (!app.iconPath.isEmpty()) {
+            QString iconPathLower = app.iconPath.toLower();
+            // Skip uninstallers and maintenance tools
+            if (!iconPathLower.contains("uninstall") && 
+                !iconPathLower.contains("unins000") &&
+                !iconPathLower.contains("maintenance service")) {
+                stream.iconStamps.insert(app.iconPath, app.iconStamp);
+                // Icons that arrive before the list is complete are stored
+                // under this stamp
+                m_iconStamps.insert(app.iconPath, app.iconStamp);
+                // Unchanged icons are already on disk
+                if (!icons->isCurrent(m_catalogId, app.iconPath, app.iconStamp)) {
+                    stream.iconPaths.append(app.iconPath);
+                }
+            }
+        }
     }
     
-    QByteArray responseData = reply->readAll();
-    
-    // Skip empty responses (might be from duplicate handling)
-    if (responseData.isEmpty()) {
-        qDebug() << "Skipping empty response (likely duplicate)";
+    if (stream.batch.size() >= kAppsBatchSize) {
+        emit appsBatchReceived(m_catalogId, stream.batch);
+        stream.batch.clear();
+    }
+    // Icon downloads start long before the list is complete
+    if (stream.iconPaths.size() >= kIconBatchSize) {
+        fetchIcons(stream.iconPaths);
+        stream.iconPaths.clear();
+    }
+}
+
+void GuestServerAppsClient::onAppsFinished(AppsStream &stream, const TaskResult &result)
+{
+    if (!result.ok()) {
+        emit error(result.errorString);
         return;
     }
     
-    // Debug: log the raw response
-    qDebug() << "Apps response:" << responseData.left(500);
-    
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(responseData);
-    
-    if (jsonDoc.isNull() || !jsonDoc.isObject()) {
-        qWarning() << "Invalid JSON response. Raw data:" << responseData;
-        emit error(QString("Invalid JSON response from server: %1").arg(QString::fromUtf8(responseData.left(200))));
+    if (stream.decoder.bytesRead() == 0) {
+        qDebug() << "Skipping empty apps response";
         return;
     }
-    
-    QJsonObject json = jsonDoc.object();
-    
-    // Check if response contains an error
-    if (json.contains("error")) {
-        QString errorMsg = json["error"].toString();
-        qWarning() << "Server returned error:" << errorMsg;
-        emit error(QString("Server error: %1").arg(errorMsg));
+    GuestHttpPipeline::shared()->recordDecode(QUrl(m_baseUrl + "/apps"), stream.decoder.isCbor(), stream.parseMs);
+    if (!stream.decoder.errorString().isEmpty()) {
+        qWarning() << "Server returned error:" << stream.decoder.errorString();
+        emit error(QString("Server error: %1").arg(stream.decoder.errorString()));
         return;
     }
-    
-    QJsonArray appsArray = json["apps"].toArray();
-    
-    m_apps.clear();
-    
-    for (const QJsonValue &value : appsArray) {
-        QJsonObject appObj = value.toObject();
-        
-        InstalledApp app;
-        app.name = appObj["name"].toString();
-        app.publisher = appObj["publisher"].toString();
-        app.installLocation = appObj["install_location"].toString();
-        app.displayVersion = appObj["display_version"].toString();
-        // Handle null icon_path - toString() returns empty string for null, which is fine
-        app.iconPath = appObj["icon_path"].isNull() ? QString() : appObj["icon_path"].toString();
-        app.uninstallString = appObj["uninstall_string"].isNull() ? QString() : appObj["uninstall_string"].toString();
-        
-        if (!app.name.isEmpty()) {
-            m_apps.append(app);
-            
-            // Fetch icon if path is available and not an uninstaller
-            if (!app.iconPath.isEmpty()) {
-                QString iconPathLower = app.iconPath.toLower();
-                // Skip uninstallers and maintenance tools
-                if (!iconPathLower.contains("uninstall") && 
-                    !iconPathLower.contains("unins000") &&
-                    !iconPathLower.contains("maintenance service")) {
-                    fetchIcon(app.iconPath);
-                }
-            }
-        }
+    if (stream.decoder.hasFailed() || !stream.decoder.isComplete()) {
+        qWarning() << "Invalid apps response after" << stream.decoder.bytesRead() << "bytes";
+        emit error(stream.decoder.isCbor() ? QString("Invalid CBOR response from server")
+                                           : QString("Invalid JSON response from server"));
+        return;
     }
     
-    emit appsReceived(m_apps);
+    qDebug() << "Apps response:" << stream.apps.size() << "apps in" << stream.decoder.bytesRead()
+             << (stream.decoder.isCbor() ? "bytes of CBOR," : "bytes of JSON,") << "at most"
+             << stream.decoder.peakBuffered() << "buffered, parsed in" << stream.parseMs << "ms";
+    m_apps = stream.apps;
+    m_iconStamps = stream.iconStamps;
+    emit appsReceived(m_catalogId, m_apps);
+    setStale(false);
+    saveAppsToCache();
+    fetchIcons(stream.iconPaths);
 }
 
 void GuestServerAppsClient::fetchIcon(const QString &iconPath)
@@ -141,7 +320,12 @@ void GuestServerAppsClient::fetchIcon(const QString &iconPath)
     if (m_pendingIconRequests.contains(iconPath)) {
         return;
     }
-    
+    m_pendingIconRequests.insert(iconPath);
+    sendIconRequest(iconPath);
+}
+
+void GuestServerAppsClient::sendIconRequest(const QString &iconPath)
+{
     QUrl url(m_baseUrl + "/get-icon");
     QNetworkRequest request(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
@@ -150,67 +334,163 @@ void GuestServerAppsClient::fetchIcon(const QString &iconPath)
     QString encodedPath = QUrl::toPercentEncoding(iconPath);
     QByteArray postData = ("path=" + encodedPath).toUtf8();
     
-    QNetworkReply *reply = m_networkManager->post(request, postData);
-    m_pendingIconRequests[iconPath] = reply;
+    // The guest answers 304 if the stored copy is still current
+    const QString storedStamp = IconStore::shared()->stamp(m_catalogId, iconPath);
+    if (!storedStamp.isEmpty()) {
+        request.setRawHeader("If-None-Match", '"' + storedStamp.toUtf8() + '"');
+    }
+    
+    const quint64 generation = m_generation;
+    GuestHttpPipeline::shared()->post(request, postData, this,
+                                      [this, iconPath, generation](const TaskResult &result) {
+        if (generation == m_generation) {
+            onIconReply(iconPath, result);
+        }
+    }, 10000);
 }
 
-void GuestServerAppsClient::onIconReply(QNetworkReply *reply)
+void GuestServerAppsClient::onIconReply(const QString &iconPath, const TaskResult &result)
 {
-    reply->deleteLater();
-    
-    // Find which icon path this reply corresponds to
-    QString iconPath;
-    for (auto it = m_pendingIconRequests.begin(); it != m_pendingIconRequests.end(); ++it) {
-        if (it.value() == reply) {
-            iconPath = it.key();
-            m_pendingIconRequests.erase(it);
-            break;
-        }
+    if (result.exitCode == 304) {
+        m_pendingIconRequests.remove(iconPath);
+        emit iconReceived(iconPath, IconStore::shared()->image(m_catalogId, iconPath));
+        return;
     }
-    
-    if (iconPath.isEmpty()) {
+    if (!result.ok()) {
+        qWarning() << "Failed to fetch icon:" << iconPath << result.errorString;
+        // Not stored, so the next list retries it; UI shows the first letter
+        m_pendingIconRequests.remove(iconPath);
+        emit iconReceived(iconPath, QImage());
         return;
     }
     
-    if (reply->error() != QNetworkReply::NoError) {
-        qWarning() << "Failed to fetch icon:" << iconPath << reply->errorString();
-        // Emit empty icon data to signal failure - UI will show first letter
-        emit iconReceived(iconPath, QByteArray());
+    // An empty body decodes to empty icon data
+    deliverIcon(iconPath, QByteArray::fromBase64(result.output.trimmed()));
+}
+
+void GuestServerAppsClient::fetchIcons(const QStringList &iconPaths)
+{
+    if (m_baseUrl.isEmpty()) {
         return;
     }
-    
-    QByteArray base64Data = reply->readAll().trimmed();
-    if (!base64Data.isEmpty()) {
-        QByteArray iconData = QByteArray::fromBase64(base64Data);
-        emit iconReceived(iconPath, iconData);
-        
-        // Update the app in our list
-        for (auto &app : m_apps) {
-            if (app.iconPath == iconPath) {
-                app.iconData = iconData;
-                break;
-            }
+    for (const QString &iconPath : iconPaths) {
+        if (!iconPath.isEmpty() && !m_pendingIconRequests.contains(iconPath)) {
+            m_pendingIconRequests.insert(iconPath);
+            m_iconQueue.append(iconPath);
         }
-    } else {
-        // Empty response - emit empty icon data
-        emit iconReceived(iconPath, QByteArray());
     }
+    pumpIconBatches();
+}
+
+void GuestServerAppsClient::pumpIconBatches()
+{
+    if (!m_batchIconsSupported) {
+        // The pipeline bounds how many of these run at once
+        const QStringList queued = m_iconQueue;
+        m_iconQueue.clear();
+        for (const QString &iconPath : queued) {
+            sendIconRequest(iconPath);
+        }
+        return;
+    }
+
+    while (m_activeIconBatches < kMaxIconBatches && !m_iconQueue.isEmpty()) {
+        const QStringList batch = m_iconQueue.mid(0, kIconBatchSize);
+        m_iconQueue = m_iconQueue.mid(batch.size());
+        fetchIconBatch(batch);
+    }
+}
+
+void GuestServerAppsClient::fetchIconBatch(const QStringList &iconPaths)
+{
+    QUrl url(m_baseUrl + "/get-icons");
+    QNetworkRequest request(url);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+
+    QJsonObject body;
+    body["paths"] = QJsonArray::fromStringList(iconPaths);
+
+    auto batch = std::make_shared<IconBatch>();
+    for (const QString &iconPath : iconPaths) {
+        batch->missing.insert(iconPath);
+    }
+
+    ++m_activeIconBatches;
+    const quint64 generation = m_generation;
+    GuestHttpPipeline::shared()->postStreaming(request, QJsonDocument(body).toJson(QJsonDocument::Compact), this,
+        [this, batch, generation](const QByteArray &chunk) {
+            if (batch->corrupt || generation != m_generation) {
+                return;
+            }
+            // Hand out every icon as soon as its frame is complete
+            batch->buffer.append(chunk);
+            int offset = 0;
+            QString iconPath;
+            QByteArray iconData;
+            while (readIconFrame(batch->buffer, &offset, &iconPath, &iconData, &batch->corrupt)) {
+                if (batch->missing.remove(iconPath)) {
+                    deliverIcon(iconPath, iconData);
+                }
+            }
+            batch->buffer.remove(0, offset);
+            if (batch->corrupt) {
+                qWarning() << "Malformed /get-icons stream; fetching the rest one by one";
+            }
+        },
+        [this, batch, generation](const TaskResult &result) {
+            --m_activeIconBatches;
+            if (generation != m_generation) {
+                pumpIconBatches();
+                return;
+            }
+            if (result.exitCode == 404 || result.exitCode == 405) {
+                qDebug() << "Guest server has no /get-icons; using /get-icon per icon";
+                m_batchIconsSupported = false;
+            }
+            // Whatever the batch did not deliver goes through /get-icon
+            for (const QString &iconPath : std::as_const(batch->missing)) {
+                sendIconRequest(iconPath);
+            }
+            pumpIconBatches();
+        }, kIconBatchDeadlineMs);
+}
+
+void GuestServerAppsClient::deliverIcon(const QString &iconPath, const QByteArray &iconData)
+{
+    m_pendingIconRequests.remove(iconPath);
+    
+    // Decoded and scaled once off the GUI thread, then kept on disk under the
+    // list's stamp
+    const quint64 generation = m_generation;
+    IconStore::shared()->store(m_catalogId, iconPath, m_iconStamps.value(iconPath), iconData, this,
+                               [this, iconPath, generation](const QImage &icon) {
+        if (generation == m_generation) {
+            emit iconReceived(iconPath, icon);
+        }
+    });
 }
 
 void GuestServerAppsClient::saveAppsToCache()
 {
     if (!m_apps.isEmpty() && m_cache) {
-        m_cache->saveApps(m_apps);
+        m_cache->setCatalog(m_catalogId);
+        m_cache->scheduleSave(m_apps);
     }
 }
 
 void GuestServerAppsClient::loadAppsFromCache()
 {
-    if (m_cache && m_cache->cacheExists()) {
+    if (!m_cache) {
+        return;
+    }
+    m_cache->setCatalog(m_catalogId);
+    if (m_cache->cacheExists()) {
         QList<InstalledApp> cachedApps;
         if (m_cache->loadApps(cachedApps)) {
             m_apps = cachedApps;
-            emit appsReceived(m_apps);
+            m_iconStamps = iconStampsOf(m_apps);
+            emit appsReceived(m_catalogId, m_apps);
+            setStale(true);
         }
     }
 }
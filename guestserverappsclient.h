@@ -2,11 +2,15 @@
 #define GUESTSERVERAPPSCLIENT_H
 
 #include <QObject>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
+#include <QHash>
+#include <QImage>
+#include <QSet>
 #include <QJsonArray>
 #include <QJsonObject>
 #include "appscache.h"
+#include "jsoncodec.h"
+
+struct TaskResult;
 
 struct InstalledApp {
     QString name;
@@ -15,7 +19,20 @@ struct InstalledApp {
     QString displayVersion;
     QString iconPath;
     QString uninstallString;
-    QByteArray iconData; // Base64 decoded icon
+    QString iconStamp;   // Changes with the icon source; empty if unknown
+};
+
+// One record of the guest's /apps list
+template <>
+struct JsonCodec::Schema<InstalledApp> {
+    static constexpr auto fields = std::make_tuple(
+        JsonCodec::field("name", &InstalledApp::name),
+        JsonCodec::field("publisher", &InstalledApp::publisher),
+        JsonCodec::field("install_location", &InstalledApp::installLocation),
+        JsonCodec::field("display_version", &InstalledApp::displayVersion),
+        JsonCodec::field("icon_path", &InstalledApp::iconPath),
+        JsonCodec::field("uninstall_string", &InstalledApp::uninstallString),
+        JsonCodec::field("icon_stamp", &InstalledApp::iconStamp));
 };
 
 class GuestServerAppsClient : public QObject
@@ -28,26 +45,72 @@ public:
     
     void fetchApps();
     void fetchIcon(const QString &iconPath);
+    // Batched: a few /get-icons requests stream raw PNGs back, falling back
+    // to one /get-icon request per icon on servers without the endpoint
+    void fetchIcons(const QStringList &iconPaths);
     void setServerEndpoint(const QString &host, quint16 port);
     void saveAppsToCache();
     void loadAppsFromCache();
     
+    // Switches to another VM's catalog (keyed by libvirt domain UUID) and
+    // emits it right away, from memory if it is among the most recently used
+    // ones, else from disk. fetchApps() revalidates it against the guest.
+    void setCatalog(const QString &catalogId);
+    QString catalogId() const { return m_catalogId; }
+    // Shows the catalog of the previous run from disk; returns false if
+    // there is none. Called before the VM list is known.
+    bool restoreLastCatalog();
+    
+    // The catalog shown was not confirmed by the guest since it was loaded
+    // or the guest went away
+    bool isStale() const { return m_stale; }
+    
     QList<InstalledApp> apps() const { return m_apps; }
 
 signals:
-    void appsReceived(const QList<InstalledApp> &apps);
-    void iconReceived(const QString &iconPath, const QByteArray &iconData);
+    void appsReceived(const QString &catalogId, const QList<InstalledApp> &apps);
+    // Part of a list still downloading, only sent while nothing else of the
+    // catalog is shown; appsReceived follows with the whole list
+    void appsBatchReceived(const QString &catalogId, const QList<InstalledApp> &apps);
+    // icon is display-sized; null if the guest has no icon for the path
+    void iconReceived(const QString &iconPath, const QImage &icon);
+    void staleChanged(bool stale);
     void error(const QString &error);
 
-private slots:
-    void onAppsReply(QNetworkReply *reply);
-    void onIconReply(QNetworkReply *reply);
-
 private:
-    QNetworkAccessManager *m_networkManager;
+    struct AppsStream;
+    struct IconBatch;
+    struct Catalog {
+        QList<InstalledApp> apps;
+        QHash<QString, QString> iconStamps;
+    };
+
+    void dropIconFetches();
+    void setStale(bool stale);
+    void touchCatalog(const QString &catalogId);
+    static QHash<QString, QString> iconStampsOf(const QList<InstalledApp> &apps);
+    void onAppsData(AppsStream &stream, const QByteArray &chunk);
+    void onAppsFinished(AppsStream &stream, const TaskResult &result);
+    void sendIconRequest(const QString &iconPath);
+    void onIconReply(const QString &iconPath, const TaskResult &result);
+    void pumpIconBatches();
+    void fetchIconBatch(const QStringList &iconPaths);
+    void deliverIcon(const QString &iconPath, const QByteArray &iconData);
+
     QString m_baseUrl;
+    QString m_catalogId;
     QList<InstalledApp> m_apps;
-    QMap<QString, QNetworkReply*> m_pendingIconRequests;
+    QHash<QString, QString> m_iconStamps;
+    QHash<QString, Catalog> m_catalogs;     // Warm catalogs of other VMs
+    QStringList m_recentCatalogs;           // Most recently used first
+    // Bumped when the endpoint or catalog changes; older replies are dropped
+    quint64 m_generation;
+    QSet<QString> m_pendingIconRequests;
+    QStringList m_iconQueue;
+    int m_activeIconBatches;
+    bool m_batchIconsSupported;
+    bool m_stale;
+    bool m_appsLoading;
     AppsCache *m_cache;
 };
 
@@ -1,23 +1,59 @@
 #include "guestserverclient.h"
+#include "guesthttppipeline.h"
+#include "cborcodec.h"
 #include <QNetworkRequest>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonValue>
+#include <QElapsedTimer>
 #include <QDateTime>
+#include <QUrlQuery>
+#include <QDebug>
+
+namespace {
+// Sample interval asked of guests that stream; the UI's poll interval is
+// only used if it is shorter
+constexpr int kStreamIntervalMs = 1000;
+// The stream is reopened if no sample arrives for this many intervals
+constexpr int kStreamIdleIntervals = 5;
+constexpr int kInitialBackoffMs = 1000;
+constexpr int kMaxBackoffMs = 30000;
+// Longest line the stream may send; a sample is a few hundred bytes
+constexpr int kMaxStreamLineBytes = 64 * 1024;
+
+// Sent on the stream instead of a sample when the guest could not take one
+struct StreamError {
+    QString error;
+};
+} // namespace
+
+template <>
+struct JsonCodec::Schema<StreamError> {
+    static constexpr auto fields = std::make_tuple(JsonCodec::field("error", &StreamError::error));
+};
 
 GuestServerClient::GuestServerClient(const QString &host, quint16 port, const QString &authKey, QObject *parent)
     : QObject(parent)
-    , m_networkManager(new QNetworkAccessManager(this))
     , m_timer(new QTimer(this))
     , m_baseUrl(host.isEmpty() || port == 0 ? QString() : QString("http://%1:%2").arg(host).arg(port))
     , m_authKey(authKey)
     , m_isMonitoring(false)
+    , m_requestInFlight(false)
     , m_intervalMs(5000)
+    , m_streamWatchdog(new QTimer(this))
+    , m_reconnectTimer(new QTimer(this))
+    , m_backoffMs(kInitialBackoffMs)
+    , m_streamUnsupported(false)
+    , m_streamGeneration(0)
 {
-    connect(m_networkManager, &QNetworkAccessManager::finished, 
-            this, &GuestServerClient::onMetricsReply);
-    
     connect(m_timer, &QTimer::timeout, this, &GuestServerClient::fetchMetrics);
+    m_streamWatchdog->setSingleShot(true);
+    connect(m_streamWatchdog, &QTimer::timeout, this, [this]() {
+        // Ends as canceled, which reconnects
+        qDebug() << "Metrics stream idle, reconnecting";
+        if (m_stream) {
+            m_stream->cancel();
+        }
+    });
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, &GuestServerClient::fetchMetrics);
     
     // Initialize with default values
     m_currentMetrics = GuestServerMetrics{};
@@ -36,6 +72,9 @@ void GuestServerClient::startMonitoring(int intervalMs)
     }
 
     m_isMonitoring = true;
+    if (isStreaming()) {
+        return;
+    }
     m_timer->start(m_intervalMs);
     fetchMetrics(); // Initial fetch or refresh
 }
@@ -45,6 +84,8 @@ void GuestServerClient::stopMonitoring()
     if (m_timer->isActive()) {
         m_timer->stop();
     }
+    m_reconnectTimer->stop();
+    closeStream();
     m_isMonitoring = false;
 }
 
@@ -56,6 +97,11 @@ void GuestServerClient::setServerEndpoint(const QString &host, quint16 port, con
         m_baseUrl = QString("http://%1:%2").arg(host).arg(port);
     }
     m_authKey = authKey;
+    // The new guest gets asked for a stream afresh
+    closeStream();
+    m_reconnectTimer->stop();
+    m_streamUnsupported = false;
+    m_backoffMs = kInitialBackoffMs;
     if (m_isMonitoring) {
         fetchMetrics();
     }
@@ -68,11 +114,26 @@ GuestServerMetrics GuestServerClient::currentMetrics() const
 
 void GuestServerClient::fetchMetrics()
 {
-    if (m_baseUrl.isEmpty()) {
+    if (m_baseUrl.isEmpty() || isStreaming()) {
         return;
     }
-    
+    // Guests that push samples are switched to on the next tick once /version
+    // has told us so; older ones keep being polled
     QUrl url(m_baseUrl + "/metrics");
+    if (m_isMonitoring && !m_streamUnsupported
+        && GuestHttpPipeline::shared()->supports(url, QStringLiteral("metrics-stream"))) {
+        openStream();
+        return;
+    }
+    if (m_isMonitoring && !m_timer->isActive()) {
+        m_timer->start(m_intervalMs);
+    }
+    // REDFLAG samples CPU for a while per request; skip the tick instead of
+    // stacking another request behind the one in flight
+    if (m_requestInFlight) {
+        return;
+    }
+    
     QNetworkRequest request(url);
     
     // Add authentication header if key is provided
@@ -80,51 +141,145 @@ void GuestServerClient::fetchMetrics()
         request.setRawHeader("Authorization", QString("Bearer %1").arg(m_authKey).toUtf8());
     }
     
-    // Set headers for JSON response
+    // CBOR if the guest speaks it, JSON otherwise
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    GuestHttpPipeline::shared()->negotiateFormat(request);
     
-    // Make the request
-    m_networkManager->get(request);
+    // The deadline keeps a dead guest from leaving the request hanging
+    const QString baseUrl = m_baseUrl;
+    m_requestInFlight = true;
+    GuestHttpPipeline::shared()->get(request, this, [this, baseUrl](const TaskResult &result) {
+        m_requestInFlight = false;
+        if (baseUrl == m_baseUrl) {
+            onMetricsReply(result);
+        }
+    }, qMax(1000, m_intervalMs - 500));
 }
 
-void GuestServerClient::onMetricsReply(QNetworkReply *reply)
+void GuestServerClient::onMetricsReply(const TaskResult &result)
 {
-    reply->deleteLater();
-    
-    if (reply->error() != QNetworkReply::NoError) {
-        emit connectionError(reply->errorString());
+    if (!result.ok()) {
+        emit connectionError(result.errorString);
         return;
     }
     
-    // Read the response
-    QByteArray responseData = reply->readAll();
-    QJsonDocument jsonDoc = QJsonDocument::fromJson(responseData);
-    
-    if (jsonDoc.isNull() || !jsonDoc.isObject()) {
-        emit connectionError("Invalid JSON response from server");
-        return;
+    applyMetrics(result.output, QUrl(m_baseUrl + "/metrics"));
+}
+
+bool GuestServerClient::applyMetrics(const QByteArray &data, const QUrl &url)
+{
+    // Missing fields read as 0, as before
+    QElapsedTimer elapsed;
+    elapsed.start();
+    GuestServerMetrics metrics{};
+    const bool cbor = CborCodec::startsWithMap(data.constData(), data.size());
+    const bool decoded = cbor ? CborCodec::decode(data, metrics) : JsonCodec::decode(data, metrics);
+    GuestHttpPipeline::shared()->recordDecode(url, cbor, elapsed.nsecsElapsed() / 1.0e6);
+    if (!decoded) {
+        emit connectionError(cbor ? "Invalid CBOR response from server" : "Invalid JSON response from server");
+        return false;
     }
-    
-    QJsonObject json = jsonDoc.object();
-    
-    // Parse CPU metrics
-    QJsonObject cpuObj = json["cpu"].toObject();
-    m_currentMetrics.cpu.usage = cpuObj["usage"].toDouble();
-    m_currentMetrics.cpu.frequency = static_cast<quint64>(cpuObj["frequency"].toDouble());
-    
-    // Parse RAM metrics
-    QJsonObject ramObj = json["ram"].toObject();
-    m_currentMetrics.ram.used = static_cast<quint64>(ramObj["used"].toDouble());
-    m_currentMetrics.ram.total = static_cast<quint64>(ramObj["total"].toDouble());
-    m_currentMetrics.ram.percentage = ramObj["percentage"].toDouble();
-    
-    // Parse Disk metrics
-    QJsonObject diskObj = json["disk"].toObject();
-    m_currentMetrics.disk.used = static_cast<quint64>(diskObj["used"].toDouble());
-    m_currentMetrics.disk.total = static_cast<quint64>(diskObj["total"].toDouble());
-    m_currentMetrics.disk.percentage = diskObj["percentage"].toDouble();
+    m_currentMetrics = metrics;
     
     m_currentMetrics.lastUpdated = QDateTime::currentDateTime();
     
     emit metricsUpdated(m_currentMetrics);
+    return true;
+}
+
+void GuestServerClient::openStream()
+{
+    m_timer->stop();
+    m_reconnectTimer->stop();
+
+    const int intervalMs = qMin(m_intervalMs, kStreamIntervalMs);
+    QUrl url(m_baseUrl + "/metrics/stream");
+    QUrlQuery query;
+    query.addQueryItem(QStringLiteral("interval_ms"), QString::number(intervalMs));
+    url.setQuery(query);
+    QNetworkRequest request(url);
+    if (!m_authKey.isEmpty()) {
+        request.setRawHeader("Authorization", QString("Bearer %1").arg(m_authKey).toUtf8());
+    }
+
+    // No deadline: the watchdog notices a stream that stopped delivering
+    const quint64 generation = ++m_streamGeneration;
+    m_streamBuffer.clear();
+    m_streamWatchdog->start(intervalMs * kStreamIdleIntervals + 1000);
+    m_stream = GuestHttpPipeline::shared()->getStreaming(request, this, [this, generation](const QByteArray &chunk) {
+        if (generation == m_streamGeneration) {
+            onStreamData(chunk);
+        }
+    }, [this, generation](const TaskResult &result) {
+        if (generation == m_streamGeneration) {
+            onStreamFinished(result);
+        }
+    }, 0);
+}
+
+void GuestServerClient::onStreamData(const QByteArray &chunk)
+{
+    m_streamWatchdog->start();
+    m_streamBuffer.append(chunk);
+
+    // One JSON sample per line
+    const QUrl url(m_baseUrl + "/metrics/stream");
+    int start = 0;
+    int end;
+    while ((end = m_streamBuffer.indexOf('\n', start)) >= 0) {
+        const QByteArray line = m_streamBuffer.mid(start, end - start).trimmed();
+        start = end + 1;
+        if (line.isEmpty()) {
+            continue;
+        }
+        StreamError failure;
+        if (JsonCodec::decode(line, failure) && !failure.error.isEmpty()) {
+            emit connectionError(failure.error);
+        } else if (applyMetrics(line, url)) {
+            m_backoffMs = kInitialBackoffMs;
+        }
+    }
+    m_streamBuffer.remove(0, start);
+
+    if (m_streamBuffer.size() > kMaxStreamLineBytes && m_stream) {
+        qWarning() << "Metrics stream line too long, reconnecting";
+        m_stream->cancel();
+    }
+}
+
+void GuestServerClient::onStreamFinished(const TaskResult &result)
+{
+    m_stream.clear();
+    m_streamWatchdog->stop();
+    m_streamBuffer.clear();
+    if (!m_isMonitoring) {
+        return;
+    }
+
+    // An HTTP error means this guest cannot stream after all
+    if (result.exitCode >= 400) {
+        qDebug() << "Metrics stream refused with HTTP" << result.exitCode << "- polling instead";
+        m_streamUnsupported = true;
+        fetchMetrics();
+        return;
+    }
+    if (!result.ok() && result.status != TaskResult::Canceled) {
+        emit connectionError(result.errorString);
+    }
+
+    qDebug() << "Metrics stream ended, reconnecting in" << m_backoffMs << "ms";
+    m_reconnectTimer->start(m_backoffMs);
+    m_backoffMs = qMin(m_backoffMs * 2, kMaxBackoffMs);
+}
+
+void GuestServerClient::closeStream()
+{
+    // Results of the old stream are ignored from here on
+    ++m_streamGeneration;
+    m_streamWatchdog->stop();
+    m_streamBuffer.clear();
+    if (m_stream) {
+        m_stream->cancel();
+    }
+    m_stream.clear();
 }
@@ -2,31 +2,58 @@
 #define GUESTSERVERCLIENT_H
 
 #include <QObject>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
+#include <QDateTime>
+#include <QPointer>
 #include <QTimer>
+#include "jsoncodec.h"
+
+class AsyncTask;
+struct TaskResult;
 
 struct GuestServerMetrics {
-    struct {
+    struct Cpu {
         double usage;      // CPU usage percentage
         quint64 frequency; // CPU frequency in MHz
-    } cpu;
-    
-    struct {
-        quint64 used;      // Used RAM in MB
-        quint64 total;     // Total RAM in MB
-        double percentage; // RAM usage percentage
-    } ram;
-    
-    struct {
-        quint64 used;      // Used disk space in MB
-        quint64 total;     // Total disk space in MB
-        double percentage; // Disk usage percentage
-    } disk;
+    };
+
+    // RAM or disk space
+    struct Usage {
+        quint64 used;      // Used space in MB
+        quint64 total;     // Total space in MB
+        double percentage; // Usage percentage
+    };
+
+    Cpu cpu;
+    Usage ram;
+    Usage disk;
     
     QDateTime lastUpdated; // When the metrics were last updated
 };
 
+// The guest's /metrics response; lastUpdated is set on arrival
+template <>
+struct JsonCodec::Schema<GuestServerMetrics::Cpu> {
+    static constexpr auto fields = std::make_tuple(
+        JsonCodec::field("usage", &GuestServerMetrics::Cpu::usage),
+        JsonCodec::field("frequency", &GuestServerMetrics::Cpu::frequency));
+};
+
+template <>
+struct JsonCodec::Schema<GuestServerMetrics::Usage> {
+    static constexpr auto fields = std::make_tuple(
+        JsonCodec::field("used", &GuestServerMetrics::Usage::used),
+        JsonCodec::field("total", &GuestServerMetrics::Usage::total),
+        JsonCodec::field("percentage", &GuestServerMetrics::Usage::percentage));
+};
+
+template <>
+struct JsonCodec::Schema<GuestServerMetrics> {
+    static constexpr auto fields = std::make_tuple(
+        JsonCodec::field("cpu", &GuestServerMetrics::cpu),
+        JsonCodec::field("ram", &GuestServerMetrics::ram),
+        JsonCodec::field("disk", &GuestServerMetrics::disk));
+};
+
 class GuestServerClient : public QObject
 {
     Q_OBJECT
@@ -40,6 +67,9 @@ public:
     void setServerEndpoint(const QString &host, quint16 port, const QString &authKey = QString());
     bool isMonitoring() const { return m_isMonitoring; }
     int intervalMs() const { return m_intervalMs; }
+    // Samples are pushed over one long-lived stream by guests that offer it
+    // and polled every intervalMs() from the others
+    bool isStreaming() const { return !m_stream.isNull(); }
     
     GuestServerMetrics currentMetrics() const;
     
@@ -49,16 +79,29 @@ signals:
     
 private slots:
     void fetchMetrics();
-    void onMetricsReply(QNetworkReply *reply);
     
 private:
-    QNetworkAccessManager *m_networkManager;
+    void onMetricsReply(const TaskResult &result);
+    bool applyMetrics(const QByteArray &data, const QUrl &url);
+    void openStream();
+    void onStreamData(const QByteArray &chunk);
+    void onStreamFinished(const TaskResult &result);
+    void closeStream();
+
     QTimer *m_timer;
     QString m_baseUrl;
     QString m_authKey;
     GuestServerMetrics m_currentMetrics;
     bool m_isMonitoring;
+    bool m_requestInFlight;
     int m_intervalMs;
+    QPointer<AsyncTask> m_stream;
+    QByteArray m_streamBuffer;      // Unfinished line
+    QTimer *m_streamWatchdog;       // Fires if the guest goes quiet
+    QTimer *m_reconnectTimer;
+    int m_backoffMs;
+    bool m_streamUnsupported;       // Guest refused the stream; poll instead
+    quint64 m_streamGeneration;
 };
 
 #endif // GUESTSERVERCLIENT_H
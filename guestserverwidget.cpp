@@ -1,10 +1,34 @@
 #include "guestserverwidget.h"
+#include "framecoalescer.h"
+#include "theme.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFormLayout>
 #include <QDateTime>
 #include <QStyle>
 
+namespace {
+// Setters that leave unchanged widgets alone, so they are not re-laid out or
+// repainted for a sample that looks the same
+bool setText(QLabel *label, const QString &text)
+{
+    if (label->text() == text) {
+        return false;
+    }
+    label->setText(text);
+    return true;
+}
+
+bool setValue(QProgressBar *bar, int value)
+{
+    if (bar->value() == value) {
+        return false;
+    }
+    bar->setValue(value);
+    return true;
+}
+} // namespace
+
 GuestServerWidget::GuestServerWidget(const QString &host, quint16 port, const QString &authKey, QWidget *parent)
     : QWidget(parent)
     , m_client(new GuestServerClient(host, port, authKey, this))
@@ -40,7 +64,7 @@ void GuestServerWidget::startMonitoring(int intervalMs)
 
     if (!m_endpointConfigured) {
         m_statusLabel->setText(tr("Status: Waiting for VM IP"));
-        m_statusLabel->setStyleSheet("color: #f39c12;");
+        Theme::setStatus(m_statusLabel, Theme::Busy);
         return;
     }
 
@@ -48,7 +72,7 @@ void GuestServerWidget::startMonitoring(int intervalMs)
         m_client->startMonitoring(m_monitorIntervalMs);
     }
     m_statusLabel->setText(tr("Status: Monitoring..."));
-    m_statusLabel->setStyleSheet("color: #27ae60;"); // Green
+    Theme::setStatus(m_statusLabel, Theme::Ok);
 }
 
 void GuestServerWidget::stopMonitoring()
@@ -56,7 +80,7 @@ void GuestServerWidget::stopMonitoring()
     m_client->stopMonitoring();
     m_shouldAutoStart = false;
     m_statusLabel->setText(tr("Status: Stopped"));
-    m_statusLabel->setStyleSheet("color: #7f8c8d;"); // Gray
+    Theme::setStatus(m_statusLabel, Theme::Neutral);
 }
 
 void GuestServerWidget::configureServer(const QString &host, quint16 port, const QString &authKey)
@@ -68,15 +92,15 @@ void GuestServerWidget::configureServer(const QString &host, quint16 port, const
     if (!hasEndpoint) {
         m_client->stopMonitoring();
         m_statusLabel->setText(tr("Status: Waiting for VM IP"));
-        m_statusLabel->setStyleSheet("color: #f39c12;");
+        Theme::setStatus(m_statusLabel, Theme::Busy);
     } else {
         if (m_shouldAutoStart) {
             m_client->startMonitoring(m_monitorIntervalMs);
             m_statusLabel->setText(tr("Status: Monitoring..."));
-            m_statusLabel->setStyleSheet("color: #27ae60;");
+            Theme::setStatus(m_statusLabel, Theme::Ok);
         } else {
             m_statusLabel->setText(tr("Status: Ready"));
-            m_statusLabel->setStyleSheet("color: #2980b9;");
+            Theme::setStatus(m_statusLabel, Theme::Info);
         }
     }
 }
@@ -88,14 +112,17 @@ bool GuestServerWidget::isMonitoring() const
 
 void GuestServerWidget::updateMetrics(const GuestServerMetrics &metrics)
 {
+    // Samples arriving within a frame are shown once, as the latest one
     m_currentMetrics = metrics;
-    updateMetricsDisplay();
+    FrameCoalescer::shared()->post(this, QStringLiteral("metrics"), [this]() {
+        return updateMetricsDisplay();
+    });
 }
 
 void GuestServerWidget::onConnectionError(const QString &error)
 {
     m_statusLabel->setText(tr("Error: %1").arg(error));
-    m_statusLabel->setStyleSheet("color: #e74c3c;"); // Red
+    Theme::setStatus(m_statusLabel, Theme::Error);
 }
 
 void GuestServerWidget::setupUI()
@@ -158,34 +185,40 @@ void GuestServerWidget::setupUI()
     mainLayout->addLayout(formLayout);
     mainLayout->addStretch();
     
-    // Style
-    setStyleSheet(
-        "QLabel { color: #2c3e50; }"
-        "QProgressBar { height: 20px; text-align: center; }"
-        "QProgressBar::chunk { background-color: #3498db; }"
-    );
+    // Colors come from the palette, so status changes never re-polish
+    QPalette colors = palette();
+    colors.setColor(QPalette::WindowText, Theme::color(Theme::Text));
+    colors.setColor(QPalette::Highlight, Theme::color(Theme::Progress));
+    setPalette(colors);
+    for (QProgressBar *bar : {m_cpuUsage, m_ramUsage, m_diskUsage}) {
+        bar->setMinimumHeight(20);
+        bar->setAlignment(Qt::AlignCenter);
+    }
 }
 
-void GuestServerWidget::updateMetricsDisplay()
+bool GuestServerWidget::updateMetricsDisplay()
 {
+    bool changed = false;
+
     // Update CPU
-    m_cpuUsage->setValue(static_cast<int>(m_currentMetrics.cpu.usage));
-    m_cpuFreqLabel->setText(tr("Frequency: %1 MHz").arg(m_currentMetrics.cpu.frequency));
+    changed |= setValue(m_cpuUsage, static_cast<int>(m_currentMetrics.cpu.usage));
+    changed |= setText(m_cpuFreqLabel, tr("Frequency: %1 MHz").arg(m_currentMetrics.cpu.frequency));
     
     // Update RAM
-    m_ramUsage->setValue(static_cast<int>(m_currentMetrics.ram.percentage));
-    m_ramUsageLabel->setText(
+    changed |= setValue(m_ramUsage, static_cast<int>(m_currentMetrics.ram.percentage));
+    changed |= setText(m_ramUsageLabel,
         tr("Used: %1 MB / %2 MB").arg(m_currentMetrics.ram.used).arg(m_currentMetrics.ram.total)
     );
     
     // Update Disk
-    m_diskUsage->setValue(static_cast<int>(m_currentMetrics.disk.percentage));
-    m_diskUsageLabel->setText(
+    changed |= setValue(m_diskUsage, static_cast<int>(m_currentMetrics.disk.percentage));
+    changed |= setText(m_diskUsageLabel,
         tr("Used: %1 MB / %2 MB").arg(m_currentMetrics.disk.used).arg(m_currentMetrics.disk.total)
     );
     
     // Update last updated time
-    m_lastUpdatedLabel->setText(
+    changed |= setText(m_lastUpdatedLabel,
         tr("Last updated: %1").arg(m_currentMetrics.lastUpdated.toString("hh:mm:ss"))
     );
+    return changed;
 }
@@ -26,7 +26,8 @@ private slots:
     
 private:
     void setupUI();
-    void updateMetricsDisplay();
+    // Returns whether any widget changed
+    bool updateMetricsDisplay();
     
     GuestServerClient *m_client;
     
@@ -0,0 +1,126 @@
+#include "icondecoder.h"
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QThread>
+#include <QDebug>
+
+namespace {
+constexpr int kMaxDecodeThreads = 2;
+
+class DecodeJob : public QRunnable
+{
+public:
+    explicit DecodeJob(std::function<void()> func) : m_func(std::move(func)) {}
+    void run() override { m_func(); }
+
+private:
+    std::function<void()> m_func;
+};
+} // namespace
+
+IconDecoder::IconDecoder(QObject *parent)
+    : QObject(parent)
+    , m_results(nullptr)
+    , m_generation(0)
+    , m_nextTicket(0)
+{
+    // Leave the rest of the machine to the GUI and the TaskQueues
+    m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, kMaxDecodeThreads));
+}
+
+IconDecoder::~IconDecoder()
+{
+    cancelAll();
+    m_pool.waitForDone();
+    Result *result = m_results.exchange(nullptr);
+    while (result) {
+        Result *next = result->next;
+        delete result;
+        result = next;
+    }
+}
+
+void IconDecoder::decode(const QByteArray &encoded, int size, qreal devicePixelRatio, QObject *context, Done done)
+{
+    const quint64 ticket = ++m_nextTicket;
+    const quint64 generation = m_generation.load();
+    m_pending.insert(ticket, Pending{context, std::move(done)});
+
+    m_pool.start(new DecodeJob([this, ticket, generation, encoded, size, devicePixelRatio]() {
+        if (m_generation.load() != generation) {
+            return;
+        }
+        QElapsedTimer elapsed;
+        elapsed.start();
+
+        Result *result = new Result;
+        result->ticket = ticket;
+        result->hash = QCryptographicHash::hash(encoded, QCryptographicHash::Sha1).toHex();
+        QImage image;
+        if (image.loadFromData(encoded)) {
+            const int pixels = qRound(size * devicePixelRatio);
+            if (image.width() > pixels || image.height() > pixels) {
+                image = image.scaled(pixels, pixels, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            }
+            image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            image.setDevicePixelRatio(devicePixelRatio);
+            result->image = image;
+        }
+        result->elapsedMs = elapsed.nsecsElapsed() / 1.0e6;
+        push(result);
+    }));
+}
+
+void IconDecoder::cancelAll()
+{
+    ++m_generation;
+    m_pool.clear();
+    m_stats.canceled += m_pending.size();
+    m_pending.clear();
+}
+
+void IconDecoder::push(Result *result)
+{
+    // Treiber stack: the consumer takes the whole list at once, so there is
+    // no ABA problem. Only the push onto an empty stack schedules a drain.
+    Result *head = m_results.load(std::memory_order_relaxed);
+    do {
+        result->next = head;
+    } while (!m_results.compare_exchange_weak(head, result, std::memory_order_release,
+                                              std::memory_order_relaxed));
+    if (!head) {
+        QMetaObject::invokeMethod(this, &IconDecoder::drain, Qt::QueuedConnection);
+    }
+}
+
+void IconDecoder::drain()
+{
+    Result *list = m_results.exchange(nullptr, std::memory_order_acquire);
+
+    // Oldest first
+    Result *ordered = nullptr;
+    while (list) {
+        Result *next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    while (ordered) {
+        Result *result = ordered;
+        ordered = ordered->next;
+
+        m_stats.busyMs += result->elapsedMs;
+        const Pending pending = m_pending.take(result->ticket);
+        if (pending.done && pending.context) {
+            if (result->image.isNull()) {
+                ++m_stats.failed;
+            } else {
+                ++m_stats.decoded;
+            }
+            pending.done(result->image, result->hash);
+        }
+        delete result;
+    }
+}
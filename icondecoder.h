@@ -0,0 +1,70 @@
+#ifndef ICONDECODER_H
+#define ICONDECODER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QPointer>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
+
+// Decodes and scales icon data on a small worker pool, off the GUI thread.
+// Workers push finished thumbnails onto a lock-free stack; the GUI thread
+// drains it in one queued call per burst and runs the callbacks there.
+// cancelAll() drops queued jobs and the results of running ones, e.g. when
+// the catalog being shown changes.
+class IconDecoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // image is null if the data could not be decoded; hash is the SHA-1 (hex)
+    // of the encoded data
+    using Done = std::function<void(const QImage &image, const QByteArray &hash)>;
+
+    struct Stats {
+        quint64 decoded = 0;
+        quint64 failed = 0;
+        quint64 canceled = 0;
+        double busyMs = 0;      // Summed over all workers
+    };
+
+    explicit IconDecoder(QObject *parent = nullptr);
+    ~IconDecoder();
+
+    // Scales to fit size x size device-independent pixels at devicePixelRatio.
+    // done runs on this thread unless context is destroyed or the job canceled.
+    void decode(const QByteArray &encoded, int size, qreal devicePixelRatio, QObject *context, Done done);
+
+    void cancelAll();
+
+    int pendingCount() const { return m_pending.size(); }
+    Stats stats() const { return m_stats; }
+
+private:
+    struct Result {
+        quint64 ticket = 0;
+        QImage image;
+        QByteArray hash;
+        double elapsedMs = 0;
+        Result *next = nullptr;
+    };
+    struct Pending {
+        QPointer<QObject> context;
+        Done done;
+    };
+
+    void push(Result *result);
+    void drain();
+
+    QThreadPool m_pool;
+    std::atomic<Result *> m_results;
+    std::atomic<quint64> m_generation;
+    QHash<quint64, Pending> m_pending;
+    quint64 m_nextTicket;
+    Stats m_stats;
+};
+
+#endif // ICONDECODER_H
@@ -0,0 +1,419 @@
+#include "iconstore.h"
+#include "asynctask.h"
+#include "icondecoder.h"
+#include "writebehind.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPixmapCache>
+#include <QPointer>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QDebug>
+#include <utility>
+
+namespace {
+constexpr quint32 kBlobMagic = 0x57524932; // "WRI2"
+// Blobs are stored at the device pixel ratio they were decoded for
+constexpr int kMaxBlobScale = 4;
+constexpr int kPixmapCacheKb = 32 * 1024;
+// Decoded icons kept for image(); a 128x128 icon is 64 KB
+constexpr int kImageCacheKb = 8 * 1024;
+// 3: blobs carry their scale ("WRI2"). Older indexes are ignored, so the
+// blobs they name are pruned instead of failing to load forever.
+constexpr int kIndexVersion = 3;
+// Blob reads for painting; a few in parallel keep a scrolled page short
+constexpr int kMaxBlobLoads = 2;
+constexpr int kBlobLoadDeadlineMs = 10000;
+const char kBlobSuffix[] = ".icon";
+} // namespace
+
+IconStore::IconStore(const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_decoder(new IconDecoder(this))
+    , m_loads(new TaskQueue(kMaxBlobLoads, this))
+    , m_directory(directory)
+    , m_images(kImageCacheKb)
+{
+    // Room for a few hundred high-DPI icons next to everything else
+    QPixmapCache::setCacheLimit(qMax(QPixmapCache::cacheLimit(), kPixmapCacheKb));
+    QDir().mkpath(m_directory);
+    loadIndex();
+    prune();
+}
+
+IconStore::~IconStore()
+{
+}
+
+IconStore *IconStore::shared()
+{
+    static QPointer<IconStore> instance;
+    if (!instance) {
+        const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        instance = new IconStore(cacheDir + "/icons", QCoreApplication::instance());
+    }
+    return instance;
+}
+
+QString IconStore::indexKey(const QString &catalog, const QString &iconPath)
+{
+    // Neither UUIDs nor Windows paths contain a newline
+    return catalog + '\n' + iconPath;
+}
+
+bool IconStore::contains(const QString &catalog, const QString &iconPath) const
+{
+    return m_index.contains(indexKey(catalog, iconPath));
+}
+
+QString IconStore::stamp(const QString &catalog, const QString &iconPath) const
+{
+    return m_index.value(indexKey(catalog, iconPath)).stamp;
+}
+
+bool IconStore::isCurrent(const QString &catalog, const QString &iconPath, const QString &stamp) const
+{
+    auto it = m_index.constFind(indexKey(catalog, iconPath));
+    return !stamp.isEmpty() && it != m_index.constEnd() && it->stamp == stamp;
+}
+
+QImage IconStore::image(const QString &catalog, const QString &iconPath)
+{
+    const QString key = indexKey(catalog, iconPath);
+    const QByteArray hash = m_index.value(key).hash;
+    if (hash.isEmpty()) {
+        return QImage();
+    }
+
+    const QImage cached = cachedImage(hash);
+    if (!cached.isNull()) {
+        return cached;
+    }
+    const QImage image = readBlob(blobPath(hash));
+    if (image.isNull()) {
+        forgetBlob(key, hash);
+        return QImage();
+    }
+    cacheImage(hash, image);
+    return image;
+}
+
+QPixmap IconStore::pixmap(const QString &catalog, const QString &iconPath)
+{
+    const QByteArray hash = m_index.value(indexKey(catalog, iconPath)).hash;
+    if (hash.isEmpty()) {
+        return QPixmap();
+    }
+
+    QPixmap pixmap;
+    if (!QPixmapCache::find(pixmapKey(hash), &pixmap)) {
+        pixmap = QPixmap::fromImage(image(catalog, iconPath));
+        if (!pixmap.isNull()) {
+            QPixmapCache::insert(pixmapKey(hash), pixmap);
+        }
+    }
+    return pixmap;
+}
+
+QPixmap IconStore::pixmapIfLoaded(const QString &catalog, const QString &iconPath)
+{
+    const QString key = indexKey(catalog, iconPath);
+    const QByteArray hash = m_index.value(key).hash;
+    if (hash.isEmpty()) {
+        return QPixmap();
+    }
+
+    QPixmap pixmap;
+    if (QPixmapCache::find(pixmapKey(hash), &pixmap)) {
+        return pixmap;
+    }
+    const QImage cached = cachedImage(hash);
+    if (cached.isNull()) {
+        loadBlob(hash, key);
+        return QPixmap();
+    }
+    pixmap = QPixmap::fromImage(cached);
+    QPixmapCache::insert(pixmapKey(hash), pixmap);
+    return pixmap;
+}
+
+void IconStore::store(const QString &catalog, const QString &iconPath, const QString &stamp,
+                      const QByteArray &encoded, QObject *context, Stored done)
+{
+    if (iconPath.isEmpty()) {
+        return;
+    }
+    if (encoded.isEmpty()) {
+        record(catalog, iconPath, stamp, QByteArray());
+        done(QImage());
+        return;
+    }
+
+    const qreal devicePixelRatio = qGuiApp ? qGuiApp->devicePixelRatio() : 1.0;
+    QPointer<QObject> guard(context);
+    m_decoder->decode(encoded, kIconSize, devicePixelRatio, this,
+                      [this, catalog, iconPath, stamp, guard, done](const QImage &decoded, const QByteArray &hash) {
+        QImage image = decoded;
+        if (image.isNull()) {
+            qDebug() << "Undecodable icon data for:" << iconPath;
+            record(catalog, iconPath, stamp, QByteArray());
+        } else {
+            const QImage cached = cachedImage(hash);
+            if (!cached.isNull()) {
+                image = cached;
+            } else {
+                // Identical icons (shared launchers, default icons) share a
+                // blob. It is written in the background; until the write is
+                // under way it is served from m_unwritten.
+                const QString filePath = blobPath(hash);
+                if (!QFile::exists(filePath)) {
+                    m_unwritten.insert(hash, image);
+                    QPointer<IconStore> self(this);
+                    WriteBehind::shared()->schedule(filePath, nullptr,
+                                                    [self, filePath, hash, image]() -> WriteBehind::Write {
+                        if (self) {
+                            // Freshly cached, so it stays in memory while written
+                            self->m_unwritten.remove(hash);
+                            self->cacheImage(hash, image);
+                        }
+                        return [filePath, image]() { return writeBlob(filePath, image); };
+                    });
+                }
+                cacheImage(hash, image);
+            }
+            record(catalog, iconPath, stamp, hash);
+        }
+        if (guard) {
+            done(image);
+        }
+    });
+}
+
+void IconStore::cancelDecodes()
+{
+    m_decoder->cancelAll();
+}
+
+void IconStore::record(const QString &catalog, const QString &iconPath, const QString &stamp,
+                       const QByteArray &hash)
+{
+    const QString key = indexKey(catalog, iconPath);
+    auto it = m_index.constFind(key);
+    if (it == m_index.constEnd() || it->hash != hash || it->stamp != stamp) {
+        Entry entry;
+        entry.hash = hash;
+        entry.stamp = stamp;
+        m_index.insert(key, entry);
+        scheduleSave();
+    }
+}
+
+QByteArray IconStore::indexJson() const
+{
+    // { "catalogs": { catalog: { path: { hash, stamp } } } }
+    QHash<QString, QJsonObject> catalogs;
+    for (auto it = m_index.constBegin(); it != m_index.constEnd(); ++it) {
+        const int split = it.key().indexOf('\n');
+        QJsonObject entry;
+        entry["hash"] = QString::fromLatin1(it->hash);
+        entry["stamp"] = it->stamp;
+        catalogs[it.key().left(split)][it.key().mid(split + 1)] = entry;
+    }
+    QJsonObject catalogsObj;
+    for (auto it = catalogs.constBegin(); it != catalogs.constEnd(); ++it) {
+        catalogsObj[it.key()] = it.value();
+    }
+    QJsonObject root;
+    root["version"] = kIndexVersion;
+    root["catalogs"] = catalogsObj;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QImage IconStore::cachedImage(const QByteArray &hash) const
+{
+    auto unwritten = m_unwritten.constFind(hash);
+    if (unwritten != m_unwritten.constEnd()) {
+        return *unwritten;
+    }
+    const QImage *image = m_images.object(hash);
+    return image ? *image : QImage();
+}
+
+void IconStore::cacheImage(const QByteArray &hash, const QImage &image)
+{
+    m_images.insert(hash, new QImage(image), qMax(1, int(image.sizeInBytes() / 1024)));
+}
+
+void IconStore::loadBlob(const QByteArray &hash, const QString &key)
+{
+    // Paths sharing a blob wait for the same read
+    auto waiting = m_loading.find(hash);
+    if (waiting != m_loading.end()) {
+        if (!waiting->contains(key)) {
+            waiting->append(key);
+        }
+        return;
+    }
+    m_loading.insert(hash, {key});
+
+    const QString filePath = blobPath(hash);
+    m_loads->run([filePath]() {
+        return QVariant::fromValue(readBlob(filePath));
+    }, kBlobLoadDeadlineMs)->then(this, [this, hash](const TaskResult &result) {
+        const QStringList keys = m_loading.take(hash);
+        QImage image = cachedImage(hash);
+        if (image.isNull()) {
+            image = result.value.value<QImage>();
+        }
+        if (!image.isNull()) {
+            cacheImage(hash, image);
+        }
+        for (const QString &key : keys) {
+            // Only a blob that was read and found damaged is dropped; a read
+            // that timed out is simply asked for again on the next paint
+            if (image.isNull() && result.ok() && m_index.value(key).hash == hash) {
+                forgetBlob(key, hash);
+            }
+            const int split = key.indexOf('\n');
+            emit iconLoaded(key.left(split), key.mid(split + 1), image);
+        }
+    });
+}
+
+void IconStore::forgetBlob(const QString &key, const QByteArray &hash)
+{
+    // Blob lost or damaged; forget the entry so the icon is fetched again,
+    // and the file so store() writes it anew
+    qWarning() << "Dropping unreadable icon blob:" << blobPath(hash);
+    QFile::remove(blobPath(hash));
+    m_index.remove(key);
+    scheduleSave();
+}
+
+QString IconStore::pixmapKey(const QByteArray &hash)
+{
+    return QStringLiteral("winrun-icon:") + QString::fromLatin1(hash);
+}
+
+QString IconStore::blobPath(const QByteArray &hash) const
+{
+    return m_directory + '/' + QString::fromLatin1(hash) + kBlobSuffix;
+}
+
+QImage IconStore::readBlob(const QString &filePath)
+{
+    // Runs on blob loading workers too, so it only touches the file
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QImage();
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 width = 0;
+    quint32 height = 0;
+    quint32 scalePercent = 0;
+    in >> magic >> width >> height >> scalePercent;
+    const quint32 maxSide = kIconSize * kMaxBlobScale;
+    if (in.status() != QDataStream::Ok || magic != kBlobMagic
+        || width == 0 || height == 0 || width > maxSide || height > maxSide
+        || scalePercent < 100 || scalePercent > 100 * kMaxBlobScale) {
+        return QImage();
+    }
+
+    QImage image(static_cast<int>(width), static_cast<int>(height), QImage::Format_ARGB32_Premultiplied);
+    const int rowBytes = image.width() * 4;
+    for (int y = 0; y < image.height(); ++y) {
+        if (in.readRawData(reinterpret_cast<char *>(image.scanLine(y)), rowBytes) != rowBytes) {
+            return QImage();
+        }
+    }
+    image.setDevicePixelRatio(scalePercent / 100.0);
+    return image;
+}
+
+bool IconStore::writeBlob(const QString &filePath, const QImage &image)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    // Raw premultiplied pixels: loading is a plain read, no image decoding
+    QDataStream out(&file);
+    out << kBlobMagic << quint32(image.width()) << quint32(image.height())
+        << quint32(qRound(image.devicePixelRatio() * 100));
+    const int rowBytes = image.width() * 4;
+    for (int y = 0; y < image.height(); ++y) {
+        out.writeRawData(reinterpret_cast<const char *>(image.constScanLine(y)), rowBytes);
+    }
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+void IconStore::loadIndex()
+{
+    QFile file(m_directory + "/index.json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root["version"].toInt() != kIndexVersion) {
+        qDebug() << "Ignoring icon index with unknown version:" << file.fileName();
+        return;
+    }
+    const QJsonObject catalogs = root["catalogs"].toObject();
+    for (auto catalog = catalogs.constBegin(); catalog != catalogs.constEnd(); ++catalog) {
+        const QJsonObject icons = catalog.value().toObject();
+        for (auto it = icons.constBegin(); it != icons.constEnd(); ++it) {
+            const QJsonObject value = it.value().toObject();
+            Entry entry;
+            entry.hash = value["hash"].toString().toLatin1();
+            entry.stamp = value["stamp"].toString();
+            m_index.insert(indexKey(catalog.key(), it.key()), entry);
+        }
+    }
+    qDebug() << "Icon index loaded:" << m_index.size() << "paths";
+}
+
+void IconStore::prune()
+{
+    // Blobs no path refers to any more (icon changed or app removed)
+    QSet<QString> referenced;
+    for (const Entry &entry : std::as_const(m_index)) {
+        if (!entry.hash.isEmpty()) {
+            referenced.insert(QString::fromLatin1(entry.hash) + kBlobSuffix);
+        }
+    }
+    QDir dir(m_directory);
+    const QStringList blobs = dir.entryList({QStringLiteral("*") + kBlobSuffix}, QDir::Files);
+    for (const QString &blob : blobs) {
+        if (!referenced.contains(blob)) {
+            dir.remove(blob);
+        }
+    }
+}
+
+void IconStore::scheduleSave()
+{
+    // Icons arrive in bursts; the index is serialized once per write batch
+    const QString filePath = m_directory + "/index.json";
+    WriteBehind::shared()->schedule(filePath, this, [this, filePath]() -> WriteBehind::Write {
+        const QByteArray json = indexJson();
+        return [filePath, json]() {
+            QSaveFile file(filePath);
+            if (!file.open(QIODevice::WriteOnly)) {
+                return false;
+            }
+            file.write(json);
+            return file.commit();
+        };
+    });
+}
@@ -0,0 +1,105 @@
+#ifndef ICONSTORE_H
+#define ICONSTORE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+class IconDecoder;
+class TaskQueue;
+
+// Persistent app icon store. Icons are kept decoded and scaled to display
+// size in content-addressed blobs (one per distinct icon, shared by all VMs),
+// with an index mapping each guest icon path to its blob and the stamp the
+// guest reported for it. Paths are namespaced by catalog (the VM's domain
+// UUID), since the same path can hold different programs on different guests.
+// An icon whose stamp still matches is shown straight from disk and never
+// downloaded again; the index also remembers paths without an icon.
+// Decoding and scaling run on the IconDecoder's workers, and painted icons
+// are shared through QPixmapCache. Decoded images are kept in a small LRU
+// cache with a byte budget. For painting, pixmapIfLoaded() never reads from
+// disk on the calling thread; blobs not in memory are loaded in the
+// background and announced by iconLoaded().
+class IconStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kIconSize = 64;
+
+    using Stored = std::function<void(const QImage &icon)>;
+
+    explicit IconStore(const QString &directory, QObject *parent = nullptr);
+    ~IconStore();
+
+    // Process-wide instance in the application cache directory
+    static IconStore *shared();
+
+    bool contains(const QString &catalog, const QString &iconPath) const;
+    QString stamp(const QString &catalog, const QString &iconPath) const;
+    // True if the entry was stored under this (non-empty) stamp
+    bool isCurrent(const QString &catalog, const QString &iconPath, const QString &stamp) const;
+
+    // Display-sized icon, or a null image if none is stored
+    QImage image(const QString &catalog, const QString &iconPath);
+    // Same, as a pixmap from the shared QPixmapCache
+    QPixmap pixmap(const QString &catalog, const QString &iconPath);
+    // Same, but a null pixmap while the blob is read in the background
+    QPixmap pixmapIfLoaded(const QString &catalog, const QString &iconPath);
+
+    // Decodes and scales encoded (PNG/ICO/...) data in the background and
+    // stores it under stamp, then calls done on this thread unless context is
+    // destroyed first. Empty or undecodable data records that the path has
+    // no icon and yields a null image.
+    void store(const QString &catalog, const QString &iconPath, const QString &stamp,
+               const QByteArray &encoded, QObject *context, Stored done);
+
+    // Drops decodes not yet delivered, e.g. when another catalog is shown
+    void cancelDecodes();
+
+    IconDecoder *decoder() const { return m_decoder; }
+
+signals:
+    // A blob asked for by pixmapIfLoaded() is in memory; icon is null if it
+    // turned out unreadable
+    void iconLoaded(const QString &catalog, const QString &iconPath, const QImage &icon);
+
+private:
+    struct Entry {
+        QByteArray hash;    // Empty: the guest has no icon for this path
+        QString stamp;
+    };
+
+    static QString indexKey(const QString &catalog, const QString &iconPath);
+    static QString pixmapKey(const QByteArray &hash);
+
+    QImage cachedImage(const QByteArray &hash) const;
+    void cacheImage(const QByteArray &hash, const QImage &image);
+    void loadBlob(const QByteArray &hash, const QString &key);
+    void forgetBlob(const QString &key, const QByteArray &hash);
+
+    void record(const QString &catalog, const QString &iconPath, const QString &stamp, const QByteArray &hash);
+    QString blobPath(const QByteArray &hash) const;
+    static QImage readBlob(const QString &filePath);
+    static bool writeBlob(const QString &filePath, const QImage &image);
+    QByteArray indexJson() const;
+    void loadIndex();
+    void prune();
+    void scheduleSave();
+
+    IconDecoder *m_decoder;
+    TaskQueue *m_loads;
+    QString m_directory;
+    QHash<QString, Entry> m_index;      // By indexKey()
+    QCache<QByteArray, QImage> m_images;   // Cost in KB
+    QHash<QByteArray, QImage> m_unwritten;  // Blobs not yet handed to WriteBehind
+    QHash<QByteArray, QStringList> m_loading;   // Blobs being read -> index keys waiting
+};
+
+#endif // ICONSTORE_H
@@ -0,0 +1,411 @@
+#include "jsoncodec.h"
+#include <cmath>
+#include <limits>
+
+namespace JsonCodec {
+
+namespace {
+bool isNumberChar(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Plain digits fit the fast path; fractions and exponents go through double
+bool parseUnsigned(const char *begin, int length, quint64 &value)
+{
+    if (length == 0 || length > 19) {
+        return false;
+    }
+    quint64 result = 0;
+    for (int i = 0; i < length; ++i) {
+        if (begin[i] < '0' || begin[i] > '9') {
+            return false;
+        }
+        result = result * 10 + quint64(begin[i] - '0');
+    }
+    value = result;
+    return true;
+}
+} // namespace
+
+Reader::Reader(const char *begin, const char *end)
+    : m_pos(begin)
+    , m_end(end)
+    , m_failed(false)
+{
+}
+
+Reader::Reader(const QByteArray &data)
+    : Reader(data.constData(), data.constData() + data.size())
+{
+}
+
+void Reader::skipWhitespace()
+{
+    while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t')) {
+        ++m_pos;
+    }
+}
+
+bool Reader::fail()
+{
+    m_failed = true;
+    return false;
+}
+
+bool Reader::atEnd()
+{
+    skipWhitespace();
+    return !m_failed && m_pos == m_end;
+}
+
+bool Reader::consume(char c)
+{
+    skipWhitespace();
+    if (m_failed || m_pos == m_end || *m_pos != c) {
+        return false;
+    }
+    ++m_pos;
+    return true;
+}
+
+bool Reader::readNull()
+{
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == 'n') {
+        return readLiteral("null", 4);
+    }
+    return fail();
+}
+
+bool Reader::readLiteral(const char *literal, int length)
+{
+    if (m_end - m_pos < length || std::memcmp(m_pos, literal, length) != 0) {
+        return fail();
+    }
+    m_pos += length;
+    return true;
+}
+
+bool Reader::readKey(const char *&key, int &length)
+{
+    if (!consume('"')) {
+        return fail();
+    }
+    const char *begin = m_pos;
+    if (!skipString()) {
+        return false;
+    }
+    key = begin;
+    length = int(m_pos - 1 - begin);
+    return consume(':') || fail();
+}
+
+bool Reader::skipString()
+{
+    // m_pos is just past the opening quote
+    while (m_pos < m_end) {
+        const char c = *m_pos++;
+        if (c == '"') {
+            return true;
+        }
+        if (c == '\\') {
+            ++m_pos;
+        }
+    }
+    return fail();
+}
+
+bool Reader::readValue(QString &value)
+{
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == 'n') {
+        value.clear();
+        return readLiteral("null", 4);
+    }
+    if (!consume('"')) {
+        return fail();
+    }
+
+    // Most strings have no escapes and convert in one go
+    const char *run = m_pos;
+    while (m_pos < m_end && *m_pos != '"' && *m_pos != '\\') {
+        ++m_pos;
+    }
+    if (m_pos == m_end) {
+        return fail();
+    }
+    if (*m_pos == '"') {
+        value = QString::fromUtf8(run, int(m_pos - run));
+        ++m_pos;
+        return true;
+    }
+
+    QString result = QString::fromUtf8(run, int(m_pos - run));
+    while (m_pos < m_end) {
+        const char c = *m_pos;
+        if (c == '"') {
+            ++m_pos;
+            value = result;
+            return true;
+        }
+        if (c != '\\') {
+            run = m_pos;
+            while (m_pos < m_end && *m_pos != '"' && *m_pos != '\\') {
+                ++m_pos;
+            }
+            result.append(QString::fromUtf8(run, int(m_pos - run)));
+            continue;
+        }
+        if (m_end - m_pos < 2) {
+            return fail();
+        }
+        const char escape = m_pos[1];
+        m_pos += 2;
+        switch (escape) {
+        case '"': result.append(QLatin1Char('"')); break;
+        case '\\': result.append(QLatin1Char('\\')); break;
+        case '/': result.append(QLatin1Char('/')); break;
+        case 'b': result.append(QLatin1Char('\b')); break;
+        case 'f': result.append(QLatin1Char('\f')); break;
+        case 'n': result.append(QLatin1Char('\n')); break;
+        case 'r': result.append(QLatin1Char('\r')); break;
+        case 't': result.append(QLatin1Char('\t')); break;
+        case 'u': {
+            if (m_end - m_pos < 4) {
+                return fail();
+            }
+            int code = 0;
+            for (int i = 0; i < 4; ++i) {
+                const int digit = hexValue(m_pos[i]);
+                if (digit < 0) {
+                    return fail();
+                }
+                code = code * 16 + digit;
+            }
+            m_pos += 4;
+            // Surrogate pairs come as two escapes and join up in UTF-16
+            result.append(QChar(ushort(code)));
+            break;
+        }
+        default:
+            return fail();
+        }
+    }
+    return fail();
+}
+
+bool Reader::readValue(bool &value)
+{
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == 't') {
+        value = true;
+        return readLiteral("true", 4);
+    }
+    if (m_pos < m_end && *m_pos == 'f') {
+        value = false;
+        return readLiteral("false", 5);
+    }
+    if (m_pos < m_end && *m_pos == 'n') {
+        value = false;
+        return readLiteral("null", 4);
+    }
+    return fail();
+}
+
+bool Reader::readNumber(const char *&begin, int &length)
+{
+    skipWhitespace();
+    begin = m_pos;
+    while (m_pos < m_end && isNumberChar(*m_pos)) {
+        ++m_pos;
+    }
+    length = int(m_pos - begin);
+    return length > 0 || fail();
+}
+
+bool Reader::readValue(double &value)
+{
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == 'n') {
+        value = 0;
+        return readLiteral("null", 4);
+    }
+    const char *begin = nullptr;
+    int length = 0;
+    if (!readNumber(begin, length)) {
+        return false;
+    }
+    quint64 integer = 0;
+    if (parseUnsigned(begin, length, integer)) {
+        value = double(integer);
+        return true;
+    }
+    // Locale independent, and does not copy the digits
+    bool ok = false;
+    value = QByteArray::fromRawData(begin, length).toDouble(&ok);
+    return ok || fail();
+}
+
+bool Reader::readValue(quint64 &value)
+{
+    skipWhitespace();
+    if (m_pos < m_end && *m_pos == 'n') {
+        value = 0;
+        return readLiteral("null", 4);
+    }
+    const char *begin = nullptr;
+    int length = 0;
+    if (!readNumber(begin, length)) {
+        return false;
+    }
+    if (parseUnsigned(begin, length, value)) {
+        return true;
+    }
+    bool ok = false;
+    const double number = QByteArray::fromRawData(begin, length).toDouble(&ok);
+    if (!ok) {
+        return fail();
+    }
+    value = number <= 0 ? 0
+          : number >= double(std::numeric_limits<quint64>::max()) ? std::numeric_limits<quint64>::max()
+          : quint64(number);
+    return true;
+}
+
+bool Reader::readValue(qint64 &value)
+{
+    double number = 0;
+    if (!readValue(number)) {
+        return false;
+    }
+    value = qint64(qBound(double(std::numeric_limits<qint64>::min()), std::trunc(number),
+                          double(std::numeric_limits<qint64>::max())));
+    return true;
+}
+
+bool Reader::readValue(int &value)
+{
+    double number = 0;
+    if (!readValue(number)) {
+        return false;
+    }
+    value = int(qBound(double(std::numeric_limits<int>::min()), std::trunc(number),
+                       double(std::numeric_limits<int>::max())));
+    return true;
+}
+
+bool Reader::skipValue()
+{
+    skipWhitespace();
+    if (m_pos == m_end) {
+        return fail();
+    }
+    switch (*m_pos) {
+    case '"':
+        ++m_pos;
+        return skipString();
+    case '{':
+    case '[': {
+        int depth = 0;
+        while (m_pos < m_end) {
+            const char c = *m_pos++;
+            if (c == '"') {
+                if (!skipString()) {
+                    return false;
+                }
+            } else if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return true;
+            }
+        }
+        return fail();
+    }
+    case 't':
+        return readLiteral("true", 4);
+    case 'f':
+        return readLiteral("false", 5);
+    case 'n':
+        return readLiteral("null", 4);
+    default: {
+        const char *begin = nullptr;
+        int length = 0;
+        return readNumber(begin, length);
+    }
+    }
+}
+
+void writeValue(QByteArray &out, const QString &value)
+{
+    const QByteArray utf8 = value.toUtf8();
+    out.reserve(out.size() + utf8.size() + 2);
+    out.append('"');
+    for (const char c : utf8) {
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\b': out.append("\\b"); break;
+        case '\f': out.append("\\f"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        default:
+            if (uchar(c) < 0x20) {
+                static const char hex[] = "0123456789abcdef";
+                const char escaped[] = {'\\', 'u', '0', '0', hex[uchar(c) >> 4], hex[uchar(c) & 0xf]};
+                out.append(escaped, sizeof(escaped));
+            } else {
+                out.append(c);
+            }
+            break;
+        }
+    }
+    out.append('"');
+}
+
+void writeValue(QByteArray &out, bool value)
+{
+    out.append(value ? "true" : "false");
+}
+
+void writeValue(QByteArray &out, double value)
+{
+    // JSON has no NaN or infinity
+    if (!std::isfinite(value)) {
+        out.append("null");
+        return;
+    }
+    out.append(QByteArray::number(value, 'g', std::numeric_limits<double>::max_digits10));
+}
+
+void writeValue(QByteArray &out, qint64 value)
+{
+    out.append(QByteArray::number(value));
+}
+
+void writeValue(QByteArray &out, quint64 value)
+{
+    out.append(QByteArray::number(value));
+}
+
+void writeValue(QByteArray &out, int value)
+{
+    out.append(QByteArray::number(value));
+}
+
+} // namespace JsonCodec
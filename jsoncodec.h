@@ -0,0 +1,179 @@
+#ifndef JSONCODEC_H
+#define JSONCODEC_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+// Schema-driven JSON codec for plain structs. A struct is described once by
+// specialising JsonCodec::Schema with a tuple of (key, member) pairs:
+//
+//     template <> struct JsonCodec::Schema<Foo> {
+//         static constexpr auto fields = std::make_tuple(
+//             JsonCodec::field("name", &Foo::name),
+//             JsonCodec::field("size", &Foo::size));
+//     };
+//
+// decode() then reads the bytes straight into the struct, without building a
+// QJsonDocument, and encode() writes it back out. Unknown keys are skipped and
+// missing ones leave the member as it was; null reads as an empty string or 0.
+// Members may be QString, bool, double, integers or structs with a Schema.
+namespace JsonCodec {
+
+template <typename T>
+struct Schema {};
+
+template <typename T, typename M>
+struct Field {
+    const char *name;
+    int length;
+    M T::*member;
+};
+
+template <typename T, typename M, std::size_t N>
+constexpr Field<T, M> field(const char (&name)[N], M T::*member)
+{
+    return Field<T, M>{name, int(N - 1), member};
+}
+
+// Pull parser over a byte range. Every read skips leading whitespace and
+// returns false (and marks the reader failed) on malformed input.
+class Reader
+{
+public:
+    Reader(const char *begin, const char *end);
+    explicit Reader(const QByteArray &data);
+
+    bool failed() const { return m_failed; }
+    bool atEnd();
+    // Consumes c if it is the next character
+    bool consume(char c);
+    // Consumes a null if it is the next value
+    bool readNull();
+
+    // Points key at the raw bytes between the quotes and consumes the colon.
+    // Escapes are left as they are; no schema key needs one.
+    bool readKey(const char *&key, int &length);
+    bool readValue(QString &value);
+    bool readValue(bool &value);
+    bool readValue(double &value);
+    bool readValue(qint64 &value);
+    bool readValue(quint64 &value);
+    bool readValue(int &value);
+    bool skipValue();
+
+private:
+    void skipWhitespace();
+    bool fail();
+    bool readLiteral(const char *literal, int length);
+    bool readNumber(const char *&begin, int &length);
+    bool skipString();
+
+    const char *m_pos;
+    const char *m_end;
+    bool m_failed;
+};
+
+void writeValue(QByteArray &out, const QString &value);
+void writeValue(QByteArray &out, bool value);
+void writeValue(QByteArray &out, double value);
+void writeValue(QByteArray &out, qint64 value);
+void writeValue(QByteArray &out, quint64 value);
+void writeValue(QByteArray &out, int value);
+
+template <typename T, typename = void>
+struct HasSchema : std::false_type {};
+
+template <typename T>
+struct HasSchema<T, std::void_t<decltype(Schema<T>::fields)>> : std::true_type {};
+
+template <typename T>
+std::enable_if_t<HasSchema<T>::value, bool> readValue(Reader &reader, T &value);
+
+template <typename T>
+std::enable_if_t<!HasSchema<T>::value, bool> readValue(Reader &reader, T &value)
+{
+    return reader.readValue(value);
+}
+
+template <typename T, typename M>
+bool readField(Reader &reader, T &object, const Field<T, M> &field,
+               const char *key, int length, bool &matched)
+{
+    if (matched || length != field.length || std::memcmp(key, field.name, length) != 0) {
+        return true;
+    }
+    matched = true;
+    return readValue(reader, object.*field.member);
+}
+
+template <typename T>
+std::enable_if_t<HasSchema<T>::value, bool> readValue(Reader &reader, T &value)
+{
+    if (!reader.consume('{')) {
+        // A null object keeps its defaults
+        return reader.readNull();
+    }
+    if (reader.consume('}')) {
+        return true;
+    }
+    do {
+        const char *key = nullptr;
+        int length = 0;
+        if (!reader.readKey(key, length)) {
+            return false;
+        }
+        bool matched = false;
+        const bool ok = std::apply([&](const auto &...fields) {
+            return (readField(reader, value, fields, key, length, matched) && ...);
+        }, Schema<T>::fields);
+        if (!ok || (!matched && !reader.skipValue())) {
+            return false;
+        }
+    } while (reader.consume(','));
+    return reader.consume('}');
+}
+
+template <typename T>
+std::enable_if_t<HasSchema<T>::value> writeValue(QByteArray &out, const T &value)
+{
+    out.append('{');
+    bool first = true;
+    std::apply([&](const auto &...fields) {
+        ((out.append(first ? "\"" : ",\""), first = false,
+          out.append(fields.name, fields.length), out.append("\":"),
+          writeValue(out, value.*fields.member)), ...);
+    }, Schema<T>::fields);
+    out.append('}');
+}
+
+// Reads one JSON value, which must be all of [begin, end) apart from
+// whitespace, into value
+template <typename T>
+bool decode(const char *begin, const char *end, T &value)
+{
+    Reader reader(begin, end);
+    return readValue(reader, value) && reader.atEnd();
+}
+
+template <typename T>
+bool decode(const QByteArray &data, T &value)
+{
+    return decode(data.constData(), data.constData() + data.size(), value);
+}
+
+template <typename T>
+QByteArray encode(const T &value)
+{
+    QByteArray out;
+    writeValue(out, value);
+    return out;
+}
+
+} // namespace JsonCodec
+
+#endif // JSONCODEC_H
@@ -0,0 +1,449 @@
+#include "libvirtsession.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <QXmlStreamReader>
+#include <QDebug>
+#include <libvirt/libvirt.h>
+#include <libvirt/virterror.h>
+#include <cstdlib>
+#include <mutex>
+
+namespace {
+void wakeEventLoop(int timer, void *opaque)
+{
+    Q_UNUSED(timer);
+    Q_UNUSED(opaque);
+}
+
+QString lastLibvirtError()
+{
+    const char *message = virGetLastErrorMessage();
+    return message ? QString::fromUtf8(message) : QStringLiteral("unknown libvirt error");
+}
+
+void setError(QString *error, const QString &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+VmDomain::State toState(int state)
+{
+    switch (state) {
+    case VIR_DOMAIN_RUNNING: return VmDomain::Running;
+    case VIR_DOMAIN_BLOCKED: return VmDomain::Blocked;
+    case VIR_DOMAIN_PAUSED: return VmDomain::Paused;
+    case VIR_DOMAIN_SHUTDOWN: return VmDomain::ShuttingDown;
+    case VIR_DOMAIN_SHUTOFF: return VmDomain::ShutOff;
+    case VIR_DOMAIN_CRASHED: return VmDomain::Crashed;
+    case VIR_DOMAIN_PMSUSPENDED: return VmDomain::Suspended;
+    default: return VmDomain::Unknown;
+    }
+}
+
+// Reads MAC and source network of the first <interface> from the domain XML
+void readInterface(virDomainPtr dom, VmDomain *info)
+{
+    char *xml = virDomainGetXMLDesc(dom, 0);
+    if (!xml) {
+        return;
+    }
+
+    const QByteArray data(xml);
+    free(xml);
+    QXmlStreamReader reader(data);
+
+    bool inInterface = false;
+    while (!reader.atEnd()) {
+        reader.readNext();
+        if (reader.isStartElement()) {
+            if (reader.name() == QLatin1String("interface")) {
+                inInterface = true;
+            } else if (inInterface && reader.name() == QLatin1String("mac")) {
+                info->macAddress = reader.attributes().value(QLatin1String("address")).toString();
+            } else if (inInterface && reader.name() == QLatin1String("source")) {
+                info->network = reader.attributes().value(QLatin1String("network")).toString();
+                if (info->network.isEmpty()) {
+                    info->network = reader.attributes().value(QLatin1String("bridge")).toString();
+                }
+            }
+        } else if (reader.isEndElement() && reader.name() == QLatin1String("interface")) {
+            if (!info->macAddress.isEmpty()) {
+                return;
+            }
+            inInterface = false;
+        }
+    }
+}
+
+QString interfaceAddress(virDomainPtr dom, unsigned int source)
+{
+    virDomainInterfacePtr *ifaces = nullptr;
+    const int count = virDomainInterfaceAddresses(dom, &ifaces, source, 0);
+    if (count < 0) {
+        return QString();
+    }
+
+    QString address;
+    for (int i = 0; i < count; ++i) {
+        for (unsigned int j = 0; address.isEmpty() && j < ifaces[i]->naddrs; ++j) {
+            const virDomainIPAddress &addr = ifaces[i]->addrs[j];
+            if (addr.type != VIR_IP_ADDR_TYPE_IPV4 || !addr.addr) {
+                continue;
+            }
+            const QString candidate = QString::fromUtf8(addr.addr);
+            if (!candidate.startsWith(QLatin1String("127."))) {
+                address = candidate;
+            }
+        }
+        virDomainInterfaceFree(ifaces[i]);
+    }
+    free(ifaces);
+    return address;
+}
+
+VmDomain describe(virDomainPtr dom)
+{
+    VmDomain info;
+    if (const char *name = virDomainGetName(dom)) {
+        info.name = QString::fromUtf8(name);
+    }
+
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    if (virDomainGetUUIDString(dom, uuid) == 0) {
+        info.uuid = QString::fromLatin1(uuid);
+    }
+
+    int state = 0;
+    int reason = 0;
+    if (virDomainGetState(dom, &state, &reason, 0) == 0) {
+        info.state = toState(state);
+    }
+
+    const unsigned int id = virDomainGetID(dom);
+    info.id = id == static_cast<unsigned int>(-1) ? -1 : static_cast<int>(id);
+
+    int autostart = 0;
+    if (virDomainGetAutostart(dom, &autostart) == 0) {
+        info.autostart = autostart != 0;
+    }
+
+    readInterface(dom, &info);
+    if (info.isRunning()) {
+        // Lease lookups are answered by libvirtd itself and never block on the guest
+        info.ipAddress = interfaceAddress(dom, VIR_DOMAIN_INTERFACE_ADDRESSES_SRC_LEASE);
+    }
+    return info;
+}
+} // namespace
+
+QString VmDomain::stateText() const
+{
+    switch (state) {
+    case Running: return QStringLiteral("Running");
+    case Blocked: return QStringLiteral("Blocked");
+    case Paused: return QStringLiteral("Paused");
+    case ShuttingDown: return QStringLiteral("Shutting down");
+    case ShutOff: return QStringLiteral("Stopped");
+    case Crashed: return QStringLiteral("Crashed");
+    case Suspended: return QStringLiteral("Suspended");
+    case Unknown: break;
+    }
+    return QStringLiteral("Unknown");
+}
+
+LibvirtSession::LibvirtSession(const QString &uri, QObject *parent)
+    : QObject(parent)
+    , m_uri(uri.isEmpty() ? defaultUri() : uri)
+    , m_conn(nullptr)
+    , m_lifecycleCallbackId(-1)
+    , m_eventThread(nullptr)
+    , m_eventLoopRunning(1)
+{
+    static const int typeId = qRegisterMetaType<VmDomain>("VmDomain");
+    static const int eventTypeId = qRegisterMetaType<LibvirtSession::LifecycleEvent>("LibvirtSession::LifecycleEvent");
+    Q_UNUSED(typeId);
+    Q_UNUSED(eventTypeId);
+
+    // The event implementation must be registered before the first connection is opened
+    static std::once_flag eventImplOnce;
+    std::call_once(eventImplOnce, []() {
+        if (virEventRegisterDefaultImpl() < 0) {
+            qWarning() << "Failed to register libvirt event loop:" << lastLibvirtError();
+        }
+    });
+
+    m_eventThread = QThread::create([this]() {
+        while (m_eventLoopRunning.loadAcquire()) {
+            if (virEventRunDefaultImpl() < 0) {
+                qWarning() << "libvirt event loop stopped:" << lastLibvirtError();
+                break;
+            }
+        }
+    });
+    m_eventThread->setObjectName(QStringLiteral("libvirt-events"));
+    m_eventThread->start();
+}
+
+LibvirtSession::~LibvirtSession()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        closeConnectionLocked();
+    }
+
+    // Wake the event loop so it notices the stop flag
+    m_eventLoopRunning.storeRelease(0);
+    const int timer = virEventAddTimeout(0, wakeEventLoop, nullptr, nullptr);
+    m_eventThread->wait();
+    if (timer >= 0) {
+        virEventRemoveTimeout(timer);
+    }
+    delete m_eventThread;
+}
+
+void LibvirtSession::closeConnectionLocked()
+{
+    if (!m_conn) {
+        return;
+    }
+    if (m_lifecycleCallbackId >= 0) {
+        virConnectDomainEventDeregisterAny(m_conn, m_lifecycleCallbackId);
+        m_lifecycleCallbackId = -1;
+    }
+    virConnectUnregisterCloseCallback(m_conn, closeCallback);
+    virConnectClose(m_conn);
+    m_conn = nullptr;
+}
+
+int LibvirtSession::lifecycleCallback(_virConnect *conn, _virDomain *dom, int event, int detail, void *opaque)
+{
+    Q_UNUSED(conn);
+    Q_UNUSED(detail);
+    auto *session = static_cast<LibvirtSession *>(opaque);
+    const char *name = virDomainGetName(dom);
+    if (!session || !name) {
+        return 0;
+    }
+
+    LifecycleEvent lifecycle = DomainOtherEvent;
+    switch (event) {
+    case VIR_DOMAIN_EVENT_DEFINED: lifecycle = DomainDefined; break;
+    case VIR_DOMAIN_EVENT_UNDEFINED: lifecycle = DomainUndefined; break;
+    case VIR_DOMAIN_EVENT_STARTED: lifecycle = DomainStarted; break;
+    case VIR_DOMAIN_EVENT_SUSPENDED:
+    case VIR_DOMAIN_EVENT_PMSUSPENDED: lifecycle = DomainSuspended; break;
+    case VIR_DOMAIN_EVENT_RESUMED: lifecycle = DomainResumed; break;
+    case VIR_DOMAIN_EVENT_STOPPED: lifecycle = DomainStopped; break;
+    case VIR_DOMAIN_EVENT_SHUTDOWN: lifecycle = DomainShutdown; break;
+    case VIR_DOMAIN_EVENT_CRASHED: lifecycle = DomainCrashed; break;
+    default: break;
+    }
+
+    // Emitted from the libvirt event thread; receivers get a queued call
+    emit session->domainLifecycleChanged(QString::fromUtf8(name), lifecycle);
+    return 0;
+}
+
+void LibvirtSession::closeCallback(_virConnect *conn, int reason, void *opaque)
+{
+    Q_UNUSED(conn);
+    auto *session = static_cast<LibvirtSession *>(opaque);
+    if (session && reason != VIR_CONNECT_CLOSE_REASON_CLIENT) {
+        emit session->connectionLost();
+    }
+}
+
+QString LibvirtSession::defaultUri()
+{
+    QByteArray envUri = qgetenv("WINRUN_LIBVIRT_URI");
+    if (!envUri.isEmpty()) {
+        return QString::fromLocal8Bit(envUri);
+    }
+    return QStringLiteral("qemu:///system");
+}
+
+bool LibvirtSession::isOpen() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_conn && virConnectIsAlive(m_conn) == 1;
+}
+
+_virConnect *LibvirtSession::acquire(QString *error)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_conn && virConnectIsAlive(m_conn) != 1) {
+        // libvirtd restarted or the socket dropped; reconnect below
+        closeConnectionLocked();
+    }
+
+    if (!m_conn) {
+        m_conn = virConnectOpen(m_uri.toUtf8().constData());
+        if (!m_conn) {
+            setError(error, QStringLiteral("Failed to connect to %1: %2").arg(m_uri, lastLibvirtError()));
+            return nullptr;
+        }
+
+        // Keepalive lets the event loop notice a dead libvirtd and fire closeCallback
+        virConnectSetKeepAlive(m_conn, 5, 3);
+        virConnectRegisterCloseCallback(m_conn, closeCallback, this, nullptr);
+        m_lifecycleCallbackId = virConnectDomainEventRegisterAny(
+            m_conn, nullptr, VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+            VIR_DOMAIN_EVENT_CALLBACK(lifecycleCallback), this, nullptr);
+        if (m_lifecycleCallbackId < 0) {
+            qWarning() << "Domain lifecycle events unavailable:" << lastLibvirtError();
+        }
+    }
+
+    // Callers hold their own reference so a concurrent reconnect cannot free it
+    virConnectRef(m_conn);
+    return m_conn;
+}
+
+void LibvirtSession::release(_virConnect *conn)
+{
+    if (conn) {
+        virConnectClose(conn);
+    }
+}
+
+QList<VmDomain> LibvirtSession::listDomains(QString *error)
+{
+    QList<VmDomain> domains;
+    virConnectPtr conn = acquire(error);
+    if (!conn) {
+        return domains;
+    }
+
+    virDomainPtr *list = nullptr;
+    const int count = virConnectListAllDomains(conn, &list, 0);
+    if (count < 0) {
+        setError(error, lastLibvirtError());
+    } else {
+        for (int i = 0; i < count; ++i) {
+            domains.append(describe(list[i]));
+            virDomainFree(list[i]);
+        }
+        free(list);
+    }
+
+    release(conn);
+    return domains;
+}
+
+VmDomain LibvirtSession::domain(const QString &name, QString *error)
+{
+    VmDomain info;
+    virConnectPtr conn = acquire(error);
+    if (!conn) {
+        return info;
+    }
+
+    if (virDomainPtr dom = virDomainLookupByName(conn, name.toUtf8().constData())) {
+        info = describe(dom);
+        virDomainFree(dom);
+    } else {
+        setError(error, lastLibvirtError());
+    }
+
+    release(conn);
+    return info;
+}
+
+QString LibvirtSession::guestAddress(const QString &name, AddressSource source, QString *error)
+{
+    virConnectPtr conn = acquire(error);
+    if (!conn) {
+        return QString();
+    }
+
+    QString address;
+    if (virDomainPtr dom = virDomainLookupByName(conn, name.toUtf8().constData())) {
+        unsigned int flag = VIR_DOMAIN_INTERFACE_ADDRESSES_SRC_LEASE;
+        if (source == AgentAddress) {
+            flag = VIR_DOMAIN_INTERFACE_ADDRESSES_SRC_AGENT;
+        } else if (source == ArpAddress) {
+            flag = VIR_DOMAIN_INTERFACE_ADDRESSES_SRC_ARP;
+        }
+        address = interfaceAddress(dom, flag);
+        virDomainFree(dom);
+    } else {
+        setError(error, lastLibvirtError());
+    }
+
+    release(conn);
+    return address;
+}
+
+namespace {
+template <typename Op>
+bool runDomainOperation(virConnectPtr conn, const QString &name, QString *error, Op op)
+{
+    virDomainPtr dom = virDomainLookupByName(conn, name.toUtf8().constData());
+    if (!dom) {
+        setError(error, lastLibvirtError());
+        return false;
+    }
+    const bool ok = op(dom) == 0;
+    if (!ok) {
+        setError(error, lastLibvirtError());
+    }
+    virDomainFree(dom);
+    return ok;
+}
+} // namespace
+
+bool LibvirtSession::start(const QString &name, QString *error)
+{
+    virConnectPtr conn = acquire(error);
+    if (!conn) {
+        return false;
+    }
+    bool ok = runDomainOperation(conn, name, error, [](virDomainPtr dom) {
+        // Starting a domain that is already running is not an error
+        return virDomainIsActive(dom) == 1 ? 0 : virDomainCreate(dom);
+    });
+    release(conn);
+    return ok;
+}
+
+bool LibvirtSession::shutdown(const QString &name, QString *error)
+{
+    virConnectPtr conn = acquire(error);
+    if (!conn) {
+        return false;
+    }
+    bool ok = runDomainOperation(conn, name, error, [](virDomainPtr dom) {
+        return virDomainIsActive(dom) == 1 ? virDomainShutdown(dom) : 0;
+    });
+    release(conn);
+    return ok;
+}
+
+bool LibvirtSession::destroy(const QString &name, QString *error)
+{
+    virConnectPtr conn = acquire(error);
+    if (!conn) {
+        return false;
+    }
+    bool ok = runDomainOperation(conn, name, error, [](virDomainPtr dom) {
+        return virDomainIsActive(dom) == 1 ? virDomainDestroy(dom) : 0;
+    });
+    release(conn);
+    return ok;
+}
+
+bool LibvirtSession::reboot(const QString &name, QString *error)
+{
+    virConnectPtr conn = acquire(error);
+    if (!conn) {
+        return false;
+    }
+    bool ok = runDomainOperation(conn, name, error, [](virDomainPtr dom) {
+        return virDomainReboot(dom, 0);
+    });
+    release(conn);
+    return ok;
+}
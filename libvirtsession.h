@@ -0,0 +1,125 @@
+#ifndef LIBVIRTSESSION_H
+#define LIBVIRTSESSION_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QMetaType>
+#include <QMutex>
+#include <QAtomicInt>
+
+class QThread;
+
+struct VmDomain {
+    enum State {
+        Unknown,
+        Running,
+        Blocked,
+        Paused,
+        ShuttingDown,
+        ShutOff,
+        Crashed,
+        Suspended
+    };
+
+    QString name;
+    QString uuid;
+    State state = Unknown;
+    int id = -1;              // -1 while the domain is inactive
+    bool autostart = false;
+    QString macAddress;       // First interface of the domain
+    QString network;          // Source network of that interface
+    QString ipAddress;        // From the DHCP lease table, when running
+
+    bool isValid() const { return !name.isEmpty(); }
+    bool isRunning() const { return state == Running || state == Blocked; }
+    bool isActive() const { return id >= 0; }
+    QString stateText() const;
+
+    bool operator==(const VmDomain &other) const
+    {
+        return name == other.name && uuid == other.uuid && state == other.state
+            && id == other.id && autostart == other.autostart
+            && macAddress == other.macAddress && network == other.network
+            && ipAddress == other.ipAddress;
+    }
+    bool operator!=(const VmDomain &other) const { return !(*this == other); }
+};
+
+Q_DECLARE_METATYPE(VmDomain)
+
+struct _virConnect;
+struct _virDomain;
+
+// One long-lived connection to libvirtd. All methods are thread-safe and
+// blocking, so callers on the GUI thread should go through TaskQueue::run().
+// The URI defaults to qemu:///system and can be overridden with
+// WINRUN_LIBVIRT_URI (e.g. test:///default).
+//
+// Domain lifecycle events are dispatched by libvirt's event loop on a private
+// thread and re-emitted as queued Qt signals, so nothing polls libvirtd.
+class LibvirtSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum AddressSource {
+        AgentAddress,
+        LeaseAddress,
+        ArpAddress
+    };
+
+    enum LifecycleEvent {
+        DomainDefined,
+        DomainUndefined,
+        DomainStarted,
+        DomainSuspended,
+        DomainResumed,
+        DomainStopped,
+        DomainShutdown,
+        DomainCrashed,
+        DomainOtherEvent
+    };
+    Q_ENUM(LifecycleEvent)
+
+    explicit LibvirtSession(const QString &uri = QString(), QObject *parent = nullptr);
+    ~LibvirtSession();
+
+    QString uri() const { return m_uri; }
+    bool isOpen() const;
+
+    QList<VmDomain> listDomains(QString *error = nullptr);
+    VmDomain domain(const QString &name, QString *error = nullptr);
+
+    // Guest IPv4 address as reported by the given source, empty if unknown
+    QString guestAddress(const QString &name, AddressSource source, QString *error = nullptr);
+
+    bool start(const QString &name, QString *error = nullptr);
+    bool shutdown(const QString &name, QString *error = nullptr);
+    bool destroy(const QString &name, QString *error = nullptr);
+    bool reboot(const QString &name, QString *error = nullptr);
+
+    static QString defaultUri();
+
+signals:
+    // Emitted from the libvirt event thread, i.e. queued for GUI receivers
+    void domainLifecycleChanged(const QString &name, LibvirtSession::LifecycleEvent event);
+    void connectionLost();
+
+private:
+    _virConnect *acquire(QString *error);
+    void release(_virConnect *conn);
+    void closeConnectionLocked();
+
+    static int lifecycleCallback(_virConnect *conn, _virDomain *dom, int event, int detail, void *opaque);
+    static void closeCallback(_virConnect *conn, int reason, void *opaque);
+
+    QString m_uri;
+    mutable QMutex m_mutex;
+    _virConnect *m_conn;
+    int m_lifecycleCallbackId;
+    QThread *m_eventThread;
+    QAtomicInt m_eventLoopRunning;
+};
+
+#endif // LIBVIRTSESSION_H
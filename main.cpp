@@ -1,35 +1,29 @@
 #include "mainwindow.h"
+#include "startupprofile.h"
+#include "theme.h"
 #include <QApplication>
-#include <QStyleFactory>
 
 int main(int argc, char *argv[])
 {
+    // Started before QApplication so its construction is part of the report
+    bool profileStartup = false;
+    for (int i = 1; i < argc; ++i) {
+        profileStartup |= qstrcmp(argv[i], "--startup-profile") == 0;
+    }
+    StartupProfile::start(profileStartup);
+
     QApplication a(argc, argv);
+    StartupProfile::mark(QStringLiteral("application created"));
     
-    // Set application style
-    a.setStyle(QStyleFactory::create("Fusion"));
-    
-    // Set application palette for dark theme
-    QPalette palette;
-    palette.setColor(QPalette::Window, QColor(240, 240, 240));
-    palette.setColor(QPalette::WindowText, Qt::black);
-    palette.setColor(QPalette::Base, QColor(255, 255, 255));
-    palette.setColor(QPalette::AlternateBase, QColor(240, 240, 240));
-    palette.setColor(QPalette::ToolTipBase, QColor(255, 255, 255));
-    palette.setColor(QPalette::ToolTipText, Qt::black);
-    palette.setColor(QPalette::Text, Qt::black);
-    palette.setColor(QPalette::Button, QColor(240, 240, 240));
-    palette.setColor(QPalette::ButtonText, Qt::black);
-    palette.setColor(QPalette::BrightText, Qt::red);
-    palette.setColor(QPalette::Link, QColor(42, 130, 218));
-    palette.setColor(QPalette::Highlight, QColor(42, 130, 218));
-    palette.setColor(QPalette::HighlightedText, Qt::white);
-    
-    a.setPalette(palette);
+    // Fusion with the application's palette and themed buttons
+    a.setStyle(Theme::createStyle());
+    a.setPalette(Theme::palette());
     
     // Create and show main window
     MainWindow w;
+    StartupProfile::mark(QStringLiteral("main window constructed"));
     w.show();
+    StartupProfile::mark(QStringLiteral("main window shown"));
     
     return a.exec();
 }
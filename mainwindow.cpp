@@ -2,6 +2,10 @@
 #include "addprogramdialog.h"
 #include "connectdialog.h"
 #include "guestserverdialog.h"
+#include "guestaddressresolver.h"
+#include "guestreadiness.h"
+#include "startupprofile.h"
+#include "theme.h"
 #include <QApplication>
 #include <QStyleFactory>
 #include <QDebug>
@@ -14,140 +18,41 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QCoreApplication>
-#include <QRegularExpression>
 #include <QMessageBox>
 #include <QStandardPaths>
+#include <QElapsedTimer>
 
 namespace {
 constexpr quint16 kGuestServerPort = 7148;
-
-QString runProcess(const QString &program, const QStringList &args, bool *ok)
-{
-    QProcess p;
-    p.start(program, args);
-    if (!p.waitForFinished(5000)) {
-        if (ok) *ok = false;
-        p.kill();
-        return {};
-    }
-    if (ok) {
-        *ok = (p.exitStatus() == QProcess::NormalExit && p.exitCode() == 0);
-    }
-    return QString::fromLocal8Bit(p.readAllStandardOutput());
-}
-
-QString extractIpAddress(const QString &text)
-{
-    static const QRegularExpression ipRegex(QStringLiteral("(\\d{1,3}(?:\\.\\d{1,3}){3})(?:/\\d{1,2})?"));
-    auto match = ipRegex.match(text);
-    if (match.hasMatch()) {
-        QString value = match.captured(1);
-        return value;
-    }
-    return {};
-}
-
-QStringList extractNetworksFromXml(const QString &xml)
-{
-    QStringList networks;
-    QRegularExpression networkRegex(QStringLiteral("<interface[^>]*>.*?<source[^>]*network=\"([^\"']+)\""), QRegularExpression::DotMatchesEverythingOption);
-    QRegularExpressionMatchIterator it = networkRegex.globalMatch(xml);
-    while (it.hasNext()) {
-        auto match = it.next();
-        QString network = match.captured(1);
-        if (!network.isEmpty() && !networks.contains(network)) {
-            networks.append(network);
-        }
-    }
-    return networks;
-}
-
-QString getMacFromXml(const QString &xml)
-{
-    QRegularExpression re(QStringLiteral("<mac\\s+address=\"?([^\"'/>]+)\"?"));
-    auto match = re.match(xml);
-    if (match.hasMatch()) {
-        return match.captured(1);
-    }
-    return {};
-}
-
-QString getIpFromDomIfAddr(const QString &vmName)
-{
-    const QList<QStringList> commands = {
-        {QStringLiteral("domifaddr"), vmName, QStringLiteral("--source"), QStringLiteral("agent")},
-        {QStringLiteral("domifaddr"), vmName}
-    };
-
-    for (const QStringList &args : commands) {
-        bool ok = false;
-        QString output = runProcess(QStringLiteral("virsh"), args, &ok);
-        if (!ok || output.isEmpty()) {
-            continue;
-        }
-
-        QString ip = extractIpAddress(output);
-        if (!ip.isEmpty()) {
-            return ip;
-        }
-    }
-
-    return {};
-}
-
-QString getIpForMac(const QString &mac, const QStringList &preferredNetworks)
-{
-    QStringList networks = preferredNetworks;
-    if (networks.isEmpty()) {
-        networks = {QStringLiteral("default"), QStringLiteral("virbr0"), QStringLiteral("bridge")};
-    }
-
-    for (const QString &network : networks) {
-        bool ok = false;
-        QString output = runProcess(QStringLiteral("virsh"), {QStringLiteral("net-dhcp-leases"), network, QStringLiteral("--mac"), mac}, &ok);
-        if (!ok || output.isEmpty()) {
-            continue;
-        }
-        QString ip = extractIpAddress(output);
-        if (!ip.isEmpty()) {
-            return ip;
-        }
-    }
-    return {};
-}
-
-QString resolveGuestIp(const QString &vmName)
-{
-    QString ip = getIpFromDomIfAddr(vmName);
-    if (!ip.isEmpty()) {
-        return ip;
-    }
-
-    bool ok = false;
-    QString xml = runProcess(QStringLiteral("virsh"), {QStringLiteral("dumpxml"), vmName}, &ok);
-    if (!ok || xml.isEmpty()) {
-        return {};
-    }
-
-    QString mac = getMacFromXml(xml);
-    if (mac.isEmpty()) {
-        return {};
-    }
-
-    QStringList networks = extractNetworksFromXml(xml);
-    return getIpForMac(mac, networks);
-}
 } // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       addProgramDialog(nullptr),
+      desktopPage(nullptr),
+      filePage(nullptr),
+      settingsPage(nullptr),
+      aboutPage(nullptr),
+      vmCombo(nullptr),
+      vmStatusLabel(nullptr),
+      vmStartBtn(nullptr),
+      vmStopBtn(nullptr),
+      vmRestartBtn(nullptr),
+      vmCancelBtn(nullptr),
+      vmConnectBtn(nullptr),
+      guestServerBtn(nullptr),
       m_guestServerWidget(new GuestServerWidget("", 0, "", this)),
       m_guestServerAppsClient(new GuestServerAppsClient("", 0, this)),
       m_appsListWidget(new AppsListWidget(this)),
       rdpProcess(new QProcess(this)),
-      m_guestServerRefreshTimer(new QTimer(this)),
-      m_vmListRefreshTimer(new QTimer(this))
+      m_vmListRefreshTimer(new QTimer(this)),
+      m_taskQueue(new TaskQueue(4, this)),
+      m_libvirt(new LibvirtSession(QString(), this)),
+      m_vmModel(new VmListModel(this)),
+      m_addressResolver(new GuestAddressResolver(m_libvirt, m_taskQueue, this)),
+      m_readiness(new GuestReadiness(m_addressResolver, m_taskQueue, this)),
+      m_vmOperations(new VmOperationQueue(m_libvirt, m_taskQueue, this)),
+      m_vmListSeen(false)
 {
     // Set window properties
     setWindowTitle("WinRun");
@@ -177,42 +82,44 @@ MainWindow::MainWindow(QWidget *parent)
                     "    border-left: 4px solid white; "
                     "} ";
     
-    addButtonStyle = "QPushButton { "
-                    "    background-color: #1a535c; "
-                    "    color: white; "
-                    "    border: none; "
-                    "    border-radius: 15px; "
-                    "    padding: 15px 30px; "
-                    "    font-size: 16px; "
-                    "    font-weight: bold; "
-                    "} "
-                    "QPushButton:hover { "
-                    "    background-color: #2a7a83; "
-                    "} ";
-    
-    // Setup guest server refresh timer (retry every 5 seconds if IP not found)
-    m_guestServerRefreshTimer->setInterval(5000);
-    m_guestServerRefreshTimer->setSingleShot(false);
-    connect(m_guestServerRefreshTimer, &QTimer::timeout, this, &MainWindow::refreshGuestServerEndpoint);
+    // The guest server endpoint follows the readiness pipeline of the selected VM
+    m_readiness->setPorts(3389, kGuestServerPort);
+    connect(m_readiness, &GuestReadiness::stageChanged, this,
+            [this](const QString &vmName, GuestReadiness::Stage stage, const QString &address) {
+        if (vmName == currentVmName()) {
+            applyGuestServerEndpoint(vmName, stage == GuestReadiness::Ready ? address : QString());
+        }
+    });
     
-    // Setup VM list refresh timer (refresh every 3 seconds to catch state changes)
-    m_vmListRefreshTimer->setInterval(3000);
-    m_vmListRefreshTimer->setSingleShot(false);
-    connect(m_vmListRefreshTimer, &QTimer::timeout, this, [this]() {
-        refreshVMList();
-        updateVmControls();
-        // Refresh guest server endpoint when VM list is refreshed (if on Desktop page)
-        if (stackedWidget && stackedWidget->currentWidget() == desktopPage) {
-            refreshGuestServerEndpoint();
+    // VM state changes are pushed by libvirt lifecycle events. The list timer
+    // only re-reads the full list after libvirtd was unreachable.
+    m_vmListRefreshTimer->setInterval(5000);
+    m_vmListRefreshTimer->setSingleShot(true);
+    connect(m_vmListRefreshTimer, &QTimer::timeout, this, &MainWindow::refreshVMList);
+    connect(m_libvirt, &LibvirtSession::domainLifecycleChanged, this, &MainWindow::onDomainLifecycleChanged);
+    connect(m_vmOperations, &VmOperationQueue::progressChanged, this, [this](const QString &vmName) {
+        if (vmName == currentVmName()) {
+            updateVmControls();
         }
     });
-    m_vmListRefreshTimer->start();
+    connect(m_vmOperations, &VmOperationQueue::operationFinished, this, &MainWindow::onVmOperationFinished);
+    connect(m_libvirt, &LibvirtSession::connectionLost, this, [this]() {
+        qWarning() << "Lost connection to libvirtd, reconnecting...";
+        markVmListStale();
+    });
     
     setupUI();
+    StartupProfile::mark(QStringLiteral("main window built"));
+    
+    // libvirt and guest discovery wait for the first frame
+    sidebar->installEventFilter(this);
 }
 
 MainWindow::~MainWindow()
 {
+    // Wait for in-flight libvirt calls before the session goes away
+    delete m_taskQueue;
+    m_taskQueue = nullptr;
 }
 
 void MainWindow::setupUI()
@@ -421,7 +328,11 @@ void MainWindow::setupMainContent()
     
     // Add Programs button
     addProgramsBtn = new QPushButton("Add new programs");
-    addProgramsBtn->setStyleSheet(addButtonStyle);
+    Theme::setRole(addProgramsBtn, Theme::Prominent);
+    QFont addProgramsFont = addProgramsBtn->font();
+    addProgramsFont.setPixelSize(16);
+    addProgramsFont.setBold(true);
+    addProgramsBtn->setFont(addProgramsFont);
     addProgramsBtn->setCursor(Qt::PointingHandCursor);
     addProgramsBtn->setMinimumSize(200, 50);
     
@@ -437,18 +348,11 @@ void MainWindow::setupMainContent()
     allProgramsLayout->addWidget(addProgramsBtn, 0, Qt::AlignCenter);
     allProgramsLayout->addWidget(addProgramsHint, 0, Qt::AlignCenter);
     
-    // Setup other pages
-    setupDesktopPage();
-    setupFilePage();
-    setupSettingsPage();
-    setupAboutPage();
-    
-    // Add pages to stacked widget
+    // The other pages are built the first time they are shown
     stackedWidget->addWidget(allProgramsPage);
-    stackedWidget->addWidget(desktopPage);
-    stackedWidget->addWidget(filePage);
-    stackedWidget->addWidget(settingsPage);
-    stackedWidget->addWidget(aboutPage);
+    
+    // Until then the monitor has no page to live on
+    m_guestServerWidget->hide();
     
     // Set stacked widget as the scroll area's widget
     contentScrollArea->setWidget(stackedWidget);
@@ -463,14 +367,23 @@ void MainWindow::setupMainContent()
     // Connect apps client signals
     connect(m_guestServerAppsClient, &GuestServerAppsClient::appsReceived,
             m_appsListWidget, &AppsListWidget::setApps);
+    connect(m_guestServerAppsClient, &GuestServerAppsClient::appsBatchReceived,
+            m_appsListWidget, &AppsListWidget::appendApps);
     connect(m_guestServerAppsClient, &GuestServerAppsClient::appsReceived,
             this, &MainWindow::onAppsReceived);
     connect(m_guestServerAppsClient, &GuestServerAppsClient::iconReceived,
             m_appsListWidget, &AppsListWidget::setIcon);
+    connect(m_guestServerAppsClient, &GuestServerAppsClient::staleChanged,
+            m_appsListWidget, &AppsListWidget::setStale);
     connect(m_guestServerAppsClient, &GuestServerAppsClient::error,
             this, [this](const QString &error) {
                 qWarning() << "Apps client error:" << error;
             });
+    
+    // The VM list arrives later; until then show the apps and icons of the
+    // catalog shown last time, straight from disk, so the first frame is
+    // not empty. They are revalidated once the guest server is ready.
+    m_guestServerAppsClient->restoreLastCatalog();
 }
 
 // Slots implementation
@@ -484,15 +397,12 @@ void MainWindow::onAllAppsClicked()
     aboutBtn->setChecked(false);
     
     // Show the all programs page
-    stackedWidget->setCurrentWidget(allProgramsPage);
+    showPage(allProgramsPage, nullptr);
     
     // Stop guest server monitoring when not on Desktop page
     if (m_guestServerWidget) {
         m_guestServerWidget->stopMonitoring();
     }
-    if (m_guestServerRefreshTimer && m_guestServerRefreshTimer->isActive()) {
-        m_guestServerRefreshTimer->stop();
-    }
     
     // Refresh apps list
     refreshAppsList();
@@ -508,26 +418,25 @@ void MainWindow::onDesktopClicked()
     aboutBtn->setChecked(false);
     
     // Show the desktop page
-    stackedWidget->setCurrentWidget(desktopPage);
+    showPage(desktopPage, &MainWindow::setupDesktopPage);
     titleLabel->setText("Desktop");
     
     // Start guest server monitoring on Desktop page
     if (m_guestServerWidget) {
         m_guestServerWidget->setVisible(true);
-        refreshGuestServerEndpoint(); // This will start the timer if IP not found
+        refreshGuestServerEndpoint();
         m_guestServerWidget->startMonitoring(5000); // Update every 5 seconds
     }
     
     // Refresh apps list when switching to Desktop (in case endpoint was configured)
     refreshAppsList();
     
-    refreshVMList();
     updateVmControls();
 }
 
 void MainWindow::onFileClicked()
 {
-    stackedWidget->setCurrentWidget(filePage);
+    showPage(filePage, &MainWindow::setupFilePage);
     titleLabel->setText("File Manager");
     
     // Update button states
@@ -537,18 +446,15 @@ void MainWindow::onFileClicked()
     settingsBtn->setChecked(false);
     aboutBtn->setChecked(false);
     
-    // Stop guest server monitoring and refresh timer when not on Desktop/All Apps page
+    // Stop guest server monitoring when not on Desktop/All Apps page
     if (m_guestServerWidget) {
         m_guestServerWidget->stopMonitoring();
     }
-    if (m_guestServerRefreshTimer && m_guestServerRefreshTimer->isActive()) {
-        m_guestServerRefreshTimer->stop();
-    }
 }
 
 void MainWindow::onSettingsClicked()
 {
-    stackedWidget->setCurrentWidget(settingsPage);
+    showPage(settingsPage, &MainWindow::setupSettingsPage);
     titleLabel->setText("Settings");
     
     // Update button states
@@ -558,18 +464,15 @@ void MainWindow::onSettingsClicked()
     settingsBtn->setChecked(true);
     aboutBtn->setChecked(false);
     
-    // Stop guest server monitoring and refresh timer when not on Desktop/All Apps page
+    // Stop guest server monitoring when not on Desktop/All Apps page
     if (m_guestServerWidget) {
         m_guestServerWidget->stopMonitoring();
     }
-    if (m_guestServerRefreshTimer && m_guestServerRefreshTimer->isActive()) {
-        m_guestServerRefreshTimer->stop();
-    }
 }
 
 void MainWindow::onAboutClicked()
 {
-    stackedWidget->setCurrentWidget(aboutPage);
+    showPage(aboutPage, &MainWindow::setupAboutPage);
     titleLabel->setText("About");
     
     // Update button states
@@ -579,13 +482,10 @@ void MainWindow::onAboutClicked()
     settingsBtn->setChecked(false);
     aboutBtn->setChecked(true);
     
-    // Stop guest server monitoring and refresh timer when not on Desktop/All Apps page
+    // Stop guest server monitoring when not on Desktop/All Apps page
     if (m_guestServerWidget) {
         m_guestServerWidget->stopMonitoring();
     }
-    if (m_guestServerRefreshTimer && m_guestServerRefreshTimer->isActive()) {
-        m_guestServerRefreshTimer->stop();
-    }
 }
 
 void MainWindow::onAddProgramsClicked()
@@ -658,19 +558,25 @@ void MainWindow::onConnectToGuestServer()
         args << "/f" << "/multimon" << "/w:1920" << "/h:1080";
 #endif
         
-        // Kill any existing RDP connection
+        // Kill any existing RDP connection and let it exit in the background
         if (rdpProcess->state() != QProcess::NotRunning) {
-            rdpProcess->kill();
-            rdpProcess->waitForFinished(1000);
+            QProcess *previous = rdpProcess;
+            previous->disconnect(this);
+            connect(previous, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                    previous, &QObject::deleteLater);
+            previous->kill();
+            rdpProcess = new QProcess(this);
         }
         
-        // Start the RDP client
+        // Start the RDP client; a start failure is reported asynchronously
+        rdpProcess->disconnect(this);
+        connect(rdpProcess, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                QMessageBox::warning(this, "Connection Failed", 
+                    "Failed to start RDP client. Make sure 'xfreerdp' is installed on Linux or 'mstsc' is available on Windows.");
+            }
+        });
         rdpProcess->start(program, args);
-        
-        if (!rdpProcess->waitForStarted(3000)) {
-            QMessageBox::warning(this, "Connection Failed", 
-                "Failed to start RDP client. Make sure 'xfreerdp' is installed on Linux or 'mstsc' is available on Windows.");
-        }
     }
 }
 
@@ -693,38 +599,53 @@ void MainWindow::setupDesktopPage()
     vmCombo = new QComboBox();
     vmCombo->setMinimumWidth(240);
     vmCombo->setStyleSheet("QComboBox { font-size: 16px; padding: 6px; }");
+    vmCombo->setModel(m_vmModel);
+    vmCombo->setPlaceholderText("---------");
+    // The VM may have been selected before the page existed
+    vmCombo->setCurrentIndex(m_vmModel->rowOf(m_selectedVm));
     connect(vmCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onVmSelectionChanged);
     vmSelectLayout->addWidget(vmText);
     vmSelectLayout->addWidget(vmCombo, 1);
     controlsLayout->addLayout(vmSelectLayout);
 
     vmStatusLabel = new QLabel("Status: Unknown");
-    vmStatusLabel->setStyleSheet("font-size: 16px; font-weight: 600; color: #607d8b;");
-    controlsLayout->addWidget(vmStatusLabel);
+    // Only the color changes with the state, through Theme::setStatus
+    QFont statusFont = vmStatusLabel->font();
+    statusFont.setPixelSize(18);
+    statusFont.setWeight(QFont::Bold);
+    vmStatusLabel->setFont(statusFont);
+    Theme::setStatus(vmStatusLabel, Theme::Neutral);
+
+    // Drops a queued operation or stops waiting for a graceful shutdown
+    vmCancelBtn = new QPushButton("Cancel");
+    Theme::setRole(vmCancelBtn, Theme::Secondary);
+    vmCancelBtn->setVisible(false);
+
+    QHBoxLayout *statusRow = new QHBoxLayout();
+    statusRow->addWidget(vmStatusLabel, 1);
+    statusRow->addWidget(vmCancelBtn);
+    controlsLayout->addLayout(statusRow);
 
     QHBoxLayout *buttonRow = new QHBoxLayout();
     buttonRow->setSpacing(12);
-    QString ctrlBtnStyle =
-        "QPushButton { background-color: #1a535c; color: white; border: none; padding: 12px; border-radius: 6px; } "
-        "QPushButton:hover { background-color: #2a7a83; }";
 
     vmStartBtn = new QPushButton();
     vmStartBtn->setFixedSize(96, 72);
-    vmStartBtn->setStyleSheet(ctrlBtnStyle);
+    Theme::setRole(vmStartBtn, Theme::Primary);
     vmStartBtn->setIcon(QIcon(":/icons/icon/start.png"));
     vmStartBtn->setIconSize(QSize(36, 36));
     vmStartBtn->setToolTip("Start VM");
 
     vmStopBtn = new QPushButton();
     vmStopBtn->setFixedSize(96, 72);
-    vmStopBtn->setStyleSheet(ctrlBtnStyle);
+    Theme::setRole(vmStopBtn, Theme::Primary);
     vmStopBtn->setIcon(QIcon(":/icons/icon/stop.png"));
     vmStopBtn->setIconSize(QSize(36, 36));
     vmStopBtn->setToolTip("Stop VM");
 
     vmRestartBtn = new QPushButton();
     vmRestartBtn->setFixedSize(96, 72);
-    vmRestartBtn->setStyleSheet(ctrlBtnStyle);
+    Theme::setRole(vmRestartBtn, Theme::Primary);
     vmRestartBtn->setIcon(QIcon(":/icons/icon/reset.png"));
     vmRestartBtn->setIconSize(QSize(36, 36));
     vmRestartBtn->setToolTip("Restart VM");
@@ -735,17 +656,20 @@ void MainWindow::setupDesktopPage()
     controlsLayout->addLayout(buttonRow);
 
     vmConnectBtn = new QPushButton(QString::fromUtf8("🔗 Connect to Desktop"));
-    vmConnectBtn->setStyleSheet(
-        "QPushButton { background-color: #1a535c; color: white; border: none; padding: 14px 16px; font-size: 18px; font-weight: 600; border-radius: 6px; } "
-        "QPushButton:hover { background-color: #2a7a83; }"
-    );
+    Theme::setRole(vmConnectBtn, Theme::Primary);
+    QFont connectFont = vmConnectBtn->font();
+    connectFont.setPixelSize(18);
+    connectFont.setWeight(QFont::DemiBold);
+    vmConnectBtn->setFont(connectFont);
+    vmConnectBtn->setMinimumHeight(52);
     controlsLayout->addWidget(vmConnectBtn);
 
     guestServerBtn = new QPushButton("Connect to Guest Server");
-    guestServerBtn->setStyleSheet(
-        "QPushButton { background-color: #ff9f1c; color: white; border: none; padding: 12px 16px; border-radius: 6px; font-weight: 600; } "
-        "QPushButton:hover { background-color: #ffbf69; }"
-    );
+    Theme::setRole(guestServerBtn, Theme::Highlight);
+    QFont guestServerFont = guestServerBtn->font();
+    guestServerFont.setWeight(QFont::DemiBold);
+    guestServerBtn->setFont(guestServerFont);
+    guestServerBtn->setMinimumHeight(44);
     connect(guestServerBtn, &QPushButton::clicked, this, &MainWindow::onConnectToGuestServer);
     controlsLayout->addWidget(guestServerBtn);
 
@@ -774,6 +698,7 @@ void MainWindow::setupDesktopPage()
     QVBoxLayout *monitorLayout = new QVBoxLayout(monitorFrame);
     monitorLayout->setContentsMargins(5, 5, 5, 5);
     monitorLayout->addWidget(m_guestServerWidget);
+    m_guestServerWidget->show();
     controlsLayout->addWidget(monitorFrame);
 
     controlsLayout->addStretch();
@@ -784,8 +709,8 @@ void MainWindow::setupDesktopPage()
     connect(vmStopBtn, &QPushButton::clicked, this, &MainWindow::onVmStop);
     connect(vmRestartBtn, &QPushButton::clicked, this, &MainWindow::onVmRestart);
     connect(vmConnectBtn, &QPushButton::clicked, this, &MainWindow::onVmConnect);
+    connect(vmCancelBtn, &QPushButton::clicked, this, &MainWindow::onVmCancelOperation);
 
-    refreshVMList();
     updateVmControls();
 }
 
@@ -841,60 +766,228 @@ void MainWindow::setupSettingsPage()
 
 void MainWindow::refreshVMList()
 {
-    if (!vmCombo) return;
-    vmCombo->clear();
-    vmStateByName.clear();
-
-    QString out, err;
-    if (!runLibvirtCommand({"list"}, &out, &err)) {
-        qWarning() << "libvirt manager List failed:" << err;
-        vmCombo->addItem("---------");
+    // Skip if a listing is already running
+    if (m_vmListTask) return;
+
+    LibvirtSession *session = m_libvirt;
+    m_vmListTask = m_taskQueue->run([session]() {
+        QString error;
+        QList<VmDomain> domains = session->listDomains(&error);
+        if (!error.isEmpty()) {
+            qWarning() << "libvirt domain listing failed:" << error;
+            return QVariant();
+        }
+        return QVariant::fromValue(domains);
+    });
+    m_vmListTask->then(this, [this](const TaskResult &result) {
+        m_vmListTask.clear();
+        if (!result.value.isValid()) {
+            // libvirtd unreachable: no events will arrive until we reconnect.
+            // The last good list stays, so the selection and the apps
+            // catalog do not flip to nothing and back.
+            markVmListStale();
+            // A cold or missing libvirtd is what the profile is most wanted for
+            if (!m_vmListSeen) {
+                m_vmListSeen = true;
+                StartupProfile::mark(QStringLiteral("VM list failed"));
+                StartupProfile::report();
+            }
+            return;
+        }
+        const bool wasStale = m_vmModel->isStale();
+        m_vmModel->setStale(false);
+        applyVmList(result.value.value<QList<VmDomain>>());
+        if (wasStale) {
+            updateVmControls();
+        }
+    });
+}
+
+void MainWindow::markVmListStale()
+{
+    m_vmModel->setStale(true);
+    updateVmControls();
+    m_vmListRefreshTimer->start();
+}
+
+void MainWindow::onDomainLifecycleChanged(const QString &name, LibvirtSession::LifecycleEvent event)
+{
+    qDebug() << "Domain event:" << name << event;
+
+    // A restarted guest may come back with a different lease
+    if (event == LibvirtSession::DomainStarted || event == LibvirtSession::DomainStopped
+        || event == LibvirtSession::DomainUndefined) {
+        m_addressResolver->invalidate(name);
+    }
+
+    // Re-read only the domain that changed. Lookups may finish out of order,
+    // so only the newest one per domain is applied.
+    const quint64 sequence = ++m_domainUpdateSequence[name];
+    LibvirtSession *session = m_libvirt;
+    m_taskQueue->run([session, name]() {
+        QString error;
+        const VmDomain domain = session->domain(name, &error);
+        // A lost connection is not an undefined domain
+        if (!domain.isValid() && !session->isOpen()) {
+            qWarning() << "libvirt domain lookup failed:" << name << error;
+            return QVariant();
+        }
+        return QVariant::fromValue(domain);
+    })->then(this, [this, name, sequence](const TaskResult &result) {
+        if (m_domainUpdateSequence.value(name) != sequence) {
+            return;
+        }
+        m_domainUpdateSequence.remove(name);
+        if (!result.value.isValid()) {
+            markVmListStale();
+            return;
+        }
+        applyDomainUpdate(name, result.value.value<VmDomain>());
+    });
+}
+
+void MainWindow::applyDomainUpdate(const QString &name, const VmDomain &domain)
+{
+    // A graceful shutdown completes when the domain goes inactive
+    m_vmOperations->domainUpdated(name, domain);
+
+    // Unchanged domains (e.g. a redundant event) stop here
+    if (!m_vmModel->updateDomain(name, domain)) {
         return;
     }
 
-    QRegularExpression ansi("\\x1B\\[[0-9;]*m");
-    out.replace(ansi, "");
-
-    QStringList lines = out.split('\n', Qt::SkipEmptyParts);
-    for (const QString &line : lines) {
-        if (!line.startsWith('|')) continue;
-        QStringList cols = line.split('|');
-        if (cols.size() < 3) continue;
-        QString name = cols.value(1).trimmed();
-        QString state = cols.value(2).trimmed();
-        if (name.compare("Name", Qt::CaseInsensitive) == 0) continue;
-        if (name.isEmpty()) continue;
-        vmStateByName.insert(name, state);
-        vmCombo->addItem(name);
+    ensureVmSelected();
+    if (name != currentVmName()) {
+        return;
+    }
+    updateVmControls();
+    // Keeps the readiness pipeline in step with the domain on every page
+    refreshGuestServerEndpoint();
+}
+
+void MainWindow::applyVmList(const QList<VmDomain> &domains)
+{
+    const VmDomain before = m_vmModel->domain(currentVmName());
+    m_vmModel->reconcile(domains);
+    for (const VmDomain &domain : domains) {
+        m_vmOperations->domainUpdated(domain.name, domain);
     }
 
-    if (vmCombo->count() == 0) {
-        vmCombo->addItem("---------");
+    // Only the selected VM drives controls and the guest endpoint. Selection
+    // changes are handled by selectVm.
+    ensureVmSelected();
+    if (!m_vmListSeen) {
+        m_vmListSeen = true;
+        StartupProfile::mark(QStringLiteral("VM list applied (%1 domains)").arg(domains.size()));
+        StartupProfile::report();
+    }
+    const VmDomain after = m_vmModel->domain(currentVmName());
+    if (before == after) {
+        return;
     }
+
+    updateVmControls();
+    refreshGuestServerEndpoint();
+}
+
+QString MainWindow::currentVmName() const
+{
+    // Kept even while the Desktop page, and its combo box, is not built
+    return m_selectedVm;
+}
+
+void MainWindow::ensureVmSelected()
+{
+    // The selected VM went away, or none was selected yet
+    if (m_vmModel->rowOf(m_selectedVm) < 0) {
+        selectVm(m_vmModel->rowCount() > 0 ? m_vmModel->domainAt(0).name : QString());
+    }
+}
+
+void MainWindow::showPage(QWidget *&page, void (MainWindow::*setup)())
+{
+    if (!page && setup) {
+        QElapsedTimer elapsed;
+        elapsed.start();
+        (this->*setup)();
+        stackedWidget->addWidget(page);
+        qDebug() << "Built page" << page << "in" << elapsed.elapsed() << "ms";
+    }
+    stackedWidget->setCurrentWidget(page);
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == sidebar && event->type() == QEvent::Paint) {
+        sidebar->removeEventFilter(this);
+        StartupProfile::mark(QStringLiteral("first frame"));
+        if (StartupProfile::isEnabled() && StartupProfile::elapsedMs() > StartupProfile::kFirstFrameTargetMs) {
+            qWarning() << "First frame took" << StartupProfile::elapsedMs() << "ms, target is"
+                       << StartupProfile::kFirstFrameTargetMs << "ms";
+        }
+        // Right after this paint, not within it
+        QTimer::singleShot(0, this, &MainWindow::startDeferredWork);
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::startDeferredWork()
+{
+    // Opens the libvirt connection on a worker; the VM list, the readiness
+    // probes and the guest server follow from its result
+    StartupProfile::mark(QStringLiteral("deferred work started"));
+    refreshVMList();
 }
 
 void MainWindow::updateVmControls()
 {
-    bool hasVm = vmCombo && vmCombo->currentIndex() >= 0 && vmCombo->currentText() != "---------";
-    QString state = vmStateByName.value(vmCombo ? vmCombo->currentText() : QString());
-    QString st = state.toLower();
-    bool running = st.contains("run");
+    // Nothing to update until the Desktop page is built
+    if (!vmStartBtn) {
+        return;
+    }
+
+    QString vmName = currentVmName();
+    bool hasVm = !vmName.isEmpty();
+    VmDomain domain = m_vmModel->domain(vmName);
+    bool running = domain.isRunning();
+    // Repeated clicks are coalesced by the operation queue, so the buttons
+    // stay usable while an operation runs
+    bool busy = hasVm && m_vmOperations->isBusy(vmName);
+    bool shuttingDown = hasVm && m_vmOperations->canEscalate(vmName);
     vmStartBtn->setEnabled(hasVm && !running);
-    vmStopBtn->setEnabled(hasVm && running);
+    vmStopBtn->setEnabled(hasVm && (running || shuttingDown));
+    vmStopBtn->setToolTip(shuttingDown ? "Force off VM" : "Stop VM");
     vmRestartBtn->setEnabled(hasVm && running);
     vmConnectBtn->setEnabled(hasVm);
+    vmCancelBtn->setVisible(hasVm && m_vmOperations->canCancel(vmName));
 
     // Update status label
     if (vmStatusLabel) {
         QString label = "Unknown";
-        QString color = "#888";
-        if (hasVm) {
-            if (st.contains("run")) { label = "Running"; color = "#2ecc71"; }
-            else if (st.contains("stop")) { label = "Stopped"; color = "#e74c3c"; }
-            else if (st.contains("pause")) { label = "Paused"; color = "#f1c40f"; }
+        Theme::Status status = Theme::Neutral;
+        if (busy) {
+            label = m_vmOperations->progressText(vmName);
+            status = Theme::Busy;
+        } else if (hasVm) {
+            switch (domain.state) {
+            case VmDomain::Running:
+            case VmDomain::Blocked: label = "Running"; status = Theme::Ok; break;
+            case VmDomain::ShutOff:
+            case VmDomain::Crashed: label = "Stopped"; status = Theme::Error; break;
+            case VmDomain::Paused:
+            case VmDomain::Suspended: label = "Paused"; status = Theme::Busy; break;
+            case VmDomain::ShuttingDown: label = "Shutting down"; status = Theme::Busy; break;
+            case VmDomain::Unknown: break;
+            }
+            if (m_vmModel->isStale()) {
+                // libvirtd is unreachable; this is what it said last
+                label += " (last known)";
+                status = Theme::Neutral;
+            }
         }
+        // Both are no-ops when nothing changed
         vmStatusLabel->setText(label);
-        vmStatusLabel->setStyleSheet(QString("font-size: 18px; font-weight: 700; color: %1;").arg(color));
+        Theme::setStatus(vmStatusLabel, status);
     }
 }
 
@@ -904,75 +997,30 @@ void MainWindow::refreshGuestServerEndpoint()
         return;
     }
 
-    QString ip;
-    QString vmName = vmCombo ? vmCombo->currentText() : QString();
-    bool hasVm = !vmName.isEmpty() && vmName != "---------";
+    // Readiness probes run in the background and report through
+    // stageChanged; apply whatever is known right now
+    QString vmName = currentVmName();
+    m_readiness->setRunning(vmName, m_vmModel->domain(vmName).isRunning());
+    applyGuestServerEndpoint(vmName, m_readiness->isReady(vmName) ? m_readiness->address(vmName) : QString());
+}
 
-    if (hasVm) {
-        // Check if VM is running first
-        QString state = vmStateByName.value(vmName).toLower();
-        bool isRunning = state.contains("run");
-        
-        if (isRunning) {
-            // Use the robust IP resolution with multiple fallback methods
-            // First try QEMU agent (getIpFromDomIfAddr)
-            ip = getIpFromDomIfAddr(vmName);
-            
-            // If that fails, try MAC-based lookup
-            if (ip.isEmpty()) {
-                bool ok = false;
-                QString xml = runProcess(QStringLiteral("virsh"), {QStringLiteral("dumpxml"), vmName}, &ok);
-                if (ok && !xml.isEmpty()) {
-                    QStringList networks = extractNetworksFromXml(xml);
-                    QString mac = getMacFromXml(xml);
-                    if (!mac.isEmpty()) {
-                        ip = getIpForMac(mac, networks);
-                    }
-                }
-            }
-        }
+void MainWindow::applyGuestServerEndpoint(const QString &vmName, const QString &ip)
+{
+    // Only a real endpoint change reconfigures the clients and reloads apps
+    if (ip == m_currentGuestServerIp) {
+        return;
     }
+    m_currentGuestServerIp = ip;
 
     if (!ip.isEmpty()) {
-        // IP found - stop the refresh timer and configure the server
-        if (m_guestServerRefreshTimer->isActive()) {
-            m_guestServerRefreshTimer->stop();
-        }
-        m_currentGuestServerIp = ip;
         m_guestServerWidget->configureServer(ip, kGuestServerPort);
         m_guestServerAppsClient->setServerEndpoint(ip, kGuestServerPort);
-        // Refresh apps list when endpoint is configured
         refreshAppsList();
-        qDebug() << "Guest server endpoint configured:" << ip << ":" << kGuestServerPort;
+        qDebug() << "Guest server endpoint configured:" << vmName << ip << ":" << kGuestServerPort;
     } else {
-        // IP not found - clear endpoint and start/continue timer if on All Apps page
-        m_currentGuestServerIp.clear();
         m_guestServerWidget->configureServer(QString(), 0);
         m_guestServerAppsClient->setServerEndpoint(QString(), 0);
-        
-        // Start timer if we're on Desktop page and have a VM selected
-        if (hasVm && stackedWidget && stackedWidget->currentWidget() == desktopPage) {
-            if (!m_guestServerRefreshTimer->isActive()) {
-                m_guestServerRefreshTimer->start();
-            }
-            // Only log error if we have a VM selected and it's running but IP couldn't be resolved
-            QString state = vmStateByName.value(vmName).toLower();
-            bool isRunning = state.contains("run");
-            if (isRunning) {
-                qDebug() << "Could not resolve VM IP for guest server. VM:" << vmName << "Will retry...";
-            } else {
-                qDebug() << "VM not running. VM:" << vmName << "Waiting for VM to start...";
-            }
-        } else {
-            // Stop timer if not on Desktop page or no VM selected
-            if (m_guestServerRefreshTimer->isActive()) {
-                m_guestServerRefreshTimer->stop();
-            }
-            // Only log if VM is selected but we're not on the right page
-            if (hasVm) {
-                qDebug() << "VM selected but not on Desktop page. VM:" << vmName;
-            }
-        }
+        qDebug() << "Guest server endpoint cleared. VM:" << vmName << m_readiness->stage(vmName);
     }
 }
 
@@ -982,16 +1030,10 @@ void MainWindow::refreshAppsList()
         return;
     }
     
-    // Only fetch if we have a valid endpoint and we're on All Apps page
-    if (!m_currentGuestServerIp.isEmpty() && 
-        stackedWidget && 
-        stackedWidget->currentWidget() == allProgramsPage) {
+    // Revalidate in the background whenever the guest is reachable. Without
+    // it the cached catalog stays on screen, marked stale by the client.
+    if (!m_currentGuestServerIp.isEmpty()) {
         m_guestServerAppsClient->fetchApps();
-    } else {
-        // Clear apps list if no endpoint or not on All Apps page
-        if (stackedWidget && stackedWidget->currentWidget() == allProgramsPage) {
-            m_appsListWidget->clear();
-        }
     }
 }
 
@@ -1020,76 +1062,59 @@ QString MainWindow::findLibvirtManager() const
     return QString();
 }
 
-bool MainWindow::runLibvirtCommand(const QStringList &args, QString *out, QString *err, int timeoutMs)
+void MainWindow::onVmOperationFinished(const QString &vm, VmOperationQueue::Operation operation,
+                                       bool ok, const QString &error)
 {
-    QString prog = findLibvirtManager();
-    if (prog.isEmpty()) {
-        if (err) *err = "libvirt_rdp_manager not found";
-        return false;
+    if (!ok) {
+        qWarning() << "VM operation" << VmOperationQueue::operationText(operation)
+                   << "failed for" << vm << ":" << error;
     }
-
-    QProcess p;
-    p.setProgram(prog);
-    p.setArguments(args);
-    p.start();
-    if (!p.waitForFinished(timeoutMs)) {
-        if (err) *err = "timeout";
-        p.kill();
-        return false;
+    // Lifecycle events report later transitions; re-read once now in case
+    // the state already changed
+    onDomainLifecycleChanged(vm, LibvirtSession::DomainOtherEvent);
+    // A reboot keeps the domain running, so no lifecycle event restarts
+    // the readiness pipeline for it
+    if (operation == VmOperationQueue::Reboot && ok) {
+        m_readiness->restart(vm);
+    }
+    if (vm == currentVmName()) {
+        updateVmControls();
+        refreshGuestServerEndpoint();
     }
-    if (out) *out = QString::fromLocal8Bit(p.readAllStandardOutput());
-    if (err) *err = QString::fromLocal8Bit(p.readAllStandardError());
-    return p.exitStatus() == QProcess::NormalExit && p.exitCode() == 0;
 }
 
 void MainWindow::onVmStart()
 {
-    QString vm = vmCombo ? vmCombo->currentText() : QString();
-    if (vm.isEmpty() || vm == "---------") return;
-    QString out, err;
-    if (!runLibvirtCommand({"start", vm}, &out, &err)) {
-        qWarning() << "Start failed:" << err;
-    }
-    refreshVMList();
-    updateVmControls();
-    // Refresh guest server endpoint after VM starts (with a small delay for network to initialize)
-    QTimer::singleShot(3000, this, &MainWindow::refreshGuestServerEndpoint);
+    m_vmOperations->request(currentVmName(), VmOperationQueue::Start);
 }
 
 void MainWindow::onVmStop()
 {
-    QString vm = vmCombo ? vmCombo->currentText() : QString();
-    if (vm.isEmpty() || vm == "---------") return;
-    QString out, err;
-    if (!runLibvirtCommand({"stop", vm}, &out, &err)) {
-        qWarning() << "Stop failed:" << err;
+    // A second click while the guest is shutting down forces it off
+    QString vm = currentVmName();
+    if (m_vmOperations->canEscalate(vm)) {
+        m_vmOperations->escalate(vm);
+    } else {
+        m_vmOperations->request(vm, VmOperationQueue::Shutdown);
     }
-    refreshVMList();
-    updateVmControls();
-    // Clear guest server endpoint when VM stops
-    refreshGuestServerEndpoint();
 }
 
 void MainWindow::onVmRestart()
 {
-    QString vm = vmCombo ? vmCombo->currentText() : QString();
-    if (vm.isEmpty() || vm == "---------") return;
-    QString out, err;
-    if (!runLibvirtCommand({"restart", vm}, &out, &err)) {
-        qWarning() << "Restart failed:" << err;
-    }
-    refreshVMList();
-    updateVmControls();
-    // Refresh guest server endpoint after VM restarts (with a delay for network to initialize)
-    QTimer::singleShot(5000, this, &MainWindow::refreshGuestServerEndpoint);
+    m_vmOperations->request(currentVmName(), VmOperationQueue::Reboot);
+}
+
+void MainWindow::onVmCancelOperation()
+{
+    m_vmOperations->cancel(currentVmName());
 }
 
 void MainWindow::onVmConnect()
 {
-    QString vm = vmCombo ? vmCombo->currentText() : QString();
-    if (vm.isEmpty() || vm == "---------") return;
+    QString vm = currentVmName();
+    if (vm.isEmpty()) return;
     // Prompt for credentials and port, show detected IP
-    ConnectDialog dlg(vm, this);
+    ConnectDialog dlg(vm, m_addressResolver, this);
     // Position near the button
     QPoint btnPos = vmConnectBtn->mapToGlobal(QPoint(0, vmConnectBtn->height()+8));
     dlg.move(btnPos);
@@ -1107,8 +1132,28 @@ void MainWindow::onVmConnect()
     QProcess::startDetached(prog, args);
 }
 
-void MainWindow::onVmSelectionChanged(int)
+void MainWindow::onVmSelectionChanged(int index)
+{
+    selectVm(index < 0 ? QString() : vmCombo->itemText(index));
+}
+
+void MainWindow::selectVm(const QString &vmName)
 {
+    // Row moves (another VM added or removed) keep the same selection
+    if (vmName == m_selectedVm) {
+        return;
+    }
+    m_readiness->forget(m_selectedVm);
+    m_selectedVm = vmName;
+    if (vmCombo && vmCombo->currentIndex() != m_vmModel->rowOf(vmName)) {
+        vmCombo->setCurrentIndex(m_vmModel->rowOf(vmName));
+    }
+
+    // Show the new VM's last known apps at once; they are revalidated when
+    // its guest server becomes ready
+    const VmDomain domain = m_vmModel->domain(vmName);
+    m_guestServerAppsClient->setCatalog(domain.uuid.isEmpty() ? vmName : domain.uuid);
+
     updateVmControls();
     refreshGuestServerEndpoint();
 }
@@ -1148,15 +1193,9 @@ void MainWindow::setupAboutPage()
     layout->addStretch();
 }
 
-void MainWindow::onAppsReceived(const QList<InstalledApp> &apps)
+void MainWindow::onAppsReceived(const QString &catalogId, const QList<InstalledApp> &apps)
 {
-    // When apps are received on All Programs page, stop scanning
-    // but keep the system monitor running on Desktop page
-    if (stackedWidget && stackedWidget->currentWidget() == allProgramsPage) {
-        // Stop the guest server refresh timer when apps are successfully received
-        if (m_guestServerRefreshTimer && m_guestServerRefreshTimer->isActive()) {
-            m_guestServerRefreshTimer->stop();
-            qDebug() << "Apps received on All Programs page. Stopped scanning. Total apps:" << apps.size();
-        }
-    }
+    // Apps are only fetched when the endpoint changes, so there is no
+    // scanning left to stop here
+    qDebug() << "Apps received for catalog" << catalogId << "Total apps:" << apps.size();
 }
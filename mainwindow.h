@@ -13,16 +13,23 @@
 #include <QStackedWidget>
 #include <QComboBox>
 #include <QMap>
+#include <QHash>
 #include <QProcess>
-#include <QTabWidget>
 #include <QTimer>
 #include <QScrollArea>
+#include <QPointer>
+#include "asynctask.h"
+#include "libvirtsession.h"
+#include "vmlistmodel.h"
+#include "vmoperationqueue.h"
 #include "guestserverwidget.h"
 #include "guestserverappsclient.h"
 #include "appslistwidget.h"
 
 // Forward declaration
 class AddProgramDialog;
+class GuestAddressResolver;
+class GuestReadiness;
 
 class MainWindow : public QMainWindow
 {
@@ -32,15 +39,28 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private:
     void setupUI();
     void setupSidebar();
     void setupMainContent();
     void refreshVMList();
+    void applyVmList(const QList<VmDomain> &domains);
+    // Keeps the last good list, flagged, and retries on the reconnect timer
+    void markVmListStale();
+    void applyDomainUpdate(const QString &name, const VmDomain &domain);
+    QString currentVmName() const;
+    void selectVm(const QString &vmName);
+    void ensureVmSelected();
+    // Builds the page with setup the first time, then shows it
+    void showPage(QWidget *&page, void (MainWindow::*setup)());
+    void startDeferredWork();
     void updateVmControls();
     QString findLibvirtManager() const;
-    bool runLibvirtCommand(const QStringList &args, QString *out = nullptr, QString *err = nullptr, int timeoutMs = 15000);
     void refreshGuestServerEndpoint();
+    void applyGuestServerEndpoint(const QString &vmName, const QString &ip);
     void refreshAppsList();
     
     // Main widgets
@@ -77,20 +97,30 @@ private:
     QPushButton *vmStartBtn;
     QPushButton *vmStopBtn;
     QPushButton *vmRestartBtn;
+    QPushButton *vmCancelBtn;
     QPushButton *vmConnectBtn;
     QPushButton *guestServerBtn;
-    QMap<QString, QString> vmStateByName;
+    QString m_selectedVm;
     QProcess *rdpProcess;
     
     // Guest Server
     GuestServerWidget *m_guestServerWidget;
     GuestServerAppsClient *m_guestServerAppsClient;
     AppsListWidget *m_appsListWidget;
-    QTabWidget *m_tabWidget;
     QString m_currentGuestServerIp;
-    QTimer *m_guestServerRefreshTimer;
     QTimer *m_vmListRefreshTimer;
     
+    // Background libvirt work
+    TaskQueue *m_taskQueue;
+    LibvirtSession *m_libvirt;
+    VmListModel *m_vmModel;
+    GuestAddressResolver *m_addressResolver;
+    GuestReadiness *m_readiness;
+    VmOperationQueue *m_vmOperations;
+    QPointer<AsyncTask> m_vmListTask;
+    QHash<QString, quint64> m_domainUpdateSequence;
+    bool m_vmListSeen;     // First listing finished, successfully or not
+    
     // All Programs Page
     QVBoxLayout *allProgramsLayout;
     QLabel *logoLabel;
@@ -102,7 +132,6 @@ private:
     QString sidebarStyle;
     QString headerStyle;
     QString navButtonStyle;
-    QString addButtonStyle;
     
 private:
     void setupDesktopPage();
@@ -121,9 +150,13 @@ private slots:
     void onVmStop();
     void onVmRestart();
     void onVmConnect();
+    void onVmCancelOperation();
+    void onVmOperationFinished(const QString &vm, VmOperationQueue::Operation operation,
+                               bool ok, const QString &error);
     void onConnectToGuestServer();
     void onVmSelectionChanged(int index);
-    void onAppsReceived(const QList<InstalledApp> &apps);
+    void onDomainLifecycleChanged(const QString &name, LibvirtSession::LifecycleEvent event);
+    void onAppsReceived(const QString &catalogId, const QList<InstalledApp> &apps);
     
 private:
     AddProgramDialog *addProgramDialog;
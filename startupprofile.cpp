@@ -0,0 +1,65 @@
+#include "startupprofile.h"
+#include <QElapsedTimer>
+#include <QPair>
+#include <QVector>
+#include <QDebug>
+#include <utility>
+
+namespace {
+struct Profile {
+    bool enabled = false;
+    bool reported = false;
+    QElapsedTimer clock;
+    QVector<QPair<QString, qint64>> marks;  // Phase, ns since start
+};
+
+Profile &profile()
+{
+    static Profile instance;
+    return instance;
+}
+} // namespace
+
+void StartupProfile::start(bool enabled)
+{
+    Profile &p = profile();
+    p.enabled = enabled;
+    p.clock.start();
+}
+
+bool StartupProfile::isEnabled()
+{
+    return profile().enabled;
+}
+
+qint64 StartupProfile::elapsedMs()
+{
+    return profile().clock.isValid() ? profile().clock.elapsed() : 0;
+}
+
+void StartupProfile::mark(const QString &phase)
+{
+    Profile &p = profile();
+    if (p.enabled && !p.reported) {
+        p.marks.append(qMakePair(phase, p.clock.nsecsElapsed()));
+    }
+}
+
+void StartupProfile::report()
+{
+    Profile &p = profile();
+    if (!p.enabled || p.reported) {
+        return;
+    }
+    p.reported = true;
+
+    qInfo().noquote() << "Startup profile:";
+    qint64 previous = 0;
+    for (const auto &mark : std::as_const(p.marks)) {
+        qInfo().noquote() << QStringLiteral("  %1 ms  (+%2 ms)  %3")
+                                 .arg(mark.second / 1.0e6, 8, 'f', 1)
+                                 .arg((mark.second - previous) / 1.0e6, 7, 'f', 1)
+                                 .arg(mark.first);
+        previous = mark.second;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+#include <QString>
+
+// Timestamps of startup phases, printed as one report when the application
+// runs with --startup-profile. Marks cost next to nothing when disabled.
+class StartupProfile
+{
+public:
+    // Call first thing in main(); times are relative to this call
+    static void start(bool enabled);
+    static bool isEnabled();
+    static qint64 elapsedMs();
+
+    static void mark(const QString &phase);
+    // Prints the phases marked so far; later marks are ignored
+    static void report();
+
+    // Budget for the window's first frame
+    static constexpr int kFirstFrameTargetMs = 150;
+};
+
+#endif // STARTUPPROFILE_H
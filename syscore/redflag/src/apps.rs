@@ -13,6 +13,10 @@ pub struct InstalledApp {
     pub display_version: String,
     pub icon_path: Option<String>,
     pub uninstall_string: Option<String>,
+    /// Changes whenever the icon source changes; filled in when the list is
+    /// served, so clients can keep icons they already have
+    #[serde(default, skip_serializing_if = "Option::is_none")]
+    pub icon_stamp: Option<String>,
 }
 
 #[derive(Serialize, Deserialize, Clone)]
@@ -540,6 +544,7 @@ fn extract_app_from_exe(exe_path: &str) -> Option<InstalledApp> {
         display_version: String::new(),
         icon_path: Some(exe_path.to_string()),
         uninstall_string: None,
+        icon_stamp: None,
     })
 }
 
@@ -859,6 +864,7 @@ fn extract_app_from_shortcut(lnk_path: &str) -> Option<InstalledApp> {
             display_version: String::new(),
             icon_path: final_icon_path,
             uninstall_string: None,
+            icon_stamp: None,
         });
     }
     
@@ -870,6 +876,7 @@ fn extract_app_from_shortcut(lnk_path: &str) -> Option<InstalledApp> {
         display_version: String::new(),
         icon_path,
         uninstall_string: None,
+        icon_stamp: None,
     })
 }
 
@@ -960,6 +967,7 @@ fn extract_app_info(key: &RegKey) -> Option<InstalledApp> {
         display_version,
         icon_path,
         uninstall_string,
+        icon_stamp: None,
     })
 }
 
@@ -1328,6 +1336,24 @@ fn get_shortcut_target(lnk_path: &str) -> Option<String> {
     None
 }
 
+/// Modification stamp of an icon source (mtime and size), used as its ETag
+pub fn icon_stamp(path: &str) -> Option<String> {
+    let metadata = std::fs::metadata(path).ok()?;
+    let modified = metadata
+        .modified()
+        .ok()?
+        .duration_since(std::time::UNIX_EPOCH)
+        .ok()?;
+    Some(format!("{:x}-{:x}", modified.as_secs(), metadata.len()))
+}
+
+/// Fill in the current icon stamps of a (possibly cached) app list
+pub fn stamp_icons(response: &mut AppsResponse) {
+    for app in &mut response.apps {
+        app.icon_stamp = app.icon_path.as_deref().and_then(icon_stamp);
+    }
+}
+
 /// Extract icon from executable and return as base64
 pub fn extract_icon_base64(exe_path: &str) -> Result<String> {
     use std::process::Command;
@@ -1408,6 +1434,16 @@ pub fn extract_icon_base64(exe_path: &str) -> Result<String> {
     Err(anyhow::anyhow!("Failed to extract icon from {}", exe_path))
 }
 
+/// Extract icon from executable as raw PNG bytes
+pub fn extract_icon_png(exe_path: &str) -> Result<Vec<u8>> {
+    use base64::Engine as _;
+
+    let encoded = extract_icon_base64(exe_path)?;
+    base64::engine::general_purpose::STANDARD
+        .decode(encoded.as_bytes())
+        .context("PowerShell returned invalid base64")
+}
+
 /// PowerShell script output structure
 #[derive(Deserialize, Debug)]
 struct PowerShellApp {
@@ -1527,6 +1563,7 @@ fn scan_powershell_apps(apps: &mut Vec<InstalledApp>, _seen_names: &mut std::col
             display_version: String::new(),
             icon_path,
             uninstall_string: None,
+            icon_stamp: None,
         };
 
         apps.push(app);
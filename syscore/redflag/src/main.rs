@@ -3,11 +3,48 @@ mod apps;
 mod cache;
 
 use actix_cors::Cors;
-use actix_web::{get, post, middleware::Logger, web, App, HttpResponse, HttpServer, Responder};
+use actix_web::{get, post, http::header, middleware::{Compress, Logger}, web, App, HttpRequest, HttpResponse, HttpResponseBuilder, HttpServer, Responder};
+use futures_util::stream::{self, StreamExt};
 use serde_json::json;
 use std::sync::{Arc, Mutex};
+use std::time::Duration;
 
 const SERVER_VERSION: &str = env!("CARGO_PKG_VERSION");
+const ICON_BATCH_MAX_PATHS: usize = 256;
+const ICON_BATCH_CONCURRENCY: usize = 4;
+const CBOR_CONTENT_TYPE: &str = "application/cbor";
+/// Optional features announced in /version, so clients know what to ask for.
+/// Compression needs no entry: it is negotiated through Accept-Encoding.
+const CAPABILITIES: &[&str] = &["cbor", "h2c", "metrics-stream"];
+const METRICS_STREAM_DEFAULT_MS: u64 = 1000;
+const METRICS_STREAM_MIN_MS: u64 = 250;
+const METRICS_STREAM_MAX_MS: u64 = 10_000;
+
+/// Whether the client listed CBOR in its Accept header. Older clients do not
+/// and keep getting JSON.
+fn wants_cbor(req: &HttpRequest) -> bool {
+    req.headers()
+        .get(header::ACCEPT)
+        .and_then(|value| value.to_str().ok())
+        .map(|accept| {
+            accept
+                .split(',')
+                .any(|media| media.split(';').next().map(str::trim) == Some(CBOR_CONTENT_TYPE))
+        })
+        .unwrap_or(false)
+}
+
+/// Sends value as CBOR if the client asked for it, as JSON otherwise
+fn negotiated<T: serde::Serialize>(req: &HttpRequest, mut response: HttpResponseBuilder, value: &T) -> HttpResponse {
+    if wants_cbor(req) {
+        let mut body = Vec::new();
+        match ciborium::into_writer(value, &mut body) {
+            Ok(()) => return response.content_type(CBOR_CONTENT_TYPE).body(body),
+            Err(err) => log::warn!("CBOR encoding failed, sending JSON: {}", err),
+        }
+    }
+    response.json(value)
+}
 
 #[get("/health")]
 async fn health_handler() -> impl Responder {
@@ -20,26 +57,78 @@ async fn version_handler() -> impl Responder {
         "version": SERVER_VERSION,
         "commit_hash": option_env!("GIT_COMMIT_HASH").unwrap_or("n/a"),
         "build_time": option_env!("BUILD_TIMESTAMP").unwrap_or("n/a"),
+        "capabilities": CAPABILITIES,
     }))
 }
 
-async fn metrics_handler() -> impl Responder {
+async fn metrics_handler(req: HttpRequest) -> impl Responder {
     match metrics::collect_metrics() {
-        Ok(metrics) => HttpResponse::Ok().json(metrics),
+        Ok(metrics) => negotiated(&req, HttpResponse::Ok(), &metrics),
         Err(err) => HttpResponse::InternalServerError().json(json!({
             "error": err.to_string()
         })),
     }
 }
 
+#[derive(serde::Deserialize)]
+struct MetricsStreamQuery {
+    interval_ms: Option<u64>,
+}
+
+/// Pushes a metrics sample every interval_ms as one JSON object per line, for
+/// as long as the client stays connected. A sample that cannot be taken is
+/// sent as {"error": ...} and the stream goes on.
+#[get("/metrics/stream")]
+async fn metrics_stream_handler(query: web::Query<MetricsStreamQuery>) -> impl Responder {
+    let interval = Duration::from_millis(
+        query
+            .interval_ms
+            .unwrap_or(METRICS_STREAM_DEFAULT_MS)
+            .clamp(METRICS_STREAM_MIN_MS, METRICS_STREAM_MAX_MS),
+    );
+
+    // The sampler is created on the blocking pool with the first sample
+    let samples = stream::unfold(None, move |sampler: Option<metrics::Sampler>| async move {
+        if sampler.is_some() {
+            actix_web::rt::time::sleep(interval).await;
+        }
+        let taken = web::block(move || {
+            let mut sampler = sampler.unwrap_or_else(metrics::Sampler::new);
+            let sample = sampler.sample();
+            (sampler, sample)
+        })
+        .await;
+        let (sampler, sample) = match taken {
+            Ok(taken) => taken,
+            Err(err) => {
+                log::error!("Metrics sampling did not run: {}", err);
+                return None;
+            }
+        };
+        let mut line = match sample {
+            Ok(metrics) => serde_json::to_vec(&metrics).unwrap_or_default(),
+            Err(err) => json!({ "error": err.to_string() }).to_string().into_bytes(),
+        };
+        line.push(b'\n');
+        Some((Ok::<_, actix_web::Error>(web::Bytes::from(line)), Some(sampler)))
+    });
+
+    // Compression would hold samples back until its buffer fills
+    HttpResponse::Ok()
+        .content_type("application/x-ndjson")
+        .insert_header(header::ContentEncoding::Identity)
+        .insert_header(header::CacheControl(vec![header::CacheDirective::NoCache]))
+        .streaming(samples)
+}
+
 #[get("/apps")]
-async fn apps_handler(cache: web::Data<Arc<Mutex<cache::AppsCache>>>) -> impl Responder {
-    let cache = cache.lock().unwrap();
-    match cache.get_apps() {
-        Ok(apps_response) => {
-            HttpResponse::Ok()
-                .content_type("application/json; charset=utf-8")
-                .json(apps_response)
+async fn apps_handler(req: HttpRequest, cache: web::Data<Arc<Mutex<cache::AppsCache>>>) -> impl Responder {
+    let apps = cache.lock().unwrap().get_apps();
+    match apps {
+        Ok(mut apps_response) => {
+            // Stamps are taken per request: the list itself may be old
+            apps::stamp_icons(&mut apps_response);
+            negotiated(&req, HttpResponse::Ok(), &apps_response)
         }
         Err(err) => {
             log::error!("Failed to get cached apps: {}", err);
@@ -51,7 +140,7 @@ async fn apps_handler(cache: web::Data<Arc<Mutex<cache::AppsCache>>>) -> impl Re
 }
 
 #[post("/get-icon")]
-async fn get_icon_handler(form: web::Form<IconRequest>) -> impl Responder {
+async fn get_icon_handler(req: HttpRequest, form: web::Form<IconRequest>) -> impl Responder {
     let path = form.path.as_str();
     
     if path.is_empty() {
@@ -60,9 +149,28 @@ async fn get_icon_handler(form: web::Form<IconRequest>) -> impl Responder {
         }));
     }
 
+    // The icon stamp doubles as ETag, so unchanged icons are not extracted
+    // and sent again
+    let stamp = apps::icon_stamp(path);
+    if let Some(ref stamp) = stamp {
+        let if_none_match = req
+            .headers()
+            .get(header::IF_NONE_MATCH)
+            .and_then(|value| value.to_str().ok());
+        if if_none_match.map(|value| value.trim_matches('"')) == Some(stamp.as_str()) {
+            return HttpResponse::NotModified()
+                .insert_header((header::ETAG, format!("\"{}\"", stamp)))
+                .finish();
+        }
+    }
+
     match apps::extract_icon_base64(path) {
         Ok(base64_icon) => {
-            HttpResponse::Ok()
+            let mut response = HttpResponse::Ok();
+            if let Some(stamp) = stamp {
+                response.insert_header((header::ETAG, format!("\"{}\"", stamp)));
+            }
+            response
                 .content_type("text/plain; charset=utf-8")
                 .body(base64_icon)
         }
@@ -80,6 +188,57 @@ struct IconRequest {
     path: String,
 }
 
+#[derive(serde::Deserialize)]
+struct IconBatchRequest {
+    paths: Vec<String>,
+}
+
+/// Streams raw PNG icons in the order they finish extracting. Each frame is
+/// `u32 path length, path (UTF-8), u32 data length, PNG bytes`, big endian;
+/// a data length of 0 means no icon could be extracted for that path.
+#[post("/get-icons")]
+async fn get_icons_handler(body: web::Json<IconBatchRequest>) -> impl Responder {
+    let paths = body.into_inner().paths;
+    if paths.is_empty() || paths.len() > ICON_BATCH_MAX_PATHS {
+        return HttpResponse::BadRequest().json(json!({
+            "error": format!("between 1 and {} paths are required", ICON_BATCH_MAX_PATHS)
+        }));
+    }
+
+    let frames = stream::iter(paths)
+        .map(|path| async move {
+            let lookup = path.clone();
+            let png = match web::block(move || apps::extract_icon_png(&lookup)).await {
+                Ok(Ok(png)) => png,
+                Ok(Err(err)) => {
+                    log::warn!("Failed to extract icon from {}: {}", path, err);
+                    Vec::new()
+                }
+                Err(err) => {
+                    log::error!("Icon extraction for {} did not run: {}", path, err);
+                    Vec::new()
+                }
+            };
+            Ok::<_, actix_web::Error>(icon_frame(&path, &png))
+        })
+        .buffer_unordered(ICON_BATCH_CONCURRENCY);
+
+    // PNG data does not compress; spare the CPU
+    HttpResponse::Ok()
+        .content_type("application/octet-stream")
+        .insert_header(header::ContentEncoding::Identity)
+        .streaming(frames)
+}
+
+fn icon_frame(path: &str, png: &[u8]) -> web::Bytes {
+    let mut frame = Vec::with_capacity(8 + path.len() + png.len());
+    frame.extend_from_slice(&(path.len() as u32).to_be_bytes());
+    frame.extend_from_slice(path.as_bytes());
+    frame.extend_from_slice(&(png.len() as u32).to_be_bytes());
+    frame.extend_from_slice(png);
+    web::Bytes::from(frame)
+}
+
 #[actix_web::main]
 async fn main() -> std::io::Result<()> {
     env_logger::init();
@@ -113,6 +272,7 @@ async fn main() -> std::io::Result<()> {
     HttpServer::new(move || {
         App::new()
             .app_data(cache_data.clone())
+            .wrap(Compress::default())
             .wrap(Logger::default())
             .wrap(
                 Cors::default()
@@ -124,9 +284,12 @@ async fn main() -> std::io::Result<()> {
             .service(version_handler)
             .service(apps_handler)
             .service(get_icon_handler)
+            .service(get_icons_handler)
+            .service(metrics_stream_handler)
             .route("/metrics", web::get().to(metrics_handler))
     })
-    .bind(("0.0.0.0", 7148))?
+    // HTTP/1.1 and prior-knowledge HTTP/2 (h2c) on the same port
+    .bind_auto_h2c(("0.0.0.0", 7148))?
     .run()
     .await
 }
@@ -2,6 +2,10 @@ use serde::Serialize;
 use sysinfo::{CpuExt, DiskExt, System, SystemExt};
 
 use anyhow::{anyhow, Result};
+use std::time::{Duration, Instant};
+
+/// CPU usage is measured between two refreshes at least this far apart
+const CPU_SAMPLE_TIME: Duration = Duration::from_millis(250);
 
 #[derive(Serialize)]
 pub struct CpuMetrics {
@@ -31,14 +35,41 @@ pub struct Metrics {
 }
 
 pub fn collect_metrics() -> Result<Metrics> {
-    let mut sys = System::new_all();
-    sys.refresh_memory();
-    sys.refresh_disks_list();
-    sys.refresh_disks();
-    sys.refresh_cpu();
-    std::thread::sleep(std::time::Duration::from_millis(250));
-    sys.refresh_cpu();
+    Sampler::new().sample()
+}
+
+/// Keeps the system state between samples, so a stream of samples measures
+/// CPU usage over the time since the previous one instead of sleeping for
+/// each. Only the first sample waits CPU_SAMPLE_TIME.
+pub struct Sampler {
+    sys: System,
+    cpu_refreshed: Instant,
+}
+
+impl Sampler {
+    pub fn new() -> Self {
+        let mut sys = System::new_all();
+        sys.refresh_cpu();
+        Sampler {
+            sys,
+            cpu_refreshed: Instant::now(),
+        }
+    }
+
+    pub fn sample(&mut self) -> Result<Metrics> {
+        let since = self.cpu_refreshed.elapsed();
+        if since < CPU_SAMPLE_TIME {
+            std::thread::sleep(CPU_SAMPLE_TIME - since);
+        }
+        self.sys.refresh_cpu();
+        self.cpu_refreshed = Instant::now();
+        self.sys.refresh_memory();
+        self.sys.refresh_disks();
+        metrics_from(&self.sys)
+    }
+}
 
+fn metrics_from(sys: &System) -> Result<Metrics> {
     let cpu = sys.global_cpu_info();
     let cpu_usage = cpu.cpu_usage() as f64;
     let cpu_freq = cpu.frequency() as u64; // MHz
@@ -0,0 +1,205 @@
+#include "redflagstandin.h"
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QDebug>
+
+namespace {
+QByteArray reasonPhrase(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "Status";
+    }
+}
+} // namespace
+
+RedflagStandIn::RedflagStandIn(QObject *parent)
+    : QObject(parent)
+    , m_server(new QTcpServer(this))
+    , m_versioned(false)
+{
+    connect(m_server, &QTcpServer::newConnection, this, &RedflagStandIn::onNewConnection);
+    if (!m_server->listen(QHostAddress::LocalHost)) {
+        qWarning() << "Stand-in server could not listen:" << m_server->errorString();
+    }
+}
+
+RedflagStandIn::~RedflagStandIn()
+{
+    closeAll();
+}
+
+QString RedflagStandIn::host() const
+{
+    return QStringLiteral("127.0.0.1");
+}
+
+quint16 RedflagStandIn::port() const
+{
+    return m_server->serverPort();
+}
+
+QUrl RedflagStandIn::url(const QString &path) const
+{
+    return QUrl(QStringLiteral("http://%1:%2%3").arg(host()).arg(port()).arg(path));
+}
+
+void RedflagStandIn::setCapabilities(const QStringList &capabilities)
+{
+    m_capabilities = capabilities;
+    m_versioned = true;
+}
+
+void RedflagStandIn::route(const QString &path, Handler handler)
+{
+    m_routes.insert(path, std::move(handler));
+}
+
+QList<RedflagStandIn::Request> RedflagStandIn::requests(const QString &path) const
+{
+    QList<Request> matching;
+    for (const Request &request : m_requests) {
+        if (request.path == path) {
+            matching.append(request);
+        }
+    }
+    return matching;
+}
+
+void RedflagStandIn::closeAll()
+{
+    const QList<QTcpSocket *> sockets = m_buffers.keys();
+    for (QTcpSocket *socket : sockets) {
+        socket->abort();
+    }
+}
+
+void RedflagStandIn::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            onReadyRead(socket);
+        });
+        // Deleted later, so a socket is never freed while a request on it
+        // is being answered
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QObject::destroyed, this, [this, socket]() {
+            m_buffers.remove(socket);
+            m_streaming.remove(socket);
+        });
+    }
+}
+
+void RedflagStandIn::onReadyRead(QTcpSocket *socket)
+{
+    m_buffers[socket].append(socket->readAll());
+    // Requests on a connection come one after another
+    while (!m_streaming.contains(socket)) {
+        QByteArray &buffer = m_buffers[socket];
+        const int headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            return;
+        }
+
+        Request request;
+        const QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+        const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+        if (requestLine.size() < 2) {
+            socket->abort();
+            return;
+        }
+        request.method = requestLine.at(0);
+        const QUrl target(QString::fromLatin1(requestLine.at(1)));
+        request.path = target.path();
+        request.query = QUrlQuery(target);
+        for (int i = 1; i < lines.size(); ++i) {
+            const int colon = lines.at(i).indexOf(':');
+            if (colon > 0) {
+                request.headers.insert(lines.at(i).left(colon).trimmed().toLower(),
+                                       lines.at(i).mid(colon + 1).trimmed());
+            }
+        }
+
+        const int length = request.headers.value("content-length").toInt();
+        if (buffer.size() < headerEnd + 4 + length) {
+            return;
+        }
+        request.body = buffer.mid(headerEnd + 4, length);
+        buffer.remove(0, headerEnd + 4 + length);
+
+        m_requests.append(request);
+        respond(socket, request);
+    }
+}
+
+void RedflagStandIn::respond(QTcpSocket *socket, const Request &request)
+{
+    Reply reply;
+    auto handler = m_routes.constFind(request.path);
+    if (handler != m_routes.constEnd()) {
+        reply = (*handler)(request);
+    } else if (request.path == QLatin1String("/version") && m_versioned) {
+        QJsonObject version;
+        version["version"] = QStringLiteral("stand-in");
+        version["capabilities"] = QJsonArray::fromStringList(m_capabilities);
+        reply.body = QJsonDocument(version).toJson(QJsonDocument::Compact);
+    } else {
+        reply.status = 404;
+        reply.contentType = "text/plain";
+        reply.body = "not found";
+    }
+
+    QByteArray head = "HTTP/1.1 " + QByteArray::number(reply.status) + ' ' + reasonPhrase(reply.status) + "\r\n";
+    head += "Content-Type: " + reply.contentType + "\r\n";
+    if (!reply.chunks.isEmpty() || reply.keepOpen) {
+        head += "Transfer-Encoding: chunked\r\n\r\n";
+        socket->write(head);
+        m_streaming.insert(socket);
+        writeChunks(socket, reply.chunks, reply.chunkIntervalMs, reply.keepOpen);
+        return;
+    }
+    head += "Content-Length: " + QByteArray::number(reply.body.size()) + "\r\n\r\n";
+    socket->write(head + reply.body);
+}
+
+void RedflagStandIn::writeChunks(QTcpSocket *socket, QList<QByteArray> chunks, int intervalMs, bool keepOpen)
+{
+    if (chunks.isEmpty()) {
+        if (!keepOpen) {
+            socket->write("0\r\n\r\n");
+            m_streaming.remove(socket);
+            // Serve whatever the client sent meanwhile
+            if (!m_buffers.value(socket).isEmpty()) {
+                QTimer::singleShot(0, socket, [this, socket]() {
+                    onReadyRead(socket);
+                });
+            }
+        }
+        return;
+    }
+
+    // An empty chunk would end the reply
+    const QByteArray chunk = chunks.takeFirst();
+    if (!chunk.isEmpty()) {
+        socket->write(QByteArray::number(chunk.size(), 16) + "\r\n" + chunk + "\r\n");
+    }
+    QPointer<QTcpSocket> guard(socket);
+    QTimer::singleShot(intervalMs, this, [this, guard, chunks, intervalMs, keepOpen]() {
+        if (guard && guard->state() == QAbstractSocket::ConnectedState) {
+            writeChunks(guard, chunks, intervalMs, keepOpen);
+        }
+    });
+}
@@ -0,0 +1,81 @@
+#ifndef REDFLAGSTANDIN_H
+#define REDFLAGSTANDIN_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QStringList>
+#include <QUrl>
+#include <QUrlQuery>
+#include <functional>
+
+class QTcpServer;
+class QTcpSocket;
+
+// Minimal HTTP/1.1 server on localhost standing in for REDFLAG in tests.
+// Routes answer with a whole body, or with a chunked stream written a chunk
+// per interval. Connections are kept alive and every request is recorded.
+// /version lists the capabilities set here, or is missing like on builds
+// that predate it.
+class RedflagStandIn : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Request {
+        QByteArray method;
+        QString path;
+        QUrlQuery query;
+        QHash<QByteArray, QByteArray> headers;  // Names in lower case
+        QByteArray body;
+    };
+
+    struct Reply {
+        int status = 200;
+        QByteArray contentType = "application/json";
+        QByteArray body;
+        // Sent chunked instead of body, the first one right away. Unless
+        // keepOpen, the reply ends after the last one.
+        QList<QByteArray> chunks;
+        int chunkIntervalMs = 0;
+        bool keepOpen = false;
+    };
+
+    using Handler = std::function<Reply(const Request &request)>;
+
+    explicit RedflagStandIn(QObject *parent = nullptr);
+    ~RedflagStandIn();
+
+    QString host() const;
+    quint16 port() const;
+    QUrl url(const QString &path) const;
+
+    void setCapabilities(const QStringList &capabilities);
+    void route(const QString &path, Handler handler);
+
+    QList<Request> requests(const QString &path) const;
+    int requestCount(const QString &path) const { return int(requests(path).size()); }
+    // Streamed replies still being written or held open
+    int openStreams() const { return int(m_streaming.size()); }
+
+    // Drops every connection, as if REDFLAG died
+    void closeAll();
+
+private:
+    void onNewConnection();
+    void onReadyRead(QTcpSocket *socket);
+    void respond(QTcpSocket *socket, const Request &request);
+    void writeChunks(QTcpSocket *socket, QList<QByteArray> chunks, int intervalMs, bool keepOpen);
+
+    QTcpServer *m_server;
+    QHash<QString, Handler> m_routes;
+    QStringList m_capabilities;
+    bool m_versioned;
+    QList<Request> m_requests;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    QSet<QTcpSocket *> m_streaming;
+};
+
+#endif // REDFLAGSTANDIN_H
@@ -0,0 +1,183 @@
+#include "appsearchindex.h"
+#include <QtTest>
+#include <algorithm>
+
+namespace {
+InstalledApp app(const QString &name, const QString &publisher = QString(), const QString &location = QString())
+{
+    InstalledApp result;
+    result.name = name;
+    result.publisher = publisher;
+    result.installLocation = location;
+    return result;
+}
+
+QList<InstalledApp> catalog()
+{
+    return {
+        app(QStringLiteral("Xcode Helper"), QStringLiteral("Tools Inc.")),
+        app(QStringLiteral("Visual Studio Code"), QStringLiteral("Microsoft Corporation"),
+            QStringLiteral("C:\\Program Files\\Microsoft VS Code")),
+        app(QStringLiteral("Code Writer"), QStringLiteral("Writers Ltd.")),
+        app(QStringLiteral("Notepad++"), QStringLiteral("Notepad++ Team")),
+        app(QStringLiteral("Codec Pack"), QStringLiteral("Media Group")),
+        app(QStringLiteral("Code"), QStringLiteral("Editors Ltd.")),
+    };
+}
+
+// Names of the rows, in result order
+QStringList namesOf(const QList<InstalledApp> &apps, const QVector<int> &rows)
+{
+    QStringList names;
+    for (int row : rows) {
+        names.append(apps.at(row).name);
+    }
+    return names;
+}
+} // namespace
+
+class TestAppSearchIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ranksByMatchQuality();
+    void matchesLettersInOrder();
+    void toleratesTypos();
+    void matchesWordsAcrossFields();
+    void honoursLimitAndEmptyQuery();
+    void followsReorderedCatalog();
+    void dropsRemovedAndChangedApps();
+    void keepsDuplicatesWithoutGrowing();
+    void appendsRows();
+};
+
+void TestAppSearchIndex::ranksByMatchQuality()
+{
+    const QList<InstalledApp> apps = catalog();
+    AppSearchIndex index;
+    index.setApps(apps);
+
+    // Exact, then prefixes (shorter name first), word start, substring
+    QCOMPARE(namesOf(apps, index.search(QStringLiteral("code"))),
+             (QStringList{QStringLiteral("Code"), QStringLiteral("Codec Pack"), QStringLiteral("Code Writer"),
+                          QStringLiteral("Visual Studio Code"), QStringLiteral("Xcode Helper")}));
+    // Case does not matter
+    QCOMPARE(index.search(QStringLiteral("CODE")), index.search(QStringLiteral("code")));
+}
+
+void TestAppSearchIndex::matchesLettersInOrder()
+{
+    const QList<InstalledApp> apps = catalog();
+    AppSearchIndex index;
+    index.setApps(apps);
+
+    const QVector<int> rows = index.search(QStringLiteral("vscode"));
+    QVERIFY(!rows.isEmpty());
+    QCOMPARE(apps.at(rows.first()).name, QStringLiteral("Visual Studio Code"));
+}
+
+void TestAppSearchIndex::toleratesTypos()
+{
+    const QList<InstalledApp> apps = catalog();
+    AppSearchIndex index;
+    index.setApps(apps);
+
+    const QVector<int> rows = index.search(QStringLiteral("notpad"));
+    QVERIFY(!rows.isEmpty());
+    QCOMPARE(apps.at(rows.first()).name, QStringLiteral("Notepad++"));
+}
+
+void TestAppSearchIndex::matchesWordsAcrossFields()
+{
+    const QList<InstalledApp> apps = catalog();
+    AppSearchIndex index;
+    index.setApps(apps);
+
+    // One word from the publisher, one from the name
+    QCOMPARE(namesOf(apps, index.search(QStringLiteral("microsoft code"))),
+             QStringList{QStringLiteral("Visual Studio Code")});
+}
+
+void TestAppSearchIndex::honoursLimitAndEmptyQuery()
+{
+    AppSearchIndex index;
+    index.setApps(catalog());
+
+    QCOMPARE(int(index.search(QStringLiteral("code"), 2).size()), 2);
+    QVERIFY(index.search(QString()).isEmpty());
+    QVERIFY(index.search(QStringLiteral("   ")).isEmpty());
+}
+
+void TestAppSearchIndex::followsReorderedCatalog()
+{
+    QList<InstalledApp> apps = catalog();
+    AppSearchIndex index;
+    index.setApps(apps);
+    const int docs = index.docCount();
+
+    std::reverse(apps.begin(), apps.end());
+    index.setApps(apps);
+    QCOMPARE(namesOf(apps, index.search(QStringLiteral("notepad"))), QStringList{QStringLiteral("Notepad++")});
+    QCOMPARE(index.search(QStringLiteral("notepad")), QVector<int>{2});
+    // Nothing changed, so nothing was indexed again
+    QCOMPARE(index.docCount(), docs);
+}
+
+void TestAppSearchIndex::dropsRemovedAndChangedApps()
+{
+    QList<InstalledApp> apps = catalog();
+    AppSearchIndex index;
+    index.setApps(apps);
+
+    apps.removeAt(3);   // Notepad++
+    apps[0].publisher = QStringLiteral("Apple");
+    index.setApps(apps);
+    QCOMPARE(index.size(), int(apps.size()));
+    QVERIFY(index.search(QStringLiteral("notepad")).isEmpty());
+    QVERIFY(index.search(QStringLiteral("tools inc")).isEmpty());
+    QCOMPARE(namesOf(apps, index.search(QStringLiteral("xcode apple"))), QStringList{QStringLiteral("Xcode Helper")});
+    // Rows after the removed one moved up
+    QCOMPARE(index.search(QStringLiteral("codec")), QVector<int>{3});
+}
+
+void TestAppSearchIndex::keepsDuplicatesWithoutGrowing()
+{
+    // Two identical entries, e.g. per-user and per-machine registrations
+    QList<InstalledApp> apps = catalog();
+    apps.append(apps.at(3));
+    AppSearchIndex index;
+    index.setApps(apps);
+    const int docs = index.docCount();
+
+    for (int i = 0; i < 10; ++i) {
+        index.setApps(apps);
+    }
+    QCOMPARE(index.docCount(), docs);
+    QCOMPARE(index.size(), int(apps.size()));
+    QCOMPARE(index.search(QStringLiteral("notepad")), (QVector<int>{3, int(apps.size()) - 1}));
+
+    // Dropping one copy keeps the other
+    apps.removeLast();
+    index.setApps(apps);
+    QCOMPARE(index.search(QStringLiteral("notepad")), QVector<int>{3});
+}
+
+void TestAppSearchIndex::appendsRows()
+{
+    const QList<InstalledApp> apps = catalog();
+    AppSearchIndex index;
+    index.appendApps(apps.mid(0, 3), 0);
+    index.appendApps(apps.mid(3), 3);
+
+    QCOMPARE(index.size(), int(apps.size()));
+    QCOMPARE(index.search(QStringLiteral("codec")), QVector<int>{4});
+    // A later setApps with the same list indexes nothing again
+    const int docs = index.docCount();
+    index.setApps(apps);
+    QCOMPARE(index.docCount(), docs);
+}
+
+QTEST_GUILESS_MAIN(TestAppSearchIndex)
+
+#include "tst_appsearchindex.moc"
@@ -0,0 +1,204 @@
+#include "appsstreamdecoder.h"
+#include "guesthttppipeline.h"
+#include "guestserverappsclient.h"
+#include "redflagstandin.h"
+#include <QtTest>
+#include <QCborValue>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+// {"apps": [...]} with count apps; no icon paths, so no icons are fetched
+QJsonObject appsObject(int count)
+{
+    QJsonArray apps;
+    for (int i = 0; i < count; ++i) {
+        QJsonObject app;
+        app["name"] = QStringLiteral("Application %1").arg(i);
+        app["publisher"] = QStringLiteral("Publisher");
+        app["install_location"] = QStringLiteral("C:\\Program Files\\Application %1").arg(i);
+        app["display_version"] = QStringLiteral("1.0.%1").arg(i);
+        apps.append(app);
+    }
+    QJsonObject root;
+    root["apps"] = apps;
+    return root;
+}
+
+QByteArray appsJson(int count)
+{
+    return QJsonDocument(appsObject(count)).toJson(QJsonDocument::Compact);
+}
+
+QByteArray appsCbor(int count)
+{
+    return QCborValue::fromJsonValue(appsObject(count)).toCbor();
+}
+
+bool acceptsCbor(const RedflagStandIn::Request &request)
+{
+    return request.headers.value("accept").contains("application/cbor");
+}
+} // namespace
+
+// CBOR is asked for only from guests that list it in /version, and /apps is
+// decoded by what actually arrives.
+class TestFormatNegotiation : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void negotiatesCborWithCapableGuest();
+    void staysWithJsonWithoutVersion();
+    void decodesJsonFromCborGuest();
+    void sniffsFormatOfAppsStream();
+
+private:
+    // Fetches /apps and waits for the list
+    QList<InstalledApp> fetchApps();
+    GuestHttpPipeline::EndpointStats appsStats() const;
+
+    RedflagStandIn *m_guest = nullptr;
+    GuestServerAppsClient *m_client = nullptr;
+};
+
+void TestFormatNegotiation::initTestCase()
+{
+    // Keeps catalogs out of the real cache directory
+    QStandardPaths::setTestModeEnabled(true);
+    QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).removeRecursively();
+}
+
+void TestFormatNegotiation::init()
+{
+    // A new port per test, so no capabilities or stats carry over
+    m_guest = new RedflagStandIn(this);
+    QVERIFY(m_guest->port() != 0);
+    m_client = new GuestServerAppsClient(m_guest->host(), m_guest->port(), this);
+}
+
+void TestFormatNegotiation::cleanup()
+{
+    delete m_client;
+    m_client = nullptr;
+    delete m_guest;
+    m_guest = nullptr;
+}
+
+QList<InstalledApp> TestFormatNegotiation::fetchApps()
+{
+    // InstalledApp is no metatype, so no QSignalSpy
+    QList<InstalledApp> apps;
+    bool received = false;
+    const QMetaObject::Connection connection = connect(m_client, &GuestServerAppsClient::appsReceived, this,
+                                                       [&apps, &received](const QString &, const QList<InstalledApp> &list) {
+        apps = list;
+        received = true;
+    });
+    m_client->fetchApps();
+    QTest::qWaitFor([&received]() { return received; }, 5000);
+    disconnect(connection);
+    return apps;
+}
+
+GuestHttpPipeline::EndpointStats TestFormatNegotiation::appsStats() const
+{
+    return GuestHttpPipeline::shared()->stats(QStringLiteral("%1:%2/apps").arg(m_guest->host()).arg(m_guest->port()));
+}
+
+void TestFormatNegotiation::negotiatesCborWithCapableGuest()
+{
+    m_guest->setCapabilities({QStringLiteral("cbor")});
+    m_guest->route(QStringLiteral("/apps"), [](const RedflagStandIn::Request &request) {
+        RedflagStandIn::Reply reply;
+        if (acceptsCbor(request)) {
+            reply.contentType = "application/cbor";
+            reply.body = appsCbor(3);
+        } else {
+            reply.body = appsJson(3);
+        }
+        return reply;
+    });
+
+    // The first request starts discovery and goes out as JSON
+    QCOMPARE(int(fetchApps().size()), 3);
+    QVERIFY(!acceptsCbor(m_guest->requests(QStringLiteral("/apps")).first()));
+    QTRY_VERIFY(GuestHttpPipeline::shared()->supports(m_guest->url(QStringLiteral("/apps")), QStringLiteral("cbor")));
+
+    const QList<InstalledApp> apps = fetchApps();
+    QCOMPARE(int(apps.size()), 3);
+    QCOMPARE(apps.at(2).name, QStringLiteral("Application 2"));
+    QCOMPARE(apps.at(2).installLocation, QStringLiteral("C:\\Program Files\\Application 2"));
+    QVERIFY(acceptsCbor(m_guest->requests(QStringLiteral("/apps")).last()));
+    QCOMPARE(appsStats().decoded, quint64(2));
+    QCOMPARE(appsStats().cborDecoded, quint64(1));
+}
+
+void TestFormatNegotiation::staysWithJsonWithoutVersion()
+{
+    // No /version: REDFLAG builds before it answer 404
+    m_guest->route(QStringLiteral("/apps"), [](const RedflagStandIn::Request &) {
+        RedflagStandIn::Reply reply;
+        reply.body = appsJson(2);
+        return reply;
+    });
+
+    QCOMPARE(int(fetchApps().size()), 2);
+    QTRY_COMPARE(m_guest->requestCount(QStringLiteral("/version")), 1);
+    QCOMPARE(int(fetchApps().size()), 2);
+
+    const QList<RedflagStandIn::Request> requests = m_guest->requests(QStringLiteral("/apps"));
+    QCOMPARE(int(requests.size()), 2);
+    for (const RedflagStandIn::Request &request : requests) {
+        QCOMPARE(request.headers.value("accept"), QByteArray("application/json"));
+    }
+    // The answer is remembered rather than asked for again
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/version")), 1);
+    QCOMPARE(appsStats().cborDecoded, quint64(0));
+}
+
+void TestFormatNegotiation::decodesJsonFromCborGuest()
+{
+    // Lists cbor but still answers JSON, e.g. behind a proxy that rewrites
+    // the reply; the client must not take the Accept header as a promise
+    m_guest->setCapabilities({QStringLiteral("cbor")});
+    m_guest->route(QStringLiteral("/apps"), [](const RedflagStandIn::Request &) {
+        RedflagStandIn::Reply reply;
+        reply.body = appsJson(4);
+        return reply;
+    });
+
+    QCOMPARE(int(fetchApps().size()), 4);
+    QTRY_VERIFY(GuestHttpPipeline::shared()->supports(m_guest->url(QStringLiteral("/apps")), QStringLiteral("cbor")));
+    QCOMPARE(int(fetchApps().size()), 4);
+    QVERIFY(acceptsCbor(m_guest->requests(QStringLiteral("/apps")).last()));
+    QCOMPARE(appsStats().decoded, quint64(2));
+    QCOMPARE(appsStats().cborDecoded, quint64(0));
+}
+
+void TestFormatNegotiation::sniffsFormatOfAppsStream()
+{
+    // Fed a byte at a time: the format is told from the first byte and
+    // every record still comes out whole
+    const QList<QByteArray> bodies = {appsJson(5), appsCbor(5)};
+    for (const QByteArray &body : bodies) {
+        AppsStreamDecoder decoder;
+        QList<InstalledApp> apps;
+        for (int i = 0; i < body.size(); ++i) {
+            apps += decoder.feed(body.mid(i, 1));
+        }
+        QCOMPARE(decoder.isCbor(), body == bodies.last());
+        QVERIFY(!decoder.hasFailed());
+        QVERIFY(decoder.isComplete());
+        QCOMPARE(int(apps.size()), 5);
+        QCOMPARE(apps.at(4).displayVersion, QStringLiteral("1.0.4"));
+    }
+}
+
+QTEST_MAIN(TestFormatNegotiation)
+
+#include "tst_formatnegotiation.moc"
@@ -0,0 +1,256 @@
+#include "guestserverappsclient.h"
+#include "redflagstandin.h"
+#include <QtTest>
+#include <QBuffer>
+#include <QColor>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+
+namespace {
+QByteArray pngOf(const QColor &color)
+{
+    QImage image(16, 16, QImage::Format_ARGB32);
+    image.fill(color);
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return data;
+}
+
+QByteArray u32(quint32 value)
+{
+    char bytes[4];
+    qToBigEndian(value, bytes);
+    return QByteArray(bytes, 4);
+}
+
+// One /get-icons frame: u32 path length, path, u32 data length, data
+QByteArray frame(const QString &path, const QByteArray &data)
+{
+    const QByteArray utf8 = path.toUtf8();
+    return u32(quint32(utf8.size())) + utf8 + u32(quint32(data.size())) + data;
+}
+
+QStringList requestedPaths(const RedflagStandIn::Request &request)
+{
+    QStringList paths;
+    const QJsonArray list = QJsonDocument::fromJson(request.body).object().value("paths").toArray();
+    for (const QJsonValue &value : list) {
+        paths.append(value.toString());
+    }
+    return paths;
+}
+
+QByteArray framesFor(const QStringList &paths)
+{
+    QByteArray frames;
+    for (const QString &path : paths) {
+        frames += frame(path, pngOf(Qt::blue));
+    }
+    return frames;
+}
+
+// Splits data into chunks of at most size bytes
+QList<QByteArray> split(const QByteArray &data, int size)
+{
+    QList<QByteArray> chunks;
+    for (int i = 0; i < data.size(); i += size) {
+        chunks.append(data.mid(i, size));
+    }
+    return chunks;
+}
+} // namespace
+
+// GuestServerAppsClient::fetchIcons against a stand-in guest: frames are
+// read as they stream in, malformed or truncated ones end the batch, and
+// whatever a batch did not deliver is fetched through /get-icon.
+class TestIconBatches : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void deliversBatchedIcons();
+    void readsFramesSplitAcrossChunks();
+    void rejectsOversizedPathLength();
+    void rejectsOversizedDataLength();
+    void fetchesTruncatedFrameSingly();
+    void fallsBackWithoutBatchEndpoint();
+
+private:
+    static QStringList iconPaths(int count);
+    bool receivedAll(const QStringList &paths) const;
+
+    RedflagStandIn *m_guest = nullptr;
+    GuestServerAppsClient *m_client = nullptr;
+    QHash<QString, QImage> m_icons;
+};
+
+void TestIconBatches::initTestCase()
+{
+    // Keeps the icon store and catalogs out of the real cache directory
+    QStandardPaths::setTestModeEnabled(true);
+    QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).removeRecursively();
+}
+
+void TestIconBatches::init()
+{
+    // A new port per test, so no circuit or capability state carries over
+    m_guest = new RedflagStandIn(this);
+    QVERIFY(m_guest->port() != 0);
+    m_guest->route(QStringLiteral("/get-icon"), [](const RedflagStandIn::Request &) {
+        RedflagStandIn::Reply reply;
+        reply.contentType = "text/plain";
+        reply.body = pngOf(Qt::red).toBase64();
+        return reply;
+    });
+
+    m_icons.clear();
+    m_client = new GuestServerAppsClient(m_guest->host(), m_guest->port(), this);
+    connect(m_client, &GuestServerAppsClient::iconReceived, this, [this](const QString &path, const QImage &icon) {
+        m_icons.insert(path, icon);
+    });
+}
+
+void TestIconBatches::cleanup()
+{
+    delete m_client;
+    m_client = nullptr;
+    delete m_guest;
+    m_guest = nullptr;
+}
+
+QStringList TestIconBatches::iconPaths(int count)
+{
+    QStringList paths;
+    for (int i = 0; i < count; ++i) {
+        paths.append(QStringLiteral("C:\\Program Files\\App %1\\app.exe").arg(i));
+    }
+    return paths;
+}
+
+bool TestIconBatches::receivedAll(const QStringList &paths) const
+{
+    for (const QString &path : paths) {
+        if (m_icons.value(path).isNull()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TestIconBatches::deliversBatchedIcons()
+{
+    m_guest->route(QStringLiteral("/get-icons"), [](const RedflagStandIn::Request &request) {
+        RedflagStandIn::Reply reply;
+        reply.contentType = "application/octet-stream";
+        reply.chunks = {framesFor(requestedPaths(request))};
+        return reply;
+    });
+
+    const QStringList paths = iconPaths(5);
+    m_client->fetchIcons(paths);
+    QTRY_VERIFY(receivedAll(paths));
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/get-icons")), 1);
+    QCOMPARE(requestedPaths(m_guest->requests(QStringLiteral("/get-icons")).first()), paths);
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/get-icon")), 0);
+}
+
+void TestIconBatches::readsFramesSplitAcrossChunks()
+{
+    // Every length prefix and path straddles chunk boundaries
+    m_guest->route(QStringLiteral("/get-icons"), [](const RedflagStandIn::Request &request) {
+        RedflagStandIn::Reply reply;
+        reply.contentType = "application/octet-stream";
+        reply.chunks = split(framesFor(requestedPaths(request)), 3);
+        return reply;
+    });
+
+    const QStringList paths = iconPaths(3);
+    m_client->fetchIcons(paths);
+    QTRY_VERIFY(receivedAll(paths));
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/get-icon")), 0);
+}
+
+void TestIconBatches::rejectsOversizedPathLength()
+{
+    // A path length over the limit is not waited for: the rest of the batch
+    // goes through /get-icon once the reply ends
+    m_guest->route(QStringLiteral("/get-icons"), [](const RedflagStandIn::Request &request) {
+        const QStringList paths = requestedPaths(request);
+        RedflagStandIn::Reply reply;
+        reply.contentType = "application/octet-stream";
+        reply.chunks = {frame(paths.first(), pngOf(Qt::blue)) + u32(1u << 31) + QByteArray(64, 'x')};
+        return reply;
+    });
+
+    const QStringList paths = iconPaths(4);
+    m_client->fetchIcons(paths);
+    QTRY_VERIFY(receivedAll(paths));
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/get-icon")), int(paths.size()) - 1);
+}
+
+void TestIconBatches::rejectsOversizedDataLength()
+{
+    m_guest->route(QStringLiteral("/get-icons"), [](const RedflagStandIn::Request &request) {
+        const QStringList paths = requestedPaths(request);
+        const QByteArray path = paths.at(1).toUtf8();
+        RedflagStandIn::Reply reply;
+        reply.contentType = "application/octet-stream";
+        reply.chunks = {frame(paths.first(), pngOf(Qt::blue)) + u32(quint32(path.size())) + path
+                        + u32(0xffffffffu) + QByteArray(64, 'x')};
+        return reply;
+    });
+
+    const QStringList paths = iconPaths(4);
+    m_client->fetchIcons(paths);
+    QTRY_VERIFY(receivedAll(paths));
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/get-icon")), int(paths.size()) - 1);
+}
+
+void TestIconBatches::fetchesTruncatedFrameSingly()
+{
+    // The reply ends in the middle of the last icon
+    m_guest->route(QStringLiteral("/get-icons"), [](const RedflagStandIn::Request &request) {
+        const QByteArray frames = framesFor(requestedPaths(request));
+        RedflagStandIn::Reply reply;
+        reply.contentType = "application/octet-stream";
+        reply.chunks = {frames.left(frames.size() - 10)};
+        return reply;
+    });
+
+    const QStringList paths = iconPaths(3);
+    m_client->fetchIcons(paths);
+    QTRY_VERIFY(receivedAll(paths));
+    const QList<RedflagStandIn::Request> singles = m_guest->requests(QStringLiteral("/get-icon"));
+    QCOMPARE(int(singles.size()), 1);
+    QCOMPARE(QUrlQuery(QString::fromUtf8(singles.first().body)).queryItemValue("path", QUrl::FullyDecoded),
+             paths.last());
+}
+
+void TestIconBatches::fallsBackWithoutBatchEndpoint()
+{
+    // No /get-icons route: REDFLAG builds before it answer 404
+    const QStringList paths = iconPaths(3);
+    m_client->fetchIcons(paths);
+    QTRY_VERIFY(receivedAll(paths));
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/get-icons")), 1);
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/get-icon")), int(paths.size()));
+
+    // Later icons skip the batch endpoint altogether
+    const QStringList more = {QStringLiteral("C:\\Tools\\tool.exe")};
+    m_client->fetchIcons(more);
+    QTRY_VERIFY(receivedAll(more));
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/get-icons")), 1);
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/get-icon")), int(paths.size()) + 1);
+}
+
+QTEST_MAIN(TestIconBatches)
+
+#include "tst_iconbatches.moc"
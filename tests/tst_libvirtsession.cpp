@@ -0,0 +1,113 @@
+#include "libvirtsession.h"
+#include <QtTest>
+
+namespace {
+// libvirt's built-in test driver: no libvirtd, one running domain "test"
+const QString kTestUri = QStringLiteral("test:///default");
+const QString kTestDomain = QStringLiteral("test");
+} // namespace
+
+class TestLibvirtSession : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void listsDomains();
+    void reportsUnknownDomain();
+    void stopsAndStartsDomain();
+
+private:
+    LibvirtSession *m_session = nullptr;
+    QList<LibvirtSession::LifecycleEvent> m_events;
+};
+
+void TestLibvirtSession::initTestCase()
+{
+    m_session = new LibvirtSession(kTestUri, this);
+    QCOMPARE(m_session->uri(), kTestUri);
+
+    QString error;
+    m_session->listDomains(&error);
+    if (!error.isEmpty()) {
+        QSKIP(qPrintable(QStringLiteral("libvirt test driver unavailable: %1").arg(error)));
+    }
+
+    // Emitted on the libvirt event thread, so this arrives queued
+    connect(m_session, &LibvirtSession::domainLifecycleChanged, this,
+            [this](const QString &name, LibvirtSession::LifecycleEvent event) {
+        if (name == kTestDomain) {
+            m_events.append(event);
+        }
+    });
+}
+
+void TestLibvirtSession::cleanupTestCase()
+{
+    // Joins the event thread
+    delete m_session;
+    m_session = nullptr;
+}
+
+void TestLibvirtSession::init()
+{
+    m_events.clear();
+}
+
+void TestLibvirtSession::listsDomains()
+{
+    QString error;
+    const QList<VmDomain> domains = m_session->listDomains(&error);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    QVERIFY(m_session->isOpen());
+    QCOMPARE(int(domains.size()), 1);
+
+    const VmDomain &domain = domains.first();
+    QCOMPARE(domain.name, kTestDomain);
+    QVERIFY(!domain.uuid.isEmpty());
+    QVERIFY(domain.isRunning());
+    QVERIFY(domain.isActive());
+    QCOMPARE(m_session->domain(kTestDomain), domain);
+}
+
+void TestLibvirtSession::reportsUnknownDomain()
+{
+    QString error;
+    QVERIFY(!m_session->domain(QStringLiteral("no-such-vm"), &error).isValid());
+    QVERIFY(!error.isEmpty());
+
+    error.clear();
+    QVERIFY(!m_session->start(QStringLiteral("no-such-vm"), &error));
+    QVERIFY(!error.isEmpty());
+
+    error.clear();
+    QVERIFY(m_session->guestAddress(QStringLiteral("no-such-vm"), LibvirtSession::LeaseAddress, &error).isEmpty());
+    QVERIFY(!error.isEmpty());
+}
+
+void TestLibvirtSession::stopsAndStartsDomain()
+{
+    QString error;
+    QVERIFY2(m_session->destroy(kTestDomain, &error), qPrintable(error));
+    const VmDomain stopped = m_session->domain(kTestDomain);
+    QCOMPARE(stopped.state, VmDomain::ShutOff);
+    QVERIFY(!stopped.isActive());
+    QTRY_VERIFY(m_events.contains(LibvirtSession::DomainStopped));
+
+    // Stopping a stopped domain is not an error
+    QVERIFY2(m_session->shutdown(kTestDomain, &error), qPrintable(error));
+    QVERIFY2(m_session->destroy(kTestDomain, &error), qPrintable(error));
+
+    QVERIFY2(m_session->start(kTestDomain, &error), qPrintable(error));
+    QVERIFY(m_session->domain(kTestDomain).isRunning());
+    QTRY_VERIFY(m_events.contains(LibvirtSession::DomainStarted));
+
+    // Nor is starting a running one
+    QVERIFY2(m_session->start(kTestDomain, &error), qPrintable(error));
+}
+
+QTEST_GUILESS_MAIN(TestLibvirtSession)
+
+#include "tst_libvirtsession.moc"
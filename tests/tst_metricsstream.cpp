@@ -0,0 +1,206 @@
+#include "guesthttppipeline.h"
+#include "guestserverclient.h"
+#include "redflagstandin.h"
+#include <QtTest>
+#include <QHostAddress>
+#include <QNetworkRequest>
+#include <QTcpServer>
+
+namespace {
+constexpr int kIntervalMs = 100;
+
+// One /metrics sample, as polled or as a line of /metrics/stream
+QByteArray sample(double cpuUsage)
+{
+    return "{\"cpu\":{\"usage\":" + QByteArray::number(cpuUsage) + ",\"frequency\":3000},"
+           "\"ram\":{\"used\":2048,\"total\":8192,\"percentage\":25},"
+           "\"disk\":{\"used\":40960,\"total\":102400,\"percentage\":40}}";
+}
+
+RedflagStandIn::Reply sampleReply(double cpuUsage)
+{
+    RedflagStandIn::Reply reply;
+    reply.body = sample(cpuUsage);
+    return reply;
+}
+} // namespace
+
+// GuestServerClient against a stand-in guest: samples are streamed from
+// guests that offer it and polled from the rest, and neither ending a stream
+// on this side nor HTTP errors count against the guest's circuit.
+class TestMetricsStream : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void appliesStreamedSamples();
+    void restartsWithoutOpeningCircuit();
+    void pollsWhenStreamRefused();
+    void opensCircuitOnTransportFailures();
+
+private:
+    QString endpoint(const QString &path) const;
+
+    RedflagStandIn *m_guest = nullptr;
+    GuestServerClient *m_client = nullptr;
+    QList<double> m_cpuUsage;   // Of every sample applied
+};
+
+void TestMetricsStream::init()
+{
+    // A new port per test, so no circuit or capability state carries over
+    m_guest = new RedflagStandIn(this);
+    QVERIFY(m_guest->port() != 0);
+    m_guest->route(QStringLiteral("/metrics"), [](const RedflagStandIn::Request &) {
+        return sampleReply(1);
+    });
+
+    m_cpuUsage.clear();
+    m_client = new GuestServerClient(m_guest->host(), m_guest->port(), QString(), this);
+    connect(m_client, &GuestServerClient::metricsUpdated, this, [this](const GuestServerMetrics &metrics) {
+        m_cpuUsage.append(metrics.cpu.usage);
+    });
+}
+
+void TestMetricsStream::cleanup()
+{
+    delete m_client;
+    m_client = nullptr;
+    delete m_guest;
+    m_guest = nullptr;
+}
+
+QString TestMetricsStream::endpoint(const QString &path) const
+{
+    return QStringLiteral("%1:%2%3").arg(m_guest->host()).arg(m_guest->port()).arg(path);
+}
+
+void TestMetricsStream::appliesStreamedSamples()
+{
+    m_guest->setCapabilities({QStringLiteral("metrics-stream")});
+    // Lines split across chunks, then the stream stays open
+    m_guest->route(QStringLiteral("/metrics/stream"), [](const RedflagStandIn::Request &) {
+        const QByteArray lines = sample(10) + '\n' + sample(20) + '\n' + sample(30) + '\n';
+        RedflagStandIn::Reply reply;
+        reply.contentType = "application/x-ndjson";
+        reply.chunks = {lines.left(50), lines.mid(50, 200), lines.mid(250)};
+        reply.chunkIntervalMs = 20;
+        reply.keepOpen = true;
+        return reply;
+    });
+
+    // Polled until /version has answered, then streamed
+    m_client->startMonitoring(kIntervalMs);
+    QTRY_VERIFY(m_cpuUsage.contains(30));
+    QVERIFY(m_client->isStreaming());
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/metrics/stream")), 1);
+    QCOMPARE(m_cpuUsage.mid(m_cpuUsage.indexOf(10)), (QList<double>{10, 20, 30}));
+    QCOMPARE(m_client->currentMetrics().ram.total, quint64(8192));
+
+    // No polling while the stream is open
+    const int polls = m_guest->requestCount(QStringLiteral("/metrics"));
+    QTest::qWait(3 * kIntervalMs);
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/metrics")), polls);
+}
+
+void TestMetricsStream::restartsWithoutOpeningCircuit()
+{
+    m_guest->setCapabilities({QStringLiteral("metrics-stream")});
+    m_guest->route(QStringLiteral("/metrics/stream"), [](const RedflagStandIn::Request &) {
+        RedflagStandIn::Reply reply;
+        reply.contentType = "application/x-ndjson";
+        reply.chunks = {sample(50) + '\n'};
+        reply.keepOpen = true;
+        return reply;
+    });
+    m_client->startMonitoring(kIntervalMs);
+    QTRY_VERIFY(m_client->isStreaming());
+
+    // Each stop cancels the stream, most of them before the guest answered
+    const QUrl url = m_guest->url(QStringLiteral("/metrics/stream"));
+    for (int i = 0; i < 5; ++i) {
+        m_client->stopMonitoring();
+        m_client->startMonitoring(kIntervalMs);
+        QVERIFY(m_client->isStreaming());
+    }
+    QTRY_VERIFY(m_cpuUsage.contains(50));
+    QVERIFY(!GuestHttpPipeline::shared()->isCircuitOpen(url));
+    QCOMPARE(GuestHttpPipeline::shared()->stats(endpoint(QStringLiteral("/metrics/stream"))).failures, quint64(0));
+    QCOMPARE(GuestHttpPipeline::shared()->stats(endpoint(QStringLiteral("/metrics/stream"))).rejected, quint64(0));
+}
+
+void TestMetricsStream::pollsWhenStreamRefused()
+{
+    // Listed, but /metrics/stream answers 404
+    m_guest->setCapabilities({QStringLiteral("metrics-stream")});
+
+    m_client->startMonitoring(kIntervalMs);
+    QTRY_COMPARE(m_guest->requestCount(QStringLiteral("/metrics/stream")), 1);
+    const int polls = m_guest->requestCount(QStringLiteral("/metrics"));
+    QTRY_VERIFY(m_guest->requestCount(QStringLiteral("/metrics")) >= polls + 3);
+    QVERIFY(!m_client->isStreaming());
+    QVERIFY(m_cpuUsage.contains(1));
+    // Not asked for again, and HTTP errors leave the circuit closed
+    QCOMPARE(m_guest->requestCount(QStringLiteral("/metrics/stream")), 1);
+    QVERIFY(!GuestHttpPipeline::shared()->isCircuitOpen(m_guest->url(QStringLiteral("/metrics"))));
+}
+
+void TestMetricsStream::opensCircuitOnTransportFailures()
+{
+    GuestHttpPipeline *pipeline = GuestHttpPipeline::shared();
+    auto getFrom = [pipeline](const QUrl &url) {
+        // Destroyed on return, which drops a reply that is still due
+        QObject context;
+        TaskResult result;
+        bool done = false;
+        pipeline->get(QNetworkRequest(url), &context, [&result, &done](const TaskResult &reply) {
+            result = reply;
+            done = true;
+        });
+        QTest::qWaitFor([&done]() { return done; }, 5000);
+        return result;
+    };
+
+    // HTTP errors prove the guest reachable
+    const QUrl missing = m_guest->url(QStringLiteral("/missing"));
+    for (int i = 0; i < 5; ++i) {
+        QCOMPARE(getFrom(missing).exitCode, 404);
+    }
+    QVERIFY(!pipeline->isCircuitOpen(missing));
+
+    // Requests canceled on this side count for nothing, however many
+    const QUrl stream = m_guest->url(QStringLiteral("/metrics/stream"));
+    for (int i = 0; i < 5; ++i) {
+        QObject context;
+        bool done = false;
+        AsyncTask *task = pipeline->getStreaming(QNetworkRequest(stream), &context, [](const QByteArray &) {},
+                                                 [&done](const TaskResult &) { done = true; }, 0);
+        QVERIFY(task);
+        task->cancel();
+        QTRY_VERIFY(done);
+    }
+    QVERIFY(!pipeline->isCircuitOpen(stream));
+    QCOMPARE(pipeline->stats(endpoint(QStringLiteral("/metrics/stream"))).failures, quint64(0));
+
+    // Refused connections do not: the third one opens the circuit, and the
+    // next request fails fast without reaching the network
+    QTcpServer closed;
+    QVERIFY(closed.listen(QHostAddress::LocalHost));
+    const QUrl unreachable(QStringLiteral("http://127.0.0.1:%1/metrics").arg(closed.serverPort()));
+    const QString unreachableEndpoint = QStringLiteral("127.0.0.1:%1/metrics").arg(closed.serverPort());
+    closed.close();
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(!pipeline->isCircuitOpen(unreachable));
+        QCOMPARE(getFrom(unreachable).exitCode, 0);
+    }
+    QVERIFY(pipeline->isCircuitOpen(unreachable));
+    QVERIFY(getFrom(unreachable).errorString.contains(QStringLiteral("circuit open")));
+    QCOMPARE(pipeline->stats(unreachableEndpoint).requests, quint64(3));
+    QCOMPARE(pipeline->stats(unreachableEndpoint).rejected, quint64(1));
+}
+
+QTEST_MAIN(TestMetricsStream)
+
+#include "tst_metricsstream.moc"
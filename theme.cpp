@@ -0,0 +1,176 @@
+#include "theme.h"
+#include <QAbstractButton>
+#include <QApplication>
+#include <QLabel>
+#include <QPainter>
+#include <QProxyStyle>
+#include <QStyleFactory>
+#include <QStyleOption>
+
+namespace {
+const char kRoleProperty[] = "winrunThemeRole";
+const char kStatusProperty[] = "winrunThemeStatus";
+constexpr qreal kButtonRadius = 6;
+constexpr qreal kProminentRadius = 15;
+constexpr qreal kDisabledOpacity = 0.55;
+
+const QColor kColors[Theme::ColorCount] = {
+    QColor(0x1a, 0x53, 0x5c),   // Teal
+    QColor(0x2a, 0x7a, 0x83),   // TealHover
+    QColor(0x4e, 0xcd, 0xc4),   // Aqua
+    QColor(0xff, 0x9f, 0x1c),   // Orange
+    QColor(0xff, 0xbf, 0x69),   // OrangeHover
+    QColor(0x2c, 0x3e, 0x50),   // Text
+    QColor(0x34, 0x98, 0xdb),   // Progress
+};
+
+const QColor kStatusColors[Theme::StatusCount] = {
+    QColor(0x7f, 0x8c, 0x8d),   // Neutral
+    QColor(0x27, 0xae, 0x60),   // Ok
+    QColor(0xf3, 0x9c, 0x12),   // Busy
+    QColor(0x29, 0x80, 0xb9),   // Info
+    QColor(0xe7, 0x4c, 0x3c),   // Error
+};
+
+// Brushes and text color of a button role, built once
+struct RoleLook {
+    QBrush base;
+    QBrush hover;
+    QBrush pressed;
+    QPen border;
+    QColor text;
+    qreal radius = kButtonRadius;
+};
+
+const RoleLook &lookOf(Theme::Role role)
+{
+    static const RoleLook looks[] = {
+        RoleLook(),
+        {kColors[Theme::Teal], kColors[Theme::TealHover], kColors[Theme::Teal].darker(120),
+         Qt::NoPen, Qt::white, kButtonRadius},
+        {kColors[Theme::Teal], kColors[Theme::TealHover], kColors[Theme::Teal].darker(120),
+         Qt::NoPen, Qt::white, kProminentRadius},
+        {QColor(0xf8, 0xf9, 0xfa), QColor(0xe0, 0xe0, 0xe0), QColor(0xd0, 0xd0, 0xd0),
+         QPen(QColor(0xdd, 0xdd, 0xdd)), kColors[Theme::Teal], 4},
+        {kColors[Theme::Orange], kColors[Theme::OrangeHover], kColors[Theme::Orange].darker(115),
+         Qt::NoPen, Qt::white, kButtonRadius},
+    };
+    return looks[role];
+}
+
+class ThemeStyle : public QProxyStyle
+{
+public:
+    explicit ThemeStyle(QStyle *base) : QProxyStyle(base) {}
+
+    void drawPrimitive(PrimitiveElement element, const QStyleOption *option, QPainter *painter,
+                       const QWidget *widget) const override
+    {
+        const Theme::Role role = Theme::roleOf(widget);
+        if (role == Theme::NoRole) {
+            QProxyStyle::drawPrimitive(element, option, painter, widget);
+            return;
+        }
+
+        switch (element) {
+        case PE_PanelButtonCommand: {
+            const RoleLook &look = lookOf(role);
+            const bool enabled = option->state & State_Enabled;
+            const QBrush &brush = !enabled ? look.base
+                : (option->state & (State_Sunken | State_On)) ? look.pressed
+                : (option->state & State_MouseOver) ? look.hover
+                : look.base;
+            painter->save();
+            painter->setRenderHint(QPainter::Antialiasing);
+            if (!enabled) {
+                painter->setOpacity(kDisabledOpacity);
+            }
+            painter->setPen(look.border);
+            painter->setBrush(brush);
+            const qreal inset = look.border.style() == Qt::NoPen ? 0 : 0.5;
+            painter->drawRoundedRect(QRectF(option->rect).adjusted(inset, inset, -inset, -inset),
+                                     look.radius, look.radius);
+            painter->restore();
+            return;
+        }
+        case PE_FrameFocusRect:
+        case PE_FrameDefaultButton:
+            // The flat look has no focus or default frames
+            return;
+        default:
+            QProxyStyle::drawPrimitive(element, option, painter, widget);
+        }
+    }
+};
+} // namespace
+
+QColor Theme::color(Color color)
+{
+    return kColors[color];
+}
+
+QPalette Theme::palette()
+{
+    QPalette palette;
+    palette.setColor(QPalette::Window, QColor(240, 240, 240));
+    palette.setColor(QPalette::WindowText, Qt::black);
+    palette.setColor(QPalette::Base, QColor(255, 255, 255));
+    palette.setColor(QPalette::AlternateBase, QColor(240, 240, 240));
+    palette.setColor(QPalette::ToolTipBase, QColor(255, 255, 255));
+    palette.setColor(QPalette::ToolTipText, Qt::black);
+    palette.setColor(QPalette::Text, Qt::black);
+    palette.setColor(QPalette::Button, QColor(240, 240, 240));
+    palette.setColor(QPalette::ButtonText, Qt::black);
+    palette.setColor(QPalette::BrightText, Qt::red);
+    palette.setColor(QPalette::Link, QColor(42, 130, 218));
+    palette.setColor(QPalette::Highlight, QColor(42, 130, 218));
+    palette.setColor(QPalette::HighlightedText, Qt::white);
+    return palette;
+}
+
+QStyle *Theme::createStyle()
+{
+    return new ThemeStyle(QStyleFactory::create(QStringLiteral("Fusion")));
+}
+
+void Theme::setRole(QAbstractButton *button, Role role)
+{
+    button->setProperty(kRoleProperty, int(role));
+    // Hover colors need hover events
+    button->setAttribute(Qt::WA_Hover, role != NoRole);
+    QPalette palette = button->palette();
+    palette.setColor(QPalette::ButtonText, role == NoRole ? QApplication::palette().color(QPalette::ButtonText)
+                                                          : lookOf(role).text);
+    button->setPalette(palette);
+    button->update();
+}
+
+Theme::Role Theme::roleOf(const QWidget *widget)
+{
+    if (!widget) {
+        return NoRole;
+    }
+    const QVariant role = widget->property(kRoleProperty);
+    return role.isValid() ? Role(role.toInt()) : NoRole;
+}
+
+void Theme::setStatus(QLabel *label, Status status)
+{
+    const QVariant current = label->property(kStatusProperty);
+    if (current.isValid() && current.toInt() == status) {
+        return;
+    }
+
+    // One palette per status, shared by every label that shows it
+    static QPalette palettes[StatusCount];
+    static bool built = false;
+    if (!built) {
+        for (int i = 0; i < StatusCount; ++i) {
+            palettes[i] = QApplication::palette();
+            palettes[i].setColor(QPalette::WindowText, kStatusColors[i]);
+        }
+        built = true;
+    }
+    label->setProperty(kStatusProperty, int(status));
+    label->setPalette(palettes[status]);
+}
@@ -0,0 +1,60 @@
+#ifndef THEME_H
+#define THEME_H
+
+#include <QColor>
+#include <QPalette>
+
+class QAbstractButton;
+class QLabel;
+class QStyle;
+
+// The teal look of the application without runtime style sheets. Colors come
+// from the palette and a QProxyStyle over Fusion paints themed buttons from
+// brushes built once; widgets only carry a role or status. Changing a status
+// swaps in a cached palette, so nothing is parsed or re-polished.
+class Theme
+{
+public:
+    enum Color {
+        Teal,           // Sidebar, primary buttons, headings
+        TealHover,
+        Aqua,
+        Orange,
+        OrangeHover,
+        Text,
+        Progress,
+        ColorCount
+    };
+
+    // Button looks
+    enum Role {
+        NoRole,
+        Primary,        // Teal, white text
+        Prominent,      // Primary with a pill shape (call to action)
+        Secondary,      // Light with teal text and a border
+        Highlight       // Orange
+    };
+
+    enum Status {
+        Neutral,
+        Ok,
+        Busy,
+        Info,
+        Error,
+        StatusCount
+    };
+
+    static QColor color(Color color);
+
+    static QPalette palette();
+    // Fusion with the themed buttons; owned by the application once set
+    static QStyle *createStyle();
+
+    static void setRole(QAbstractButton *button, Role role);
+    static Role roleOf(const QWidget *widget);
+
+    // Recolors label for status; a no-op if it already shows that status
+    static void setStatus(QLabel *label, Status status);
+};
+
+#endif // THEME_H
@@ -0,0 +1,177 @@
+#include "vmlistmodel.h"
+#include <QSet>
+#include <QDebug>
+
+VmListModel::VmListModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_avoidedRefreshes(0)
+    , m_stale(false)
+{
+}
+
+VmListModel::~VmListModel()
+{
+    if (m_avoidedRefreshes > 0) {
+        qDebug() << "VM list:" << m_avoidedRefreshes << "unchanged rows skipped without a refresh";
+    }
+}
+
+int VmListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_domains.size();
+}
+
+QVariant VmListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_domains.size()) {
+        return QVariant();
+    }
+
+    const VmDomain &domain = m_domains.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return domain.name;
+    case Qt::ToolTipRole:
+        if (m_stale) {
+            return QStringLiteral("%1 (%2, last known)").arg(domain.name, domain.stateText());
+        }
+        return QStringLiteral("%1 (%2)").arg(domain.name, domain.stateText());
+    case DomainRole:
+        return QVariant::fromValue(domain);
+    case StateRole:
+        return static_cast<int>(domain.state);
+    case UuidRole:
+        return domain.uuid;
+    case RunningRole:
+        return domain.isRunning();
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> VmListModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles.insert(DomainRole, "domain");
+    roles.insert(StateRole, "state");
+    roles.insert(UuidRole, "uuid");
+    roles.insert(RunningRole, "running");
+    return roles;
+}
+
+QString VmListModel::keyOf(const VmDomain &domain)
+{
+    return domain.uuid.isEmpty() ? domain.name : domain.uuid;
+}
+
+int VmListModel::rowOfKey(const QString &key) const
+{
+    for (int row = 0; row < m_domains.size(); ++row) {
+        if (keyOf(m_domains.at(row)) == key) {
+            return row;
+        }
+    }
+    return -1;
+}
+
+int VmListModel::rowOf(const QString &name) const
+{
+    for (int row = 0; row < m_domains.size(); ++row) {
+        if (m_domains.at(row).name == name) {
+            return row;
+        }
+    }
+    return -1;
+}
+
+VmDomain VmListModel::domainAt(int row) const
+{
+    return m_domains.value(row);
+}
+
+VmDomain VmListModel::domain(const QString &name) const
+{
+    return m_domains.value(rowOf(name));
+}
+
+void VmListModel::setStale(bool stale)
+{
+    if (stale == m_stale) {
+        return;
+    }
+    m_stale = stale;
+    if (!m_domains.isEmpty()) {
+        emit dataChanged(index(0), index(m_domains.size() - 1), {Qt::ToolTipRole});
+    }
+}
+
+void VmListModel::reconcile(const QList<VmDomain> &domains)
+{
+    QSet<QString> incoming;
+    for (const VmDomain &domain : domains) {
+        if (domain.isValid()) {
+            incoming.insert(keyOf(domain));
+        }
+    }
+
+    // Remove vanished rows from the back so earlier row numbers stay valid
+    for (int row = m_domains.size() - 1; row >= 0; --row) {
+        if (!incoming.contains(keyOf(m_domains.at(row)))) {
+            beginRemoveRows(QModelIndex(), row, row);
+            m_domains.removeAt(row);
+            endRemoveRows();
+        }
+    }
+
+    // Update rows in place, append new ones in snapshot order
+    for (const VmDomain &domain : domains) {
+        if (!domain.isValid()) {
+            continue;
+        }
+        const int row = rowOfKey(keyOf(domain));
+        if (row < 0) {
+            beginInsertRows(QModelIndex(), m_domains.size(), m_domains.size());
+            m_domains.append(domain);
+            endInsertRows();
+        } else if (m_domains.at(row) != domain) {
+            m_domains[row] = domain;
+            const QModelIndex changed = index(row);
+            emit dataChanged(changed, changed);
+        } else {
+            ++m_avoidedRefreshes;
+        }
+    }
+}
+
+bool VmListModel::updateDomain(const QString &name, const VmDomain &domain)
+{
+    const int row = rowOf(name);
+
+    if (!domain.isValid()) {
+        if (row < 0) {
+            return false;
+        }
+        beginRemoveRows(QModelIndex(), row, row);
+        m_domains.removeAt(row);
+        endRemoveRows();
+        return true;
+    }
+
+    if (row < 0) {
+        beginInsertRows(QModelIndex(), m_domains.size(), m_domains.size());
+        m_domains.append(domain);
+        endInsertRows();
+        return true;
+    }
+
+    if (m_domains.at(row) == domain) {
+        ++m_avoidedRefreshes;
+        return false;
+    }
+
+    m_domains[row] = domain;
+    const QModelIndex changed = index(row);
+    emit dataChanged(changed, changed);
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef VMLISTMODEL_H
+#define VMLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include "libvirtsession.h"
+
+// Keyed list of libvirt domains. New snapshots are reconciled against the
+// current rows so views only see inserts, removals and dataChanged for the
+// rows that really changed; a combo box on top keeps its selection.
+class VmListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        DomainRole = Qt::UserRole + 1,
+        StateRole,
+        UuidRole,
+        RunningRole
+    };
+
+    explicit VmListModel(QObject *parent = nullptr);
+    ~VmListModel();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // Replaces the contents with a full snapshot, diffing by UUID (or name)
+    void reconcile(const QList<VmDomain> &domains);
+
+    // Applies a single-domain update; an invalid domain removes the row.
+    // Returns true if anything visible changed.
+    bool updateDomain(const QString &name, const VmDomain &domain);
+
+    VmDomain domainAt(int row) const;
+    VmDomain domain(const QString &name) const;
+    int rowOf(const QString &name) const;
+
+    // Rows that arrived unchanged and therefore triggered no view or
+    // downstream refresh (previously every row was cleared and re-added)
+    quint64 avoidedRefreshes() const { return m_avoidedRefreshes; }
+
+    // Set while libvirtd is unreachable: the rows are the last list read
+    void setStale(bool stale);
+    bool isStale() const { return m_stale; }
+
+private:
+    static QString keyOf(const VmDomain &domain);
+    int rowOfKey(const QString &key) const;
+
+    QList<VmDomain> m_domains;
+    quint64 m_avoidedRefreshes;
+    bool m_stale;
+};
+
+#endif // VMLISTMODEL_H
@@ -0,0 +1,277 @@
+#include "vmoperationqueue.h"
+#include "asynctask.h"
+#include "libvirtsession.h"
+#include <QTimer>
+#include <QDebug>
+#include <utility>
+
+namespace {
+constexpr int kCallDeadlineMs = 15000;
+constexpr int kDefaultShutdownTimeoutMs = 120000;
+constexpr int kTickIntervalMs = 1000;
+} // namespace
+
+VmOperationQueue::VmOperationQueue(LibvirtSession *session, TaskQueue *queue, QObject *parent)
+    : QObject(parent)
+    , m_session(session)
+    , m_queue(queue)
+    , m_tickTimer(new QTimer(this))
+    , m_nextGeneration(0)
+    , m_shutdownTimeoutMs(kDefaultShutdownTimeoutMs)
+{
+    // Drives the elapsed time in progressText() and the shutdown timeout
+    m_tickTimer->setInterval(kTickIntervalMs);
+    connect(m_tickTimer, &QTimer::timeout, this, &VmOperationQueue::onTick);
+}
+
+VmOperationQueue::~VmOperationQueue()
+{
+}
+
+QString VmOperationQueue::operationText(Operation operation)
+{
+    switch (operation) {
+    case Start: return QStringLiteral("Start");
+    case Shutdown: return QStringLiteral("Shut down");
+    case Reboot: return QStringLiteral("Restart");
+    case ForceOff: return QStringLiteral("Force off");
+    }
+    return QString();
+}
+
+bool VmOperationQueue::request(const QString &vmName, Operation operation)
+{
+    if (vmName.isEmpty()) {
+        return false;
+    }
+
+    Entry &entry = m_entries[vmName];
+    if ((entry.active && !entry.hasQueued && entry.current == operation)
+        || (entry.hasQueued && entry.queued == operation)) {
+        qDebug() << "Coalesced duplicate VM operation:" << vmName << operation;
+        return false;
+    }
+    if (operation == ForceOff && entry.active && entry.current == Shutdown) {
+        return escalate(vmName);
+    }
+
+    if (entry.hasQueued) {
+        qDebug() << "VM operation" << entry.queued << "replaced by" << operation << "for" << vmName;
+    }
+    entry.hasQueued = true;
+    entry.queued = operation;
+    if (entry.active) {
+        emit progressChanged(vmName);
+    } else {
+        startNext(vmName);
+    }
+    return true;
+}
+
+bool VmOperationQueue::cancel(const QString &vmName)
+{
+    auto it = m_entries.find(vmName);
+    if (it == m_entries.end()) {
+        return false;
+    }
+
+    const bool droppedQueued = it->hasQueued;
+    it->hasQueued = false;
+    if (it->active && it->current == Shutdown && it->waitingForState) {
+        finish(vmName, false, QStringLiteral("shutdown canceled"));
+        return true;
+    }
+    if (droppedQueued) {
+        emit progressChanged(vmName);
+    }
+    return droppedQueued;
+}
+
+bool VmOperationQueue::canCancel(const QString &vmName) const
+{
+    auto it = m_entries.constFind(vmName);
+    return it != m_entries.constEnd()
+        && (it->hasQueued || (it->active && it->current == Shutdown && it->waitingForState));
+}
+
+bool VmOperationQueue::escalate(const QString &vmName)
+{
+    auto it = m_entries.find(vmName);
+    if (it == m_entries.end() || !it->active || it->current != Shutdown) {
+        return false;
+    }
+
+    qDebug() << "Escalating shutdown to force off:" << vmName;
+    it->current = ForceOff;
+    it->waitingForState = false;
+    it->elapsed.restart();
+    send(vmName, ForceOff);
+    emit progressChanged(vmName);
+    return true;
+}
+
+bool VmOperationQueue::canEscalate(const QString &vmName) const
+{
+    auto it = m_entries.constFind(vmName);
+    return it != m_entries.constEnd() && it->active && it->current == Shutdown;
+}
+
+bool VmOperationQueue::isBusy(const QString &vmName) const
+{
+    auto it = m_entries.constFind(vmName);
+    return it != m_entries.constEnd() && (it->active || it->hasQueued);
+}
+
+QString VmOperationQueue::progressText(const QString &vmName) const
+{
+    auto it = m_entries.constFind(vmName);
+    if (it == m_entries.constEnd()) {
+        return QString();
+    }
+    if (!it->active) {
+        return it->hasQueued ? QStringLiteral("%1 queued").arg(operationText(it->queued)) : QString();
+    }
+
+    QString verb;
+    switch (it->current) {
+    case Start: verb = QStringLiteral("Starting"); break;
+    case Shutdown: verb = QStringLiteral("Shutting down"); break;
+    case Reboot: verb = QStringLiteral("Restarting"); break;
+    case ForceOff: verb = QStringLiteral("Forcing off"); break;
+    }
+    QString text = QStringLiteral("%1... %2 s").arg(verb).arg(it->elapsed.elapsed() / 1000);
+    if (it->hasQueued) {
+        text += QStringLiteral(", then %1").arg(operationText(it->queued).toLower());
+    }
+    return text;
+}
+
+void VmOperationQueue::domainUpdated(const QString &vmName, const VmDomain &domain)
+{
+    auto it = m_entries.constFind(vmName);
+    if (it == m_entries.constEnd() || !it->active || it->current != Shutdown) {
+        return;
+    }
+    if (domain.isValid() && !domain.isActive()) {
+        finish(vmName, true, QString());
+    }
+}
+
+void VmOperationQueue::startNext(const QString &vmName)
+{
+    auto it = m_entries.find(vmName);
+    if (it == m_entries.end()) {
+        return;
+    }
+    if (it->active) {
+        return;
+    }
+    if (!it->hasQueued) {
+        // Idle again; the entry is recreated by the next request
+        m_entries.erase(it);
+        return;
+    }
+
+    it->hasQueued = false;
+    it->active = true;
+    it->waitingForState = false;
+    it->current = it->queued;
+    it->elapsed.start();
+    send(vmName, it->current);
+    if (!m_tickTimer->isActive()) {
+        m_tickTimer->start();
+    }
+    emit progressChanged(vmName);
+}
+
+void VmOperationQueue::send(const QString &vmName, Operation operation)
+{
+    Entry &entry = m_entries[vmName];
+    // Results of a call superseded by escalate() or cancel() are dropped
+    const quint64 generation = ++m_nextGeneration;
+    entry.generation = generation;
+
+    LibvirtSession *session = m_session;
+    entry.task = m_queue->run([session, vmName, operation]() {
+        QString error;
+        bool ok = false;
+        switch (operation) {
+        case Start: ok = session->start(vmName, &error); break;
+        case Shutdown: ok = session->shutdown(vmName, &error); break;
+        case Reboot: ok = session->reboot(vmName, &error); break;
+        case ForceOff: ok = session->destroy(vmName, &error); break;
+        }
+        if (!ok && error.isEmpty()) {
+            error = QStringLiteral("operation failed");
+        }
+        return QVariant(error);
+    }, kCallDeadlineMs);
+    entry.task->then(this, [this, vmName, generation](const TaskResult &result) {
+        onSent(vmName, generation, result.ok() ? result.value.toString() : result.errorString);
+    });
+}
+
+void VmOperationQueue::onSent(const QString &vmName, quint64 generation, const QString &error)
+{
+    auto it = m_entries.find(vmName);
+    if (it == m_entries.end() || !it->active || it->generation != generation) {
+        return;
+    }
+    it->task.clear();
+
+    if (!error.isEmpty()) {
+        finish(vmName, false, error);
+        return;
+    }
+    if (it->current == Shutdown) {
+        // The guest was asked to power off; done once the domain is inactive
+        it->waitingForState = true;
+        emit progressChanged(vmName);
+        return;
+    }
+    finish(vmName, true, QString());
+}
+
+void VmOperationQueue::finish(const QString &vmName, bool ok, const QString &error)
+{
+    auto it = m_entries.find(vmName);
+    if (it == m_entries.end() || !it->active) {
+        return;
+    }
+
+    const Operation operation = it->current;
+    it->active = false;
+    it->waitingForState = false;
+    it->generation = 0;
+    it->task.clear();
+
+    emit operationFinished(vmName, operation, ok, error);
+    startNext(vmName);
+    if (!isBusy(vmName)) {
+        emit progressChanged(vmName);
+    }
+}
+
+void VmOperationQueue::onTick()
+{
+    const QList<QString> names = m_entries.keys();
+    for (const QString &vmName : names) {
+        auto it = m_entries.constFind(vmName);
+        if (it == m_entries.constEnd() || !it->active) {
+            continue;
+        }
+        if (it->waitingForState && it->elapsed.hasExpired(m_shutdownTimeoutMs)) {
+            finish(vmName, false, QStringLiteral("guest did not shut down within %1 s")
+                                      .arg(m_shutdownTimeoutMs / 1000));
+        } else {
+            emit progressChanged(vmName);
+        }
+    }
+
+    for (const Entry &entry : std::as_const(m_entries)) {
+        if (entry.active) {
+            return;
+        }
+    }
+    m_tickTimer->stop();
+}
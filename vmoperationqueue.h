@@ -0,0 +1,92 @@
+#ifndef VMOPERATIONQUEUE_H
+#define VMOPERATIONQUEUE_H
+
+#include <QObject>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QString>
+
+class AsyncTask;
+class LibvirtSession;
+class TaskQueue;
+class QTimer;
+struct VmDomain;
+
+// Background start/shutdown/reboot/force-off per VM. Each VM runs one
+// operation at a time and keeps at most one more queued: a new request
+// replaces the queued one (latest intent wins) and a request equal to the
+// running or queued operation is dropped, so double-clicks do nothing.
+//
+// A graceful shutdown only asks the guest to power off; it stays in progress
+// until the domain is seen inactive (fed through domainUpdated()) and can be
+// cancelled or escalated to a force-off meanwhile.
+class VmOperationQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Operation {
+        Start,
+        Shutdown,
+        Reboot,
+        ForceOff
+    };
+    Q_ENUM(Operation)
+
+    VmOperationQueue(LibvirtSession *session, TaskQueue *queue, QObject *parent = nullptr);
+    ~VmOperationQueue();
+
+    // Returns false if the request was coalesced away
+    bool request(const QString &vmName, Operation operation);
+
+    // Drops the queued operation and stops waiting for a graceful shutdown.
+    // Calls already sent to libvirtd cannot be taken back.
+    bool cancel(const QString &vmName);
+    bool canCancel(const QString &vmName) const;
+
+    // Replaces a graceful shutdown in progress with a force-off
+    bool escalate(const QString &vmName);
+    bool canEscalate(const QString &vmName) const;
+
+    bool isBusy(const QString &vmName) const;
+    QString progressText(const QString &vmName) const;
+
+    void domainUpdated(const QString &vmName, const VmDomain &domain);
+
+    void setShutdownTimeout(int timeoutMs) { m_shutdownTimeoutMs = timeoutMs; }
+
+    static QString operationText(Operation operation);
+
+signals:
+    void progressChanged(const QString &vmName);
+    void operationFinished(const QString &vmName, VmOperationQueue::Operation operation,
+                           bool ok, const QString &error);
+
+private:
+    struct Entry {
+        bool active = false;
+        bool waitingForState = false;
+        Operation current = Start;
+        bool hasQueued = false;
+        Operation queued = Start;
+        quint64 generation = 0;
+        QElapsedTimer elapsed;
+        QPointer<AsyncTask> task;
+    };
+
+    void startNext(const QString &vmName);
+    void send(const QString &vmName, Operation operation);
+    void onSent(const QString &vmName, quint64 generation, const QString &error);
+    void finish(const QString &vmName, bool ok, const QString &error);
+    void onTick();
+
+    LibvirtSession *m_session;
+    TaskQueue *m_queue;
+    QTimer *m_tickTimer;
+    QHash<QString, Entry> m_entries;
+    quint64 m_nextGeneration;
+    int m_shutdownTimeoutMs;
+};
+
+#endif // VMOPERATIONQUEUE_H
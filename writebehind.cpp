@@ -0,0 +1,181 @@
+#include "writebehind.h"
+#include "asynctask.h"
+#include <QCoreApplication>
+#include <QTimer>
+#include <QDebug>
+#include <utility>
+
+namespace {
+constexpr int kDebounceMs = 500;
+constexpr int kMaxDelayMs = 2000;
+constexpr int kBatchDeadlineMs = 30000;
+} // namespace
+
+WriteBehind::WriteBehind(QObject *parent)
+    : QObject(parent)
+    , m_queue(new TaskQueue(1, this))
+    , m_debounce(new QTimer(this))
+    , m_batchRunning(false)
+    , m_finished(false)
+    , m_writesDone(0)
+    , m_writesCoalesced(0)
+{
+    m_debounce->setSingleShot(true);
+    connect(m_debounce, &QTimer::timeout, this, &WriteBehind::submit);
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &WriteBehind::finish);
+    }
+}
+
+WriteBehind::~WriteBehind()
+{
+    finish();
+}
+
+WriteBehind *WriteBehind::shared()
+{
+    static QPointer<WriteBehind> instance;
+    if (!instance) {
+        instance = new WriteBehind(QCoreApplication::instance());
+    }
+    return instance;
+}
+
+void WriteBehind::schedule(const QString &key, QObject *context, Snapshot snapshot)
+{
+    if (m_finished) {
+        // Shutting down: nothing is left to coalesce with
+        Write write = snapshot();
+        if (write) {
+            if (write()) {
+                ++m_writesDone;
+            } else {
+                qWarning() << "Write failed:" << key;
+            }
+        }
+        return;
+    }
+
+    if (m_pending.isEmpty()) {
+        m_firstPending.start();
+    }
+    auto it = m_pending.find(key);
+    if (it != m_pending.end()) {
+        ++m_writesCoalesced;
+        *it = Pending{context != nullptr, context, std::move(snapshot)};
+    } else {
+        m_pending.insert(key, Pending{context != nullptr, context, std::move(snapshot)});
+        m_order.append(key);
+    }
+
+    // Restarted by every change, but never past kMaxDelayMs after the first
+    if (!m_batchRunning) {
+        const int remaining = kMaxDelayMs - static_cast<int>(m_firstPending.elapsed());
+        m_debounce->start(qBound(0, remaining, kDebounceMs));
+    }
+}
+
+void WriteBehind::finish()
+{
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+    m_debounce->stop();
+
+    // Deleting the queue waits for the batch on the worker, if any, so the
+    // rest cannot race it for the same files
+    delete m_queue;
+    m_queue = nullptr;
+    m_batchRunning = false;
+
+    // The queue starts its tasks from the event loop, so a batch submitted
+    // just before quitting may never have reached the worker
+    if (m_inFlightFailed) {
+        int failed = m_inFlightFailed->load();
+        if (failed < 0) {
+            failed = runBatch(m_inFlight);
+        }
+        m_writesDone += m_inFlight.writes.size() - failed;
+        m_inFlight = Batch();
+        m_inFlightFailed.reset();
+    }
+
+    const Batch batch = cutBatch();
+    if (!batch.writes.isEmpty()) {
+        const int failed = runBatch(batch);
+        m_writesDone += batch.writes.size() - failed;
+        qDebug() << "Wrote" << batch.writes.size() << "pending files on quit," << failed << "failed";
+    }
+}
+
+WriteBehind::Batch WriteBehind::cutBatch()
+{
+    Batch batch;
+    for (const QString &key : std::as_const(m_order)) {
+        const Pending pending = m_pending.value(key);
+        if (pending.guarded && !pending.context) {
+            continue;
+        }
+        Write write = pending.snapshot();
+        if (write) {
+            batch.keys.append(key);
+            batch.writes.append(std::move(write));
+        }
+    }
+    m_pending.clear();
+    m_order.clear();
+    return batch;
+}
+
+int WriteBehind::runBatch(const Batch &batch)
+{
+    int failed = 0;
+    for (int i = 0; i < batch.writes.size(); ++i) {
+        if (!batch.writes.at(i)()) {
+            qWarning() << "Write failed:" << batch.keys.at(i);
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+void WriteBehind::submit()
+{
+    if (m_batchRunning || m_finished || m_pending.isEmpty()) {
+        return;
+    }
+
+    const Batch batch = cutBatch();
+    if (batch.writes.isEmpty()) {
+        return;
+    }
+
+    // One batch at a time keeps writes to the same file in order. It is kept
+    // here until the worker reports back, so finish() can still write it.
+    m_batchRunning = true;
+    m_inFlight = batch;
+    const int writes = int(batch.writes.size());
+    auto failedWrites = std::make_shared<std::atomic<int>>(-1);
+    m_inFlightFailed = failedWrites;
+    m_queue->run([batch, failedWrites]() {
+        const int failed = runBatch(batch);
+        failedWrites->store(failed);
+        return QVariant(failed);
+    }, kBatchDeadlineMs)->then(this, [this, writes, failedWrites](const TaskResult &result) {
+        m_batchRunning = false;
+        if (result.ok()) {
+            m_writesDone += writes - result.value.toInt();
+        } else {
+            qWarning() << "Write batch did not finish:" << result.errorString;
+        }
+        if (m_inFlightFailed == failedWrites) {
+            m_inFlight = Batch();
+            m_inFlightFailed.reset();
+        }
+        // Changes made while this batch was running
+        if (!m_pending.isEmpty()) {
+            m_debounce->start(0);
+        }
+    });
+}
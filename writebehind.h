@@ -0,0 +1,82 @@
+#ifndef WRITEBEHIND_H
+#define WRITEBEHIND_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class QTimer;
+class TaskQueue;
+
+// Debounced background persistence. Owners schedule a snapshot per file
+// (key) whenever their data changes; later snapshots for the same key replace
+// earlier ones. Once changes settle, or at the latest kMaxDelayMs after the
+// first one, the snapshots are taken on this thread and the writes run on a
+// single worker, one batch at a time. Writers are expected to replace files
+// atomically (QSaveFile), so a crash leaves either the old or the new file.
+// On quit the running batch is awaited and what is left, including a batch
+// the worker never got to, is written directly.
+class WriteBehind : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Runs on the worker; must only use data it captured
+    using Write = std::function<bool()>;
+    // Runs on this thread when the batch is cut and returns the write
+    using Snapshot = std::function<Write()>;
+
+    explicit WriteBehind(QObject *parent = nullptr);
+    ~WriteBehind();
+
+    // Process-wide instance, owned by the application object
+    static WriteBehind *shared();
+
+    // The snapshot is dropped if context is destroyed first; pass nullptr if
+    // it only uses captured values
+    void schedule(const QString &key, QObject *context, Snapshot snapshot);
+
+    // Waits for the running batch, then writes everything still pending on
+    // the calling thread. Later schedule() calls write immediately.
+    void finish();
+
+    int pendingCount() const { return m_pending.size(); }
+    quint64 writesDone() const { return m_writesDone; }
+    quint64 writesCoalesced() const { return m_writesCoalesced; }
+
+private:
+    struct Pending {
+        bool guarded = false;
+        QPointer<QObject> context;
+        Snapshot snapshot;
+    };
+    struct Batch {
+        QStringList keys;
+        QList<Write> writes;
+    };
+
+    Batch cutBatch();
+    static int runBatch(const Batch &batch);
+    void submit();
+
+    TaskQueue *m_queue;
+    QTimer *m_debounce;
+    QElapsedTimer m_firstPending;
+    QHash<QString, Pending> m_pending;
+    QStringList m_order;
+    // Batch handed to the worker, and its failed writes once it has run
+    // (-1 before that)
+    Batch m_inFlight;
+    std::shared_ptr<std::atomic<int>> m_inFlightFailed;
+    bool m_batchRunning;
+    bool m_finished;
+    quint64 m_writesDone;
+    quint64 m_writesCoalesced;
+};
+
+#endif // WRITEBEHIND_H